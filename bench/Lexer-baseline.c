@@ -0,0 +1,648 @@
+// Lexer-baseline.c
+// Лексер до табличного и SSE2-сканирования слов (src/Lexer.c до перехода
+// на g_char_class и scan_word_stop) - базовая линия для make bench-lexer
+// Собирается только в bin/lexbench-baseline, в shell не входит
+
+#include "Lexer.h"
+#include "CommandSubst.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define DEFAULT_BUF_SIZE 32
+#define DEFAULT_ARR_SIZE 16
+
+static Token lexer_extract(Lexer *lexer);
+static Token lexer_extract_basic(Lexer *lexer);
+static Token lexer_extract_pipe(Lexer *lexer);
+static Token lexer_extract_redir(Lexer *lexer);
+static Token lexer_extract_control(Lexer *lexer);
+
+static Token make_error_token(size_t pos, const char *message);
+static Token make_simple_token(TokenType type, size_t pos);
+static void skip_spaces_and_comments(Lexer *lexer);
+static int lexer_grow_buffer(Lexer *lexer, char **buf, size_t *buf_size, size_t required);
+static int lexer_read_heredoc_body(Lexer *lexer, const Token *delim, Token *heredoc);
+static int is_subst_start(const Lexer *lexer);
+static int is_word_end(char c);
+static int lexer_copy_subst(Lexer *lexer, char **buf, size_t *buf_size, size_t *len);
+
+
+
+// Буфер слова растёт удвоением; пока слово - последнее выделение арены,
+// arena_realloc расширяет его на месте без копирования
+static int lexer_grow_buffer(Lexer *lexer, char **buf, size_t *buf_size, size_t required) {
+    if (required < *buf_size) {
+        return 1;
+    }
+    size_t new_size = *buf_size;
+    while (new_size <= required) {
+        new_size *= 2;
+    }
+    char *tmp = arena_realloc(lexer->arena, *buf, *buf_size, new_size);
+    if (!tmp) {
+        return 0;
+    }
+    *buf = tmp;
+    *buf_size = new_size;
+    return 1;
+}
+
+
+void lexer_init(Lexer *lexer, const char *input, Arena *arena){
+    assert(lexer && "lexer_init: null ptr");
+    assert(arena && "lexer_init: null arena");
+
+    lexer->arena = arena;
+    lexer->input = input;
+    lexer->pos = 0;
+    lexer->len = strlen(input);
+}
+
+void lexer_reset(Lexer *lexer, const char *input){
+    assert(lexer && "lexer_reset: null ptr");
+
+    lexer->input = input;
+    lexer->pos = 0;
+    lexer->len = strlen(input);
+}
+void lexer_destroy(Lexer *lexer){
+    assert(lexer && "lexer_reset: null ptr");
+
+    lexer->input = NULL;
+    lexer->pos = 0;
+    lexer->len = 0;
+}
+
+Token lexer_tokenize(Lexer *lexer)
+{
+    assert(lexer && "lexer_tokenize: null ptr");
+
+    assert(lexer->input && "lexer_init: null input");
+
+    return lexer_extract(lexer);
+}
+
+static Token lexer_extract(Lexer *lexer){
+    assert(lexer && "lexer_init: null lexer");
+
+    skip_spaces_and_comments(lexer);
+
+    if (lexer->pos >= lexer->len || !lexer->input) {
+        return make_simple_token(TOKEN_EOF, lexer->pos);
+    }
+
+    char current = lexer->input[lexer->pos];
+    size_t token_pos = lexer->pos;
+
+    switch (current) {
+    case '\0':
+        return make_simple_token(TOKEN_EOF, token_pos);
+    case '\r':
+        lexer->pos++;
+        if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '\n') {
+            lexer->pos++;
+        }
+        return make_simple_token(TOKEN_NEWLINE, token_pos);
+    case '\n':
+        lexer->pos++;
+        return make_simple_token(TOKEN_NEWLINE, token_pos);
+    case '|':
+        if ((lexer->pos + 1) < lexer->len && lexer->input[lexer->pos + 1] == '|') {
+            return lexer_extract_control(lexer);
+        }
+        return lexer_extract_pipe(lexer);
+    case '>':
+    case '<':
+        return lexer_extract_redir(lexer);
+    case '&':
+        if ((lexer->pos + 1) < lexer->len && lexer->input[lexer->pos + 1] == '>') {
+            return lexer_extract_redir(lexer);
+        }
+        return lexer_extract_control(lexer);
+    case ';':
+        return lexer_extract_control(lexer);
+    case '(':
+        lexer->pos++;
+        return make_simple_token(TOKEN_LPAREN, token_pos);
+    case ')':
+        lexer->pos++;
+        return make_simple_token(TOKEN_RPAREN, token_pos);
+    default:
+        return lexer_extract_basic(lexer);
+    }
+}
+
+// Текст ошибки - статическая строка, копия не нужна
+static Token make_error_token(size_t pos, const char *message){
+    Token token;
+    token.type = TOKEN_ERROR;
+    token.quote = QUOTE_NONE;
+    token.pos = pos;
+    token.text = message;
+    token.len = message ? strlen(message) : 0;
+    return token;
+}
+
+static Token make_simple_token(TokenType type, size_t pos){
+    Token token;
+    token.type = type;
+    token.quote = QUOTE_NONE;
+    token.pos = pos;
+    token.text = NULL;
+    token.len = 0;
+    return token;
+}
+
+static void skip_spaces_and_comments(Lexer *lexer) {
+    if (!lexer || !lexer->input) return;
+
+    char c;
+
+    while (lexer->pos < lexer->len) {
+        c = lexer->input[lexer->pos];
+        if (c == ' ' || c == '\t')
+            lexer->pos++;
+        else
+            break;
+    }
+
+    if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '#') {
+        lexer->pos++;
+        while (lexer->pos < lexer->len) {
+            c = lexer->input[lexer->pos];
+            if (c == '\n' || c == '\r' || c == '\0') break;
+            lexer->pos++;
+        }
+    }
+}
+
+// Символ, на котором заканчивается слово вне кавычек
+static int is_word_end(char c){
+    return c == ' ' || c == '\n' || c == '\t' || c == '\0' || c == '\r' || c == '&' || c == ';' ||
+           c == '|' || c == '<' || c == '>' || c == '(' || c == ')';
+}
+
+// Начало подстановки команды: $( или `
+static int is_subst_start(const Lexer *lexer){
+    char c = lexer->input[lexer->pos];
+    return c == '`' || (c == '$' && lexer->pos + 1 < lexer->len && lexer->input[lexer->pos + 1] == '(');
+}
+
+// Копирование подстановки команды в слово без изменений (вместе с $( ) или `)
+// Внутренняя команда разбирается заново при раскрытии
+// Возвращает 0 если подстановка не закрыта или нет памяти
+static int lexer_copy_subst(Lexer *lexer, char **buf, size_t *buf_size, size_t *len){
+    size_t end = command_subst_end(lexer->input, lexer->pos);
+    if(end == COMMAND_SUBST_NOT_FOUND || end >= lexer->len){
+        return 0;
+    }
+
+    size_t n = end + 1 - lexer->pos;
+    while(*buf_size <= *len + n){
+        if(!lexer_grow_buffer(lexer, buf, buf_size, *len + n)){
+            return 0;
+        }
+    }
+    memcpy(*buf + *len, lexer->input + lexer->pos, n);
+    *len += n;
+    lexer->pos = end + 1;
+    return 1;
+}
+
+static Token make_word_token(size_t pos, const char *text, size_t len, QuoteCount quote){
+    Token token;
+    token.type = TOKEN_WORD;
+    token.quote = quote;
+    token.pos = pos;
+    token.text = text;
+    token.len = len;
+    return token;
+}
+
+// Слово: срез входа, если в нём нет кавычек и экранирования (подстановки
+// команд $(...) и `...` копируются в слово как есть, поэтому срезу не мешают),
+// иначе декодированная копия в арене
+static Token lexer_extract_basic(Lexer *lexer){
+    if (!lexer || !lexer->input) 
+        return make_error_token(0, "lexer_extract_basic: null lexer");
+
+    size_t start = lexer->pos;
+
+    while(lexer->pos < lexer->len){
+        char c = lexer->input[lexer->pos];
+        if(is_word_end(c) || c == '\'' || c == '"' || c == '\\'){
+            break;
+        }
+        if(is_subst_start(lexer)){
+            size_t end = command_subst_end(lexer->input, lexer->pos);
+            if(end == COMMAND_SUBST_NOT_FOUND || end >= lexer->len){
+                return make_error_token(start, "lexer_extract_basic: unclosed command substitution");
+            }
+            lexer->pos = end + 1;
+            continue;
+        }
+        lexer->pos++;
+    }
+    if(lexer->pos >= lexer->len || is_word_end(lexer->input[lexer->pos])){
+        return make_word_token(start, lexer->input + start, lexer->pos - start, QUOTE_NONE);
+    }
+
+    // Декодирование: уже пройденная часть копируется целиком, остальное - по символу
+    size_t len = lexer->pos - start, buf_size = DEFAULT_BUF_SIZE;
+    while(buf_size <= len){
+        buf_size *= 2;
+    }
+    char *buf = arena_alloc(lexer->arena, buf_size);
+    if(!buf)
+        return make_error_token(start, "lexer_extract_basic: alloc fail");
+    memcpy(buf, lexer->input + start, len);
+    QuoteCount quote_type = QUOTE_NONE, active_quote = QUOTE_NONE;
+    size_t quote_start = 0;
+
+
+    while(lexer->pos < lexer->len){
+        char c = lexer->input[lexer->pos];
+
+        if(active_quote == QUOTE_NONE){
+            if(c == '\''){
+                quote_type = QUOTE_SINGLE;
+                active_quote = QUOTE_SINGLE;
+                quote_start = lexer->pos;
+                lexer->pos++;
+                continue;
+            }
+
+            if(c == '"'){
+                quote_type = QUOTE_DOUBLE;
+                active_quote = QUOTE_DOUBLE;
+                quote_start = lexer->pos;
+                lexer->pos++;
+                continue;
+            }
+
+            if(is_word_end(c)){
+                break;
+            }
+
+            if(is_subst_start(lexer)){
+                if(!lexer_copy_subst(lexer, &buf, &buf_size, &len)){
+                    return make_error_token(start, "lexer_extract_basic: unclosed command substitution");
+                }
+                continue;
+            }
+
+            if(c == '\\'){
+                if(lexer->pos + 1 >= lexer->len){
+                    return make_error_token(start, "lexer_extract_basic: hanging \\");
+                }
+
+                char n = lexer->input[lexer->pos + 1];
+
+                // \\, \$ и \` остаются экранированными до раскрытия:
+                // Expander снимает обратную косую черту и не выполняет подстановку
+                if(n == '\\' || n == '"' || n == '$' || n == '`'){
+                    if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + 2)) {
+                        return make_error_token(start, "lexer_extract_basic: alloc fail");
+                    }
+                    if(n != '"'){
+                        buf[len++] = '\\';
+                    }
+                    buf[len++] = n;
+                    lexer->pos += 2;
+                    continue;
+                }
+
+                if(n == '\n'){
+                    lexer->pos += 2;
+                    continue;
+                }
+                if(n == '\r'){
+                    if((lexer->pos + 2 < lexer->len) && (lexer->input[lexer->pos + 2] == '\n')){
+                        lexer->pos += 3;
+                    } else lexer->pos += 2;
+
+                    continue;
+                }
+
+                if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + 1)) {
+                    return make_error_token(start, "lexer_extract_basic: alloc fail");
+                }
+                buf[len++] = n;
+                lexer->pos += 2;
+                continue; 
+            }
+            if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + 1)) {
+                return make_error_token(start, "lexer_extract_basic: alloc fail");
+            }
+            buf[len++] = c;
+            lexer->pos++;
+            continue;
+        }
+        if(active_quote == QUOTE_SINGLE){
+            if(c == '\''){
+                active_quote = QUOTE_NONE;
+                lexer->pos++;
+                continue;
+            }
+            if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + 1)) {
+                return make_error_token(start, "lexer_extract_basic: alloc fail");
+            }
+            buf[len++] = c;
+            lexer->pos++;
+            continue;
+        }
+
+        if(active_quote == QUOTE_DOUBLE){
+            if(c == '"'){
+                active_quote = QUOTE_NONE;
+                lexer->pos++;
+                continue;
+            }
+
+            if(is_subst_start(lexer)){
+                if(!lexer_copy_subst(lexer, &buf, &buf_size, &len)){
+                    return make_error_token(quote_start, "lexer_extract_basic: unclosed command substitution");
+                }
+                continue;
+            }
+
+            if(c == '\\'){
+                if(lexer->pos + 1 >= lexer->len){
+                    return make_error_token(quote_start, "lexer_extract_basic: hanging \\");
+                }
+
+                char n = lexer->input[lexer->pos + 1];
+
+                // \\, \$ и \` остаются экранированными до раскрытия:
+                // Expander снимает обратную косую черту и не выполняет подстановку
+                if(n == '\\' || n == '"' || n == '$' || n == '`'){
+                    if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + 2)) {
+                        return make_error_token(start, "lexer_extract_basic: alloc fail");
+                    }
+                    if(n != '"'){
+                        buf[len++] = '\\';
+                    }
+                    buf[len++] = n;
+                    lexer->pos += 2;
+                    continue;
+                }
+
+                if(n == '\n'){
+                    lexer->pos += 2;
+                    continue;
+                }
+
+                if(n == '\r'){
+                    if((lexer->pos + 2 < lexer->len) && (lexer->input[lexer->pos + 2] == '\n')){
+                        lexer->pos += 3;
+                    } else lexer->pos += 2;
+
+                    continue;
+                }
+
+                if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + 1)) {
+                    return make_error_token(start, "lexer_extract_basic: alloc fail");
+                }
+                buf[len++] = '\\';
+                lexer->pos++;
+                continue;
+            }
+
+            if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + 1)) {
+                return make_error_token(start, "lexer_extract_basic: alloc fail");
+            }
+            buf[len++] = c;
+            lexer->pos++;
+            continue;
+        }
+
+    }
+
+    if(active_quote != QUOTE_NONE){
+        return make_error_token(quote_start, "lexer_extract_basic: unclosed quotes");
+    }
+
+    // Лишнее место в конце буфера возвращается арене
+    buf = arena_realloc(lexer->arena, buf, buf_size, len);
+
+    return make_word_token(start, buf, len, quote_type);
+}
+
+static Token lexer_extract_pipe(Lexer *lexer)
+{
+    if (!lexer || !lexer->input)
+        return make_error_token(0, "lexer_extract_pipe: null lexer");
+
+    size_t start = lexer->pos;
+
+    if (lexer->pos < lexer->len)
+        lexer->pos++;
+
+    if (lexer->pos < lexer->len) {
+        if (lexer->input[lexer->pos] == '&') {
+            lexer->pos++;
+            return make_simple_token(TOKEN_PIPE_ERR, start);
+        }
+    }
+
+    return make_simple_token(TOKEN_PIPE, start);
+}
+
+static Token lexer_extract_redir(Lexer *lexer)
+{
+    if (!lexer || !lexer->input)
+        return make_error_token(0, "lexer_extract_redir: null lexer");
+
+    size_t start = lexer->pos;
+
+    if (lexer->pos >= lexer->len)
+        return make_error_token(start, "lexer_extract_redir: out of range");
+
+    switch (lexer->input[lexer->pos]) {
+    case '>':
+        lexer->pos++;
+        if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '(') {
+            lexer->pos++;
+            return make_simple_token(TOKEN_PROCSUB_OUT, start);
+        }
+        if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '>') {
+            lexer->pos++;
+            return make_simple_token(TOKEN_REDIR_OUT_APPEND, start);
+        }
+        return make_simple_token(TOKEN_REDIR_OUT, start);
+
+    case '<':
+        lexer->pos++;
+        if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '(') {
+            lexer->pos++;
+            return make_simple_token(TOKEN_PROCSUB_IN, start);
+        }
+        if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '<') {
+            lexer->pos++;
+            if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '<') {
+                lexer->pos++;
+                return make_simple_token(TOKEN_HERESTRING, start);
+            }
+            return make_simple_token(TOKEN_HEREDOC, start);
+        }
+        return make_simple_token(TOKEN_REDIR_IN, start);
+
+    case '&':
+        lexer->pos++;
+        if (lexer->pos >= lexer->len || lexer->input[lexer->pos] != '>')
+            return make_error_token(start, "lexer_extract_redir: expected '>' after '&'");
+
+        lexer->pos++;
+        if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '>') {
+            lexer->pos++;
+            return make_simple_token(TOKEN_REDIR_ERR_APPEND, start);
+        }
+        return make_simple_token(TOKEN_REDIR_ERR, start);
+
+    default:
+        return make_error_token(start, "lexer_extract_redir: unexpected char");
+    }
+}
+
+static Token lexer_extract_control(Lexer *lexer)
+{
+    if (!lexer || !lexer->input)
+        return make_error_token(0, "lexer_extract_control: null lexer");
+
+    size_t start = lexer->pos;
+
+    if (lexer->pos >= lexer->len)
+        return make_error_token(start, "lexer_extract_control: out of range");
+
+    switch (lexer->input[lexer->pos]) {
+    case '&':
+        lexer->pos++;
+        if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '&') {
+            lexer->pos++;
+            return make_simple_token(TOKEN_AND, start);
+        }
+        return make_simple_token(TOKEN_AMP, start);
+
+    case ';':
+        lexer->pos++;
+        return make_simple_token(TOKEN_SEMI, start);
+
+    case '|':
+        lexer->pos++;
+        if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '|') {
+            lexer->pos++;
+            return make_simple_token(TOKEN_OR, start);
+        }
+        return make_simple_token(TOKEN_PIPE, start);
+
+    default:
+        return make_error_token(start, "lexer_extract_control: unexpected char");
+    }
+}
+
+void token_array_init(TokenArray *array, Arena *arena){
+    assert(array && "token_array_init: null ptr");
+
+    array->arena = arena;
+    array->capacity = 0;
+    array->count = 0;
+    array->tokens = NULL;
+}
+
+int token_array_push(TokenArray *array, Token token){
+    assert(array && "token_array_push: null array ptr");
+
+    if(array->count == array->capacity){
+        size_t new_capacity = array->capacity == 0 ? DEFAULT_ARR_SIZE : array->capacity * 2;
+        Token *tmp = arena_realloc(array->arena, array->tokens,
+                                   array->capacity * sizeof(Token), new_capacity * sizeof(Token));
+        if(!tmp){
+            return 0;
+        }
+        array->tokens = tmp;
+        array->capacity = new_capacity;
+    }
+
+    array->tokens[array->count] = token;
+    array->count++;
+
+    return 1;
+}
+
+// Чтение тела here-document: строки от текущей позиции до строки,
+// совпадающей с delim. Тело - срез входа в тексте токена <<
+// Позиция лексера переносится за строку-ограничитель
+// Возвращает 1 при успехе, 0 если ограничитель не найден
+static int lexer_read_heredoc_body(Lexer *lexer, const Token *delim, Token *heredoc){
+    size_t delim_len = delim->len;
+    size_t body_start = lexer->pos;
+    size_t line = lexer->pos;
+
+    while(line < lexer->len){
+        const char *nl = memchr(lexer->input + line, '\n', lexer->len - line);
+        size_t line_end = nl ? (size_t)(nl - lexer->input) : lexer->len;
+        size_t line_len = line_end - line;
+        if(line_len > 0 && lexer->input[line_end - 1] == '\r'){
+            line_len--;
+        }
+
+        if(line_len == delim_len && memcmp(lexer->input + line, delim->text, delim_len) == 0){
+            heredoc->text = lexer->input + body_start;
+            heredoc->len = line - body_start;
+            lexer->pos = nl ? line_end + 1 : line_end;
+            return 1;
+        }
+
+        line = nl ? line_end + 1 : lexer->len;
+    }
+
+    return 0;
+}
+
+int lexer_tokenize_all(Lexer *lexer, TokenArray *array){
+    assert(array && "lexer_tokenize_all: null array");
+    assert(lexer && "lexer_tokenize_all: null lexer");
+
+    // Индексы токенов << в строке, тела которых ещё не прочитаны
+    // Тела идут после конца строки с командой, в порядке появления <<
+    size_t pending[DEFAULT_ARR_SIZE];
+    size_t pending_count = 0;
+
+    token_array_init(array, lexer->arena);
+    while(1){
+        Token token = lexer_tokenize(lexer);
+
+        if(token.type == TOKEN_HEREDOC && pending_count >= DEFAULT_ARR_SIZE){
+            token = make_error_token(token.pos, "lexer_tokenize_all: too many here-documents");
+        }
+
+        if((token.type == TOKEN_NEWLINE || token.type == TOKEN_EOF) && pending_count > 0){
+            // Читаем тела here-documents, ограничитель - следующее за << слово
+            for(size_t i = 0; i < pending_count; i++){
+                size_t idx = pending[i];
+                if(idx + 1 >= array->count || array->tokens[idx + 1].type != TOKEN_WORD){
+                    continue;  // Нет ограничителя - ошибку выдаст парсер
+                }
+                if(!lexer_read_heredoc_body(lexer, &array->tokens[idx + 1], &array->tokens[idx])){
+                    token = make_error_token(array->tokens[idx].pos, "lexer_tokenize_all: unterminated here-document");
+                    break;
+                }
+            }
+            pending_count = 0;
+        }
+
+        if(!token_array_push(array, token)){
+            return 0;
+        }
+
+        if(token.type == TOKEN_HEREDOC){
+            pending[pending_count++] = array->count - 1;
+        }
+
+        if(token.type == TOKEN_EOF || token.type == TOKEN_ERROR){
+            break;
+        }
+    }
+    return 1;
+}
\ No newline at end of file
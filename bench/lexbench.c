@@ -0,0 +1,165 @@
+// lexbench.c
+// Микробенчмарк лексера на длинных машинно сгенерированных скриптах
+// Собирается трижды (make bench-lexer): bin/lexbench - с SSE2-сканированием,
+// bin/lexbench-scalar - с Lexer.c, собранным с -DLEXER_SCALAR_SCAN,
+// bin/lexbench-baseline - с лексером до табличного сканирования
+// Запуск: bin/lexbench [размер входа в МБ] [замеров]
+// Один замер - lexer_tokenize_all по всему входу повторяется не меньше
+// SAMPLE_SECONDS (один проход по 16 МБ - миллисекунды, в шум таймера и
+// планировщика). Выводятся медиана, минимум и максимум скорости в МБ/с
+// по замерам после прогревочного для двух входов: mixed - аргументы вида -I/путь/... около 40 байт,
+// часть в кавычках и с экранированием; long - длинные аргументы без кавычек
+// (пути по ~200 байт), где время уходит в основном на поиск конца слова
+
+#include "Lexer.h"
+#include "Arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libgen.h>
+#include <sys/types.h>
+
+// Глобальные переменные shell, которые обычно определяет main.c
+int g_last_exit_code = 0;
+pid_t g_last_bg_pid = 0;
+int g_should_exit = 0;
+int g_exit_code = 0;
+
+#define ARGS_PER_LINE 2000
+#define SAMPLE_SECONDS 0.2
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Вход вида сгенерированного сборочного скрипта: длинные строки аргументов,
+// в mixed изредка кавычки и экранирование, в конце строки - операторы
+static char *generate_input(size_t size, int long_args){
+    char *input = malloc(size + 1024);  // Запас на последний аргумент и конец строки
+    if(!input){
+        perror("malloc failed");
+        return NULL;
+    }
+
+    size_t len = 0;
+    unsigned long n = 0;
+    while(len < size){
+        len += (size_t)sprintf(input + len, "cc -O2 -c");
+        for(int i = 0; i < ARGS_PER_LINE && len < size; i++, n++){
+            if(long_args){
+                len += (size_t)sprintf(input + len, " /srv/build/workspace/project/generated/sources/"
+                                       "very/deeply/nested/directory/structure/for/module_%05lu/"
+                                       "component/subcomponent/implementation/detail/"
+                                       "translation_unit_%05lu.generated.c", n, n);
+                continue;
+            }
+            switch(n % 16){
+                case 0:
+                    len += (size_t)sprintf(input + len, " \"src/dir with space/file_%05lu.c\"", n);
+                    break;
+                case 1:
+                    len += (size_t)sprintf(input + len, " 'build/obj/file_%05lu.o'", n);
+                    break;
+                case 2:
+                    len += (size_t)sprintf(input + len, " -DNAME_%lu=value\\ %lu", n, n);
+                    break;
+                default:
+                    len += (size_t)sprintf(input + len, " -I/usr/local/include/project/module_%05lu", n);
+                    break;
+            }
+        }
+        len += (size_t)sprintf(input + len, " > /dev/null && echo done_%lu;\n", n);
+    }
+    input[len] = '\0';
+    return input;
+}
+
+static int compare_double(const void *a, const void *b){
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Один проход лексера по input в арене; число токенов в *count
+// Возвращает 0 при успехе, -1 при ошибке лексера
+static int tokenize_once(const char *input, Arena *arena, size_t *count){
+    Lexer lexer;
+    TokenArray tokens;
+    arena_reset(arena);
+    lexer_init(&lexer, input, arena);
+    if(!lexer_tokenize_all(&lexer, &tokens)){
+        fprintf(stderr, "tokenize failed\n");
+        return -1;
+    }
+    if(tokens.tokens[tokens.count - 1].type == TOKEN_ERROR){
+        fprintf(stderr, "lexer error: %.*s\n", (int)tokens.tokens[tokens.count - 1].len,
+                tokens.tokens[tokens.count - 1].text);
+        return -1;
+    }
+    *count = tokens.count;
+    return 0;
+}
+
+// Медиана, минимум и максимум скорости по samples замерам; печатает строку результата
+// Возвращает 0 при успехе, -1 при ошибке лексера
+static int bench(const char *name, const char *profile, const char *input, int samples){
+    size_t len = strlen(input);
+    double mb = (double)len / (1 << 20);
+    double *speed = malloc((size_t)samples * sizeof(double));
+    Arena arena;
+    arena_init(&arena, 1 << 20);
+    if(!speed){
+        perror("malloc failed");
+        return -1;
+    }
+
+    size_t count = 0;
+    int rc = tokenize_once(input, &arena, &count);   // Прогрев: блоки арены, кеши
+    for(int r = 0; rc == 0 && r < samples; r++){
+        int passes = 0;
+        double start = now();
+        double elapsed;
+        do {
+            rc = tokenize_once(input, &arena, &count);
+            passes++;
+            elapsed = now() - start;
+        } while(rc == 0 && elapsed < SAMPLE_SECONDS);
+        speed[r] = mb * passes / elapsed;
+    }
+
+    if(rc == 0){
+        qsort(speed, (size_t)samples, sizeof(double), compare_double);
+        printf("%-18s %-6s %5.1f MB  %9zu tokens  median %7.1f MB/s  (min %7.1f, max %7.1f, %d samples)\n",
+               name, profile, mb, count, speed[samples / 2], speed[0], speed[samples - 1], samples);
+    }
+
+    free(speed);
+    arena_free(&arena);
+    return rc;
+}
+
+int main(int argc, char **argv){
+    size_t size_mb = argc > 1 ? (size_t)atol(argv[1]) : 16;
+    int samples = argc > 2 ? atoi(argv[2]) : 21;
+    if(size_mb == 0 || samples <= 0){
+        fprintf(stderr, "usage: %s [size MB] [samples]\n", argv[0]);
+        return 2;
+    }
+
+    const char *name = basename(argv[0]);
+    for(int long_args = 0; long_args <= 1; long_args++){
+        char *input = generate_input(size_mb << 20, long_args);
+        if(!input){
+            return 1;
+        }
+        int rc = bench(name, long_args ? "long" : "mixed", input, samples);
+        free(input);
+        if(rc < 0){
+            return 1;
+        }
+    }
+    return 0;
+}
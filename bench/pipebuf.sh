@@ -0,0 +1,40 @@
+#!/bin/bash
+# pipebuf.sh
+# Сравнение пропускной способности pipeline с буфером pipe по умолчанию
+# и с увеличенным через set -o pipebuf=SIZE
+# Запуск: make bench  или  bench/pipebuf.sh [путь к shell] [размер данных в МБ] [повторов]
+# Для каждого варианта выводится лучшее время из нескольких запусков
+
+SHELL_BIN=${1:-bin/main}
+SIZE_MB=${2:-1024}
+RUNS=${3:-5}
+STAGES="cat | cat | cat | cat"
+
+run_once() {
+    local opt=$1
+    local start end
+    start=$(date +%s.%N)
+    printf '%s\nhead -c %dM /dev/zero | %s | wc -c > /dev/null\nexit\n' \
+        "$opt" "$SIZE_MB" "$STAGES" | HOME=/nonexistent "$SHELL_BIN" > /dev/null 2>&1
+    end=$(date +%s.%N)
+    awk -v s="$start" -v e="$end" 'BEGIN { printf "%.3f\n", e - s }'
+}
+
+run() {
+    local opt=$1
+    local best=""
+    for ((r = 0; r < RUNS; r++)); do
+        local t
+        t=$(run_once "$opt")
+        if [ -z "$best" ] || awk -v a="$t" -v b="$best" 'BEGIN { exit !(a < b) }'; then
+            best=$t
+        fi
+    done
+    awk -v t="$best" -v mb="$SIZE_MB" -v opt="$opt" \
+        'BEGIN { printf "%-24s %7.3f s  %8.1f MB/s\n", opt, t, mb / t }'
+}
+
+echo "head -c ${SIZE_MB}M /dev/zero | $STAGES | wc -c"
+for opt in "set +o pipebuf" "set -o pipebuf=256K" "set -o pipebuf=1M"; do
+    run "$opt"
+done
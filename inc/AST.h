@@ -2,7 +2,9 @@
 #pragma once
 
 #include <stdlib.h>
+#include <stdint.h>
 #include "Token.h"
+#include "Arena.h"
 
 typedef enum ASTNodeType {
     AST_COMMAND,        // Простая команда с аргументами
@@ -13,51 +15,120 @@ typedef enum ASTNodeType {
     AST_OR,             // Логическое ИЛИ ||
     AST_BACKGROUND,     // Фоновое выполнение &
     AST_SUBSHELL,       // Подоболочка (...)
-    AST_REDIRECT        // Перенаправление ввода/вывода
+    AST_REDIRECT,       // Перенаправление ввода/вывода
+    AST_TIME            // time [-p|-m] pipeline
 } ASTNodeType;
 
+typedef enum TimeFormat {
+    TIME_FORMAT_DEFAULT,    // real/user/sys/maxrss и строка на каждую стадию
+    TIME_FORMAT_POSIX,      // time -p
+    TIME_FORMAT_MACHINE     // time -m: key=value для разбора скриптами
+} TimeFormat;
+
 typedef enum RedirectType {
     REDIR_IN,           // < (ввод из файла)
     REDIR_OUT,          // > (вывод в файл, перезапись)
     REDIR_OUT_APPEND,   // >> (вывод в файл, добавление)
     REDIR_ERR,          // 2> (stderr в файл, перезапись)
-    REDIR_ERR_APPEND    // 2>> (stderr в файл, добавление)
+    REDIR_ERR_APPEND,   // 2>> (stderr в файл, добавление)
+    REDIR_HEREDOC,      // << (here-document, filename - тело)
+    REDIR_HERESTRING    // <<< (here-string, filename - строка с \n)
 } RedirectType;
 
 typedef struct ASTNode ASTNode;
 
+// Узлы строки лежат в одном непрерывном массиве ASTArray, потомок задаётся
+// 32-битным смещением от родителя внутри массива (0 - потомка нет). Дети
+// создаются раньше родителя, поэтому поддерево занимает непрерывный отрезок,
+// заканчивающийся своим корнем, и копируется одним memcpy со смещениями
+// Массив, массивы аргументов и имена файлов лежат в арене строки и
+// освобождаются вместе с ней (arena_reset). Что должно пережить строку
+// (текст команды задачи), копируется из дерева явно - ast_to_string в Executor.c
+typedef int32_t ASTRef;
+
+// Подстановка процесса <(cmd) или >(cmd) в аргументе команды
+// При выполнении аргумент arg_index заменяется на /dev/fd/N
+typedef struct {
+    uint32_t arg_index;
+    uint8_t output;     // 0 - <(cmd), команда читает; 1 - >(cmd), команда пишет
+    ASTRef node;        // Смещение корня команды подстановки от узла команды
+} ASTProcSubst;
+
+// 24 байта: тип, вид, флаги и argc в первых 8 байтах, ссылки на детей - смещения
 struct ASTNode {
-    ASTNodeType type;
-    
+    uint8_t type;               // ASTNodeType
+    uint8_t kind;               // RedirectType для редиректа, TimeFormat для time
+    uint8_t expand;             // Слова с $, ` или \ - раскрываются при выполнении
+    uint8_t procsub_count;      // Подстановок процессов в команде
+    uint32_t argc;              // Аргументов команды (у остальных узлов 0)
+
     union {
         struct {
             char **args;
-            size_t argc;
+            ASTProcSubst *procsubs;   // Подстановки процессов (NULL - нет)
         } command;
         
         struct {
-            ASTNode *left;
-            ASTNode *right;
+            ASTRef left;
+            ASTRef right;
+            uint32_t pipe_size;  // Для pipeline: размер буфера pipe (0 - по умолчанию)
         } binary;
         
-        ASTNode *subshell;
+        ASTRef subshell;        // Содержимое (...)
         
         struct {
-            ASTNode *command;
-            RedirectType type;
+            ASTRef command;
             char *filename;
         } redirect;
+        
+        ASTRef timed;           // Pipeline под time
     } data;
 };
 
-ASTNode *ast_create_command(char **args, size_t argc);
+// Массив узлов одного дерева; ёмкость резервируется сразу, так что
+// указатели на узлы не меняются во время разбора
+typedef struct {
+    ASTNode *nodes;
+    uint32_t count;
+    uint32_t capacity;
+} ASTArray;
+
+int ast_array_init(ASTArray *array, Arena *arena, uint32_t capacity);
+
+ASTNode *ast_child(const ASTNode *node, ASTRef ref);
+
+ASTRef ast_ref(const ASTNode *from, const ASTNode *to);
+
+ASTNode *ast_create_command(ASTArray *array, char **args, size_t argc);
+
+ASTNode *ast_create_binary(ASTArray *array, ASTNodeType type, ASTNode *left, ASTNode *right);
+
+ASTNode *ast_create_subshell(ASTArray *array, ASTNode *inner);
+
+ASTNode *ast_create_redirect(ASTArray *array, ASTNode *command, RedirectType redir_type, char *filename);
+
+ASTNode *ast_create_time(ASTArray *array, ASTNode *pipeline, TimeFormat format);
+
+ASTNode *ast_first(ASTNode *node);
+
+ASTNode *ast_copy(Arena *arena, ASTNode *node);
+
+// Элемент стека обхода: узел и что для него уже сделано (своё у каждого обхода)
+typedef struct {
+    ASTNode *node;
+    int state;
+} ASTStackItem;
 
-ASTNode *ast_create_binary(ASTNodeType type, ASTNode *left, ASTNode *right);
+typedef struct {
+    ASTStackItem *items;
+    size_t count;
+    size_t capacity;
+} ASTStack;
 
-ASTNode *ast_create_subshell(ASTNode *inner);
+void ast_stack_init(ASTStack *stack);
 
-ASTNode *ast_create_redirect(ASTNode *command, RedirectType redir_type, char *filename);
+int ast_stack_push(ASTStack *stack, ASTNode *node, int state);
 
-void ast_free(ASTNode *node);
+void ast_stack_free(ASTStack *stack);
 
-void ast_print(ASTNode *node, int indent);
\ No newline at end of file
+void ast_print(ASTNode *node, int indent);
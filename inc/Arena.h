@@ -0,0 +1,32 @@
+//Arena.h
+#pragma once
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE 4096   // Размер блока по умолчанию (больше - для крупных выделений)
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;                // Размер data
+    size_t used;
+    _Alignas(max_align_t) char data[];
+} ArenaBlock;
+
+// Арена одной командной строки: токены, результаты раскрытия, AST
+// Всё освобождается разом через arena_reset, отдельных free нет.
+// Данные, которые должны пережить строку (текст команды задачи и т.п.),
+// копируются из арены явно
+typedef struct {
+    ArenaBlock *head;
+    ArenaBlock *current;        // Блок, из которого идут выделения
+    void *last;                 // Последнее выделение (расширяется на месте)
+    size_t block_size;
+} Arena;
+
+void arena_init(Arena *arena, size_t block_size);
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+char *arena_strdup(Arena *arena, const char *str);
+char *arena_strndup(Arena *arena, const char *str, size_t len);
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
@@ -3,4 +3,6 @@
 
 int is_builtin(const char *command);
 
-int execute_builtin(char **args);
\ No newline at end of file
+int execute_builtin(char **args);
+
+int builtin_is_pure(char **args);
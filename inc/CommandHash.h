@@ -0,0 +1,26 @@
+//CommandHash.h
+#pragma once
+
+#include <stddef.h>
+
+#define COMMAND_HASH_INITIAL_BUCKETS 64
+
+typedef struct CommandHashEntry {
+    char *name;                     // Имя команды (ключ)
+    char *path;                     // Абсолютный путь к исполняемому файлу
+    unsigned long hits;             // Количество обращений
+    struct CommandHashEntry *next;  // Следующий элемент в цепочке бакета
+} CommandHashEntry;
+
+typedef struct {
+    CommandHashEntry **buckets;
+    size_t bucket_count;
+    size_t count;
+} CommandHash;
+
+const char *command_hash_lookup(const char *name);
+int command_hash_add(const char *name, const char *path);
+void command_hash_remove(const char *name);
+void command_hash_clear(void);
+void command_hash_print(void);
+void command_hash_free(void);
@@ -0,0 +1,9 @@
+//CommandSubst.h
+#pragma once
+
+#include <stddef.h>
+
+#define COMMAND_SUBST_NOT_FOUND ((size_t)-1)
+
+size_t command_subst_end(const char *str, size_t start);
+char *command_subst(const char *cmdline);
@@ -0,0 +1,24 @@
+//Deadline.h
+#pragma once
+
+#include <time.h>
+
+#define DEADLINE_EXIT_CODE 124  // Код возврата команды, у которой истёк срок
+
+// Срок выполнения команды (timeout) или фоновой задачи (jobctl ttl) на timerfd
+// По истечении посылается signal, через kill_after после него - SIGKILL
+typedef struct Deadline {
+    int fd;                         // timerfd (CLOCK_MONOTONIC), -1 - снят
+    int signal;
+    struct timespec kill_after;     // 0 - SIGKILL не посылается
+    int expired;                    // 0 - срок не истёк, 1 - послан signal, 2 - послан SIGKILL
+    struct Deadline *outer;         // Срок внешней команды (вложенные timeout)
+} Deadline;
+
+Deadline *deadline_create(const struct timespec *duration, int signal,
+                          const struct timespec *kill_after);
+void deadline_free(Deadline *deadline);
+void deadline_disarm(Deadline *deadline);
+int deadline_expire(Deadline *deadline);
+
+int parse_duration(const char *str, struct timespec *out);
@@ -2,5 +2,17 @@
 #pragma once
 
 #include "AST.h"
+#include "Deadline.h"
 
-int executor_execute(ASTNode *root);
\ No newline at end of file
+#include <sys/types.h>
+
+int executor_execute(ASTNode *root);
+
+char *executor_capture(ASTNode *root, size_t *len);
+
+pid_t executor_launch(ASTNode *node, int stdin_fd, int output_fd, int *fail_status);
+
+int executor_wait_code(int status);
+const int *executor_pipestatus(size_t *count);
+void executor_push_deadline(Deadline *deadline);
+void executor_pop_deadline(void);
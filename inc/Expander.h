@@ -1,6 +1,7 @@
 //Expander.h
 #pragma once
 
-#include "Lexer.h"
+#include <stddef.h>
 
-int expander_expand(TokenArray *tokens);
\ No newline at end of file
+int expander_needs_expansion(const char *text, size_t len);
+char *expander_expand_word(const char *word);
@@ -2,7 +2,24 @@
 #pragma once
 
 #include <sys/types.h>
+#include <sys/resource.h>
 #include <termios.h>
+#include <time.h>
+
+#include "Timing.h"
+#include "JobIndex.h"
+#include "OutputRing.h"
+#include "Deadline.h"
+
+#include <poll.h>
+
+#define JOB_HISTORY_SIZE 32     // Сколько завершённых задач хранится после удаления из списка
+#define JOB_POLL_MAX 64         // Сколько дескрипторов задач (pipe вывода, таймеры ttl) ожидается одним poll
+
+// Результат job_wait_event
+#define JOB_WAIT_EVENT 1
+#define JOB_WAIT_TIMEOUT 0
+#define JOB_WAIT_INTERRUPTED (-1)
 
 
 typedef enum {
@@ -11,11 +28,17 @@ typedef enum {
     PROC_COMPLETED   
 } ProcessState;
 
+struct Job;
+
 typedef struct Process {
     pid_t pid;               
     ProcessState state;      
     int exit_status;         
     char *command;           
+    struct timespec start;   // Время запуска (CLOCK_REALTIME)
+    struct timespec end;     // Время сбора процесса
+    struct rusage usage;     // rusage из wait4, заполнено когда state == PROC_COMPLETED
+    struct Job *job;         // Задача, которой принадлежит процесс
     struct Process *next;    
 } Process;
 
@@ -33,6 +56,11 @@ typedef struct Job {
     Process *processes;      
     char *command_line;      
     int notified;            
+    int waited;              // Статус уже возвращён командой wait (для wait -n)
+    TimeReport *timing;      // Отчёт time для остановленной timed-команды (NULL - нет)
+    int output_fd;           // Чтение из pipe вывода задачи (set -o bgcapture), -1 - нет
+    OutputRing *output;      // Буфер последнего вывода задачи (NULL - вывод не перехватывается)
+    Deadline *ttl;           // Срок задачи (jobctl ttl), NULL - без срока
     struct Job *next;        
     struct Job *prev;        
 } Job;
@@ -40,9 +68,23 @@ typedef struct Job {
 typedef struct {
     Job *head;               
     Job *tail;               
-    int next_job_id;         
+    JobIndex by_id;          // Номер задачи -> Job
+    JobIndex by_pgid;        // PGID -> Job
+    JobIndex by_pid;         // PID -> Process
+    unsigned long *id_bitmap;   // Занятые номера задач (бит i - номер i + 1)
+    size_t id_bitmap_words;
 } JobList;
 
+// Очередь команд с ограничением числа одновременно работающих (jobq)
+// Элементы берутся через next по одному, запускаются через launch
+typedef struct {
+    size_t limit;               // Максимум одновременно работающих элементов
+    int halt_on_error;          // После первой ошибки новые элементы не запускаются
+    char *(*next)(void *ctx);   // Очередной элемент (выделенная строка) или NULL
+    pid_t (*launch)(const char *item, void *ctx, int *fail_status);
+    void *ctx;
+} JobQueue;
+
 void job_control_init(void);
 void job_control_cleanup(void);
 void job_control_setup_terminal(void);
@@ -57,8 +99,11 @@ void job_list_remove(JobList *list, Job *job);
 Job* job_list_find_by_id(JobList *list, int job_id);
 Job* job_list_find_by_pgid(JobList *list, pid_t pgid);
 Job* job_list_find_by_pid(JobList *list, pid_t pid);
+Process* job_list_find_process(JobList *list, pid_t pid);
 
+void job_update(Job *job);
 void job_update_all(JobList *list);
+void job_reap_children(JobList *list);
 int job_is_completed(Job *job);
 int job_is_stopped(Job *job);
 
@@ -66,6 +111,7 @@ void job_list_print(JobList *list);
 void job_print(Job *job);
 const char* job_state_to_string(JobState state);
 void job_notify_completed(JobList *list);
+int job_has_pending_notifications(JobList *list);
 
 int job_kill(Job *job, int signal);
 int job_foreground(Job *job, int cont);
@@ -74,5 +120,17 @@ int job_background(Job *job, int cont);
 int job_control_get_terminal_fd(void);
 int job_control_is_interactive(void);
 
+int job_control_event_fd(void);
+void job_capture_output(Job *job, int fd, size_t capacity);
+void job_output_drain(JobList *list);
+size_t job_pollfds(JobList *list, struct pollfd *fds, size_t max);
+void job_poll_dispatch(JobList *list);
+pid_t job_wait_foreground(pid_t who, int *status, struct rusage *usage, Deadline *deadline);
+Job* job_find_any(JobList *list, int job_id);
+int job_wait_event(int timeout_ms);
+int job_exit_status(Job *job);
+int job_finished_status(pid_t pid);
+int job_queue_run(JobQueue *queue);
+Job* job_history_get(size_t index);
+
 void job_control_setup_signals(void);
-void job_handle_sigchld(int sig);
\ No newline at end of file
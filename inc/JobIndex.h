@@ -0,0 +1,24 @@
+//JobIndex.h
+#pragma once
+
+#include <stddef.h>
+
+#define JOB_INDEX_INITIAL_BUCKETS 64
+
+typedef struct JobIndexEntry {
+    long key;                       // PID, PGID или номер задачи
+    void *value;                    // Process* или Job*
+    struct JobIndexEntry *next;     // Следующий элемент в цепочке бакета
+} JobIndexEntry;
+
+typedef struct {
+    JobIndexEntry **buckets;
+    size_t bucket_count;
+    size_t count;
+} JobIndex;
+
+void job_index_init(JobIndex *index);
+int job_index_insert(JobIndex *index, long key, void *value);
+void *job_index_find(const JobIndex *index, long key);
+void job_index_remove(JobIndex *index, long key, const void *value);
+void job_index_free(JobIndex *index);
@@ -0,0 +1,24 @@
+//JobSched.h
+#pragma once
+
+#include <sched.h>
+#include <sys/types.h>
+
+// Параметры планирования задачи: привязка к CPU, nice, приоритет ввода-вывода
+typedef struct {
+    int set_affinity;
+    cpu_set_t affinity;
+    int set_nice;
+    int nice;
+    int set_ioprio;
+    int ioprio;             // Класс и уровень в формате ioprio_set
+} JobSched;
+
+void job_sched_init(JobSched *sched);
+
+int job_sched_parse_cpus(const char *spec, cpu_set_t *set);
+int job_sched_parse_nice(const char *spec, int *nice);
+int job_sched_parse_ioprio(const char *spec, int *ioprio);
+
+int job_sched_apply_self(const JobSched *sched);
+int job_sched_apply_group(pid_t pgid, const JobSched *sched);
@@ -0,0 +1,7 @@
+//JobStats.h
+#pragma once
+
+#include "JobControl.h"
+
+void job_stats_print_long(JobList *list);
+void job_stats_print_table(JobList *list);
@@ -2,27 +2,29 @@
 #pragma once
 
 #include "Token.h"
+#include "Arena.h"
 #include <stdlib.h>
 
+// Тексты токенов и сам массив токенов выделяются в арене строки
 typedef struct {
+    Arena *arena;
     const char *input;
     size_t pos;
     size_t len;
 } Lexer;
 
 typedef struct {
+    Arena *arena;
     Token *tokens;
     size_t count;
     size_t capacity;
 } TokenArray;
 
-void token_array_init(TokenArray *array);
+void token_array_init(TokenArray *array, Arena *arena);
 int token_array_push(TokenArray *array, Token token);
-void token_array_free(TokenArray *array);
 
-void lexer_init(Lexer *lexer, const char *input);
+void lexer_init(Lexer *lexer, const char *input, Arena *arena);
 void lexer_reset(Lexer *lexer, const char *input);
 void lexer_destroy(Lexer *lexer);
 Token lexer_tokenize(Lexer *lexer);
-void lexer_free_token(Token *token);
 int lexer_tokenize_all(Lexer *lexer, TokenArray *array);
\ No newline at end of file
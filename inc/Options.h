@@ -0,0 +1,17 @@
+//Options.h
+#pragma once
+
+typedef enum {
+    OPT_LASTPIPE,       // Последняя стадия pipeline-builtin выполняется в процессе shell
+    OPT_PIPEBUF,        // Размер буфера pipe в pipeline (0 - по умолчанию ядра)
+    OPT_BGCAPTURE,      // Вывод фоновых задач сохраняется в буфер вместо терминала
+    OPT_BGCAPSIZE,      // Размер буфера вывода одной фоновой задачи (0 - 64K)
+    OPT_PIPEFAIL,       // Код pipeline - код самой правой стадии с ненулевым кодом
+    OPT_COUNT
+} ShellOption;
+
+long shell_option_get(ShellOption opt);
+int shell_option_set(const char *spec, int enable);
+void shell_options_print(void);
+
+long parse_size(const char *str);
@@ -0,0 +1,21 @@
+//OutputRing.h
+#pragma once
+
+#include <stddef.h>
+
+#define OUTPUT_RING_DEFAULT_SIZE (64 * 1024)
+
+// Кольцевой буфер последних байт вывода фоновой задачи
+typedef struct {
+    char *data;
+    size_t capacity;
+    size_t start;       // Индекс самого старого байта
+    size_t length;      // Сколько байт сейчас в буфере
+    size_t dropped;     // Сколько старых байт вытеснено с последней очистки
+} OutputRing;
+
+OutputRing *output_ring_create(size_t capacity);
+void output_ring_free(OutputRing *ring);
+void output_ring_write(OutputRing *ring, const char *buf, size_t len);
+int output_ring_dump(const OutputRing *ring, int fd);
+void output_ring_clear(OutputRing *ring);
@@ -0,0 +1,24 @@
+//ParseCache.h
+#pragma once
+
+#include "AST.h"
+
+#define PARSE_CACHE_CAPACITY 64         // Строк в кеше
+#define PARSE_CACHE_BUCKETS 128         // Бакетов хеш-таблицы (степень двойки)
+#define PARSE_CACHE_MAX_LINE 65536      // Более длинные строки не кешируются
+
+typedef struct ParseCacheEntry {
+    struct ParseCacheEntry *next;       // Следующий в цепочке бакета или в списке свободных
+    struct ParseCacheEntry *lru_prev;   // Соседи в списке LRU (голова - последний использованный)
+    struct ParseCacheEntry *lru_next;
+    size_t hash;
+    const char *line;                   // Копия строки в arena, токены - её срезы
+    size_t len;
+    ASTNode *ast;
+    Arena arena;                        // Строка, токены и AST записи
+} ParseCacheEntry;
+
+ASTNode *parse_cache_get(const char *line);
+void parse_cache_clear(void);
+void parse_cache_print(void);
+void parse_cache_free(void);
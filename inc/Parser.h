@@ -4,9 +4,16 @@
 #include "AST.h"
 #include "Lexer.h"
 
+// Предел вложенности (subshell) и <(...)/>(...): разбор и выполнение вложенных
+// групп рекурсивны, глубже - ошибка разбора вместо переполнения стека
+#define PARSER_MAX_DEPTH 256
+
 typedef struct {
     TokenArray *tokens;
     size_t pos;
+    size_t depth;       // Текущая вложенность скобок
+    int too_deep;       // Превышен PARSER_MAX_DEPTH (сообщение уже выведено)
+    ASTArray nodes;     // Узлы дерева, резервируются parser_parse в арене токенов
 } Parser;
 
 void parser_init(Parser *parser, TokenArray *tokens);
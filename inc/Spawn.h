@@ -0,0 +1,40 @@
+//Spawn.h
+#pragma once
+
+#include "JobSched.h"
+
+#include <sys/types.h>
+#include <stddef.h>
+
+#define SPAWN_MAX_FD_ACTIONS 16
+#define SPAWN_PGID_INHERIT ((pid_t)-1)  // Остаться в группе родителя
+
+typedef enum {
+    SPAWN_FD_DUP2,      // dup2(fd, target)
+    SPAWN_FD_CLOSE      // close(fd)
+} SpawnFdActionType;
+
+typedef struct {
+    SpawnFdActionType type;
+    int fd;
+    int target;
+} SpawnFdAction;
+
+typedef struct {
+    pid_t pgid;         // 0 - новая группа, >0 - присоединиться, SPAWN_PGID_INHERIT - не менять
+    int background;     // Фоновая задача: SIGTTIN/SIGTTOU остаются игнорируемыми
+    SpawnFdAction actions[SPAWN_MAX_FD_ACTIONS];
+    size_t action_count;
+    int close_from;     // >= 0 - после dup2 закрыть все дескрипторы начиная с этого
+    const JobSched *sched;  // Привязка к CPU, nice, ioprio (NULL - как у shell)
+} SpawnOptions;
+
+void spawn_options_init(SpawnOptions *opts, pid_t pgid, int background);
+int spawn_options_dup2(SpawnOptions *opts, int fd, int target);
+int spawn_options_close(SpawnOptions *opts, int fd);
+void spawn_options_close_from(SpawnOptions *opts, int fd);
+const JobSched *spawn_set_sched(const JobSched *sched);
+
+pid_t spawn_command(char **args, const SpawnOptions *opts);
+void spawn_exec(char **args);
+void spawn_child_setup(const SpawnOptions *opts);
@@ -0,0 +1,46 @@
+//Timing.h
+#pragma once
+
+#include "AST.h"
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <time.h>
+
+typedef enum {
+    TIME_PHASE_FOREGROUND,  // Задача на переднем плане
+    TIME_PHASE_BACKGROUND,  // Задача в фоне (bg, &)
+    TIME_PHASE_STOPPED,     // Задача остановлена (Ctrl+Z)
+    TIME_PHASE_COUNT
+} TimePhase;
+
+typedef struct {
+    char *command;
+    pid_t pid;              // 0 - выполнена в процессе shell
+    struct timespec start;
+    struct timespec end;
+    struct rusage usage;
+    int done;
+} TimedStage;
+
+typedef struct TimeReport {
+    TimeFormat format;
+    struct timespec start;
+    TimedStage *stages;
+    size_t count;
+    size_t capacity;
+    TimePhase phase;                        // Текущее состояние задачи
+    struct timespec phase_start;
+    double phase_time[TIME_PHASE_COUNT];    // Секунды в каждом состоянии
+} TimeReport;
+
+TimeReport *time_report_create(TimeFormat format, TimePhase phase);
+void time_report_free(TimeReport *report);
+
+TimedStage *time_report_add_stage(TimeReport *report, pid_t pid, const char *command);
+void time_report_stage_done(TimedStage *stage, const struct rusage *usage);
+void time_report_self_begin(TimedStage *stage);
+void time_report_self_end(TimedStage *stage);
+int time_report_reaped(TimeReport *report, pid_t pid, const struct rusage *usage);
+void time_report_phase(TimeReport *report, TimePhase phase);
+void time_report_print(TimeReport *report);
@@ -17,6 +17,10 @@ typedef enum TokenType {
     TOKEN_REDIR_IN, // <
     TOKEN_REDIR_ERR, // &>
     TOKEN_REDIR_ERR_APPEND, // &>>
+    TOKEN_HEREDOC, // << (text - тело here-document после чтения)
+    TOKEN_HERESTRING, // <<<
+    TOKEN_PROCSUB_IN, // <( (закрывается TOKEN_RPAREN)
+    TOKEN_PROCSUB_OUT, // >( (закрывается TOKEN_RPAREN)
 
     TOKEN_SEMI, // ;
     TOKEN_AND, // &&
@@ -33,9 +37,13 @@ typedef enum QuoteCount {
     QUOTE_DOUBLE
 } QuoteCount;
 
+// Текст токена - срез (text, len) без завершающего '\0': указывает прямо
+// в Lexer.input, если кавычки и экранирование не меняют байты слова,
+// иначе в декодированную копию в арене строки
 typedef struct Token {
     TokenType type;
-    char *text;
-    QuoteCount quote;
-    size_t pos;
+    QuoteCount quote;   // Рядом с type: токен занимает 32 байта без выравнивания
+    const char *text;
+    size_t len;
+    size_t pos;         // Смещение начала токена в Lexer.input
 } Token;
\ No newline at end of file
@@ -1,7 +1,11 @@
 //AST.c
 #include "AST.h"
 #include <stdio.h>
-#include <assert.h>
+#include <string.h>
+
+// Узел - половина прежнего узла с указателями (48 байт): в кеш-линию их
+// помещается вдвое больше, а дети адресуются 32-битными смещениями
+_Static_assert(sizeof(ASTNode) <= 24, "ASTNode must stay within 24 bytes");
 
 static const char *redirect_type_to_str(RedirectType type){
     static const char *names[] = {
@@ -9,149 +13,268 @@ static const char *redirect_type_to_str(RedirectType type){
         [REDIR_OUT] = "REDIR_OUT",
         [REDIR_OUT_APPEND] = "REDIR_OUT_APPEND",
         [REDIR_ERR] = "REDIR_ERR",
-        [REDIR_ERR_APPEND] = "REDIR_ERR_APPEND"
+        [REDIR_ERR_APPEND] = "REDIR_ERR_APPEND",
+        [REDIR_HEREDOC] = "REDIR_HEREDOC",
+        [REDIR_HERESTRING] = "REDIR_HERESTRING"
     };
     return names[type];
 }
 
-ASTNode *ast_create_command(char **args, size_t argc){
-    ASTNode *node = malloc(sizeof(ASTNode));
-    assert(node && "ast_create_command: malloc failed");
+static const char *node_type_to_str(ASTNodeType type){
+    static const char *names[] = {
+        [AST_COMMAND] = "COMMAND",
+        [AST_PIPELINE] = "PIPELINE",
+        [AST_PIPELINE_ERR] = "PIPELINE_ERR",
+        [AST_SEQUENCE] = "SEQUENCE",
+        [AST_AND] = "AND",
+        [AST_OR] = "OR",
+        [AST_BACKGROUND] = "BACKGROUND",
+        [AST_SUBSHELL] = "SUBSHELL",
+        [AST_REDIRECT] = "REDIRECT",
+        [AST_TIME] = "TIME"
+    };
+    return names[type];
+}
+
+// Массив на capacity узлов в арене
+// Возвращает 0 при успехе, -1 при нехватке памяти или слишком большом дереве
+int ast_array_init(ASTArray *array, Arena *arena, uint32_t capacity){
+    array->count = 0;
+    array->capacity = 0;
+    array->nodes = NULL;
+    if(capacity == 0 || capacity > INT32_MAX){
+        fprintf(stderr, "ast_array_init: invalid capacity %u\n", capacity);
+        return -1;
+    }
+    array->nodes = arena_alloc(arena, (size_t)capacity * sizeof(ASTNode));
+    if(!array->nodes){
+        return -1;
+    }
+    array->capacity = capacity;
+    return 0;
+}
+
+// Узел-потомок по смещению ref (NULL для 0)
+ASTNode *ast_child(const ASTNode *node, ASTRef ref){
+    return ref ? (ASTNode *)node + ref : NULL;
+}
+
+// Смещение to от from в одном массиве (0 для NULL)
+ASTRef ast_ref(const ASTNode *from, const ASTNode *to){
+    return to ? (ASTRef)(to - from) : 0;
+}
+
+// Следующий узел массива; NULL, если массив заполнен (ёмкость резервирует
+// parser_parse по числу токенов - переполнение означает ошибку в этой оценке)
+static ASTNode *ast_alloc(ASTArray *array, ASTNodeType type){
+    if(array->count >= array->capacity){
+        fprintf(stderr, "ast_alloc: node array is full (%u nodes)\n", array->capacity);
+        return NULL;
+    }
+
+    ASTNode *node = &array->nodes[array->count++];
+    memset(node, 0, sizeof(ASTNode));
+    node->type = (uint8_t)type;
+    return node;
+}
+
+ASTNode *ast_create_command(ASTArray *array, char **args, size_t argc){
+    ASTNode *node = ast_alloc(array, AST_COMMAND);
+    if(!node){
+        return NULL;
+    }
 
-    node->type = AST_COMMAND;
     node->data.command.args = args;
-    node->data.command.argc = argc;
+    node->argc = (uint32_t)argc;
+    node->data.command.procsubs = NULL;
     return node;
 }
 
-ASTNode *ast_create_binary(ASTNodeType type, ASTNode *left, ASTNode *right){
-    ASTNode *node = malloc(sizeof(ASTNode));
-    assert(node && "ast_create_binary: malloc failed");
+ASTNode *ast_create_binary(ASTArray *array, ASTNodeType type, ASTNode *left, ASTNode *right){
+    ASTNode *node = ast_alloc(array, type);
+    if(!node){
+        return NULL;
+    }
 
-    node->type = type;
-    node->data.binary.left = left;
-    node->data.binary.right = right;
+    node->data.binary.left = ast_ref(node, left);
+    node->data.binary.right = ast_ref(node, right);
+    node->data.binary.pipe_size = 0;
     return node;
 }
 
-ASTNode *ast_create_subshell(ASTNode *inner){
-    ASTNode *node = malloc(sizeof(ASTNode));
-    assert(node && "ast_create_subshell: malloc failed");
+ASTNode *ast_create_subshell(ASTArray *array, ASTNode *inner){
+    ASTNode *node = ast_alloc(array, AST_SUBSHELL);
+    if(!node){
+        return NULL;
+    }
 
-    node->type = AST_SUBSHELL;
-    node->data.subshell = inner;
+    node->data.subshell = ast_ref(node, inner);
     return node;
 }
 
-ASTNode *ast_create_redirect(ASTNode *command, RedirectType redir_type, char *filename){
-    ASTNode *node = malloc(sizeof(ASTNode));
-    assert(node && "ast_create_redirect: malloc failed");
+ASTNode *ast_create_redirect(ASTArray *array, ASTNode *command, RedirectType redir_type, char *filename){
+    ASTNode *node = ast_alloc(array, AST_REDIRECT);
+    if(!node){
+        return NULL;
+    }
 
-    node->type = AST_REDIRECT;
-    node->data.redirect.type = redir_type;
-    node->data.redirect.command = command;
+    node->kind = (uint8_t)redir_type;
+    node->data.redirect.command = ast_ref(node, command);
     node->data.redirect.filename = filename;
     return node;
 }
 
-void ast_free(ASTNode *node){
-    if(!node) return;
-    
-    switch(node->type){
-        case AST_COMMAND:
-            if(node->data.command.args){
-                for(size_t i = 0; i < node->data.command.argc; i++){
-                    free(node->data.command.args[i]);
+ASTNode *ast_create_time(ASTArray *array, ASTNode *pipeline, TimeFormat format){
+    ASTNode *node = ast_alloc(array, AST_TIME);
+    if(!node){
+        return NULL;
+    }
+
+    node->kind = (uint8_t)format;
+    node->data.timed = ast_ref(node, pipeline);
+    return node;
+}
+
+// Первый узел поддерева в массиве: дети создаются раньше родителя,
+// поэтому поддерево - отрезок от самого левого потомка до корня
+ASTNode *ast_first(ASTNode *node){
+    for(;;){
+        ASTNode *next = NULL;
+        switch(node->type){
+            case AST_COMMAND:
+                if(node->procsub_count > 0){
+                    next = ast_child(node, node->data.command.procsubs[0].node);
                 }
-                free(node->data.command.args);
-            }
-            break;
-            
-        case AST_PIPELINE:
-        case AST_PIPELINE_ERR:
-        case AST_SEQUENCE:
-        case AST_AND:
-        case AST_OR:
-        case AST_BACKGROUND:
-            ast_free(node->data.binary.left);
-            ast_free(node->data.binary.right);
-            break;
-            
-        case AST_SUBSHELL:
-            ast_free(node->data.subshell);
-            break;
-            
-        case AST_REDIRECT:
-            ast_free(node->data.redirect.command);
-            free(node->data.redirect.filename);
-            break;
+                break;
+            case AST_SUBSHELL:
+                next = ast_child(node, node->data.subshell);
+                break;
+            case AST_REDIRECT:
+                next = ast_child(node, node->data.redirect.command);
+                break;
+            case AST_TIME:
+                next = ast_child(node, node->data.timed);
+                break;
+            default:
+                next = ast_child(node, node->data.binary.left);
+                break;
+        }
+        if(!next){
+            return node;
+        }
+        node = next;
     }
-    
-    free(node);
 }
 
+// Копия поддерева node в арене одним блоком (смещения остаются верными)
+// Массивы аргументов и строки общие с оригиналом
+// Возвращает корень копии или NULL при нехватке памяти
+ASTNode *ast_copy(Arena *arena, ASTNode *node){
+    ASTNode *first = ast_first(node);
+    size_t count = (size_t)(node - first) + 1;
+    ASTNode *copy = arena_alloc(arena, count * sizeof(ASTNode));
+    if(!copy){
+        return NULL;
+    }
+    memcpy(copy, first, count * sizeof(ASTNode));
+    return copy + (node - first);
+}
+
+// Стек обхода дерева без рекурсии: глубина дерева ограничена памятью,
+// а не стеком C (строки из тысяч && или вложенных скобок)
+void ast_stack_init(ASTStack *stack){
+    stack->items = NULL;
+    stack->count = 0;
+    stack->capacity = 0;
+}
+
+// Возвращает 0 при успехе, -1 при нехватке памяти
+int ast_stack_push(ASTStack *stack, ASTNode *node, int state){
+    if(stack->count == stack->capacity){
+        size_t capacity = stack->capacity ? stack->capacity * 2 : 32;
+        ASTStackItem *items = realloc(stack->items, capacity * sizeof(ASTStackItem));
+        if(!items){
+            perror("ast_stack_push: realloc failed");
+            return -1;
+        }
+        stack->items = items;
+        stack->capacity = capacity;
+    }
+    stack->items[stack->count].node = node;
+    stack->items[stack->count].state = state;
+    stack->count++;
+    return 0;
+}
+
+void ast_stack_free(ASTStack *stack){
+    free(stack->items);
+    ast_stack_init(stack);
+}
+
+// Отладочный вывод дерева с отступами
+// Обход с явным стеком; state в стеке - отступ узла
 void ast_print(ASTNode *node, int indent){
     if(!node) return;
-    
-    for(int i = 0; i < indent; i++){
-        printf(" ");
+
+    ASTStack stack;
+    ast_stack_init(&stack);
+    if(ast_stack_push(&stack, node, indent) < 0){
+        return;
     }
-    
-    switch(node->type){
-        case AST_COMMAND:
-            printf("COMMAND:");
-            for(size_t i = 0; i < node->data.command.argc; i++){
-                printf(" %s", node->data.command.args[i]);
+
+    while(stack.count > 0){
+        ASTStackItem item = stack.items[--stack.count];
+        node = item.node;
+        indent = item.state;
+
+        printf("%*s", indent, "");
+        switch(node->type){
+            case AST_COMMAND:
+                printf("COMMAND:");
+                for(size_t i = 0; i < node->argc; i++){
+                    printf(" %s", node->data.command.args[i]);
+                }
+                printf("\n");
+                // Подстановки со своими поддеревьями - в порядке аргументов
+                for(size_t i = node->procsub_count; i-- > 0;){
+                    ast_stack_push(&stack, ast_child(node, node->data.command.procsubs[i].node), indent + 4);
+                }
+                for(size_t i = 0; i < node->procsub_count; i++){
+                    printf("%*sPROCSUBST: arg=%u %s\n", indent + 2, "",
+                           node->data.command.procsubs[i].arg_index,
+                           node->data.command.procsubs[i].output ? "out" : "in");
+                }
+                break;
+
+            case AST_SUBSHELL:
+                printf("SUBSHELL\n");
+                ast_stack_push(&stack, ast_child(node, node->data.subshell), indent + 2);
+                break;
+
+            case AST_REDIRECT:
+                printf("REDIRECT: type=%s file=%s\n",
+                       redirect_type_to_str(node->kind),
+                       node->data.redirect.filename);
+                ast_stack_push(&stack, ast_child(node, node->data.redirect.command), indent + 2);
+                break;
+
+            case AST_TIME:
+                printf("TIME: format=%d\n", node->kind);
+                ast_stack_push(&stack, ast_child(node, node->data.timed), indent + 2);
+                break;
+
+            default: {
+                // Бинарные узлы: правый кладётся первым, чтобы левый вывелся раньше
+                printf("%s\n", node_type_to_str(node->type));
+                ASTNode *right = ast_child(node, node->data.binary.right);
+                if(right){
+                    ast_stack_push(&stack, right, indent + 2);
+                }
+                ast_stack_push(&stack, ast_child(node, node->data.binary.left), indent + 2);
+                break;
             }
-            printf("\n");
-            break;
-            
-        case AST_PIPELINE:
-            printf("PIPELINE\n");
-            ast_print(node->data.binary.left, indent + 2);
-            ast_print(node->data.binary.right, indent + 2);
-            break;
-            
-        case AST_PIPELINE_ERR:
-            printf("PIPELINE_ERR\n");
-            ast_print(node->data.binary.left, indent + 2);
-            ast_print(node->data.binary.right, indent + 2);
-            break;
-            
-        case AST_SEQUENCE:
-            printf("SEQUENCE\n");
-            ast_print(node->data.binary.left, indent + 2);
-            ast_print(node->data.binary.right, indent + 2);
-            break;
-            
-        case AST_AND:
-            printf("AND\n");
-            ast_print(node->data.binary.left, indent + 2);
-            ast_print(node->data.binary.right, indent + 2);
-            break;
-            
-        case AST_OR:
-            printf("OR\n");
-            ast_print(node->data.binary.left, indent + 2);
-            ast_print(node->data.binary.right, indent + 2);
-            break;
-            
-        case AST_BACKGROUND:
-            printf("BACKGROUND\n");
-            ast_print(node->data.binary.left, indent + 2);
-            ast_print(node->data.binary.right, indent + 2);
-            break;
-            
-        case AST_SUBSHELL:
-            printf("SUBSHELL\n");
-            ast_print(node->data.subshell, indent + 2);
-            break;
-            
-        case AST_REDIRECT:
-            printf("REDIRECT: type=%s file=%s\n",
-                   redirect_type_to_str(node->data.redirect.type),
-                   node->data.redirect.filename);
-            ast_print(node->data.redirect.command, indent + 2);
-            break;
+        }
     }
-}
\ No newline at end of file
+
+    ast_stack_free(&stack);
+}
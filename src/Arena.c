@@ -0,0 +1,134 @@
+// Arena.c
+// Арена (bump-аллокатор) для разбора и выполнения одной командной строки
+// Выделение - сдвиг указателя в текущем блоке, блоки берутся через malloc
+// только когда текущий заполнен. arena_reset за O(1) возвращает арену к
+// первому блоку: блоки не освобождаются и переиспользуются следующими
+// строками, так что в установившемся режиме цикл lex/expand/parse/execute
+// не вызывает malloc/free для токенов и узлов AST
+
+#include "Arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+static size_t align_up(size_t size){
+    return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+void arena_init(Arena *arena, size_t block_size){
+    arena->head = NULL;
+    arena->current = NULL;
+    arena->last = NULL;
+    arena->block_size = block_size ? block_size : ARENA_BLOCK_SIZE;
+}
+
+static ArenaBlock *arena_new_block(Arena *arena, size_t size){
+    size_t data_size = size > arena->block_size ? size : arena->block_size;
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + data_size);
+    if(!block){
+        perror("arena: malloc failed");
+        return NULL;
+    }
+    block->next = NULL;
+    block->size = data_size;
+    block->used = 0;
+    return block;
+}
+
+// Выделение size байт, выровненных для любого типа
+// Возвращает NULL при нехватке памяти
+void *arena_alloc(Arena *arena, size_t size){
+    size = align_up(size ? size : 1);
+
+    // Блоки после текущего остались от прошлых строк - начинаем их заново
+    ArenaBlock *prev = NULL;
+    ArenaBlock *block = arena->current;
+    while(block && block->used + size > block->size){
+        prev = block;
+        block = block->next;
+        if(block){
+            block->used = 0;
+        }
+    }
+
+    if(!block){
+        block = arena_new_block(arena, size);
+        if(!block){
+            return NULL;
+        }
+        if(prev){
+            prev->next = block;
+        } else {
+            arena->head = block;
+        }
+    }
+
+    arena->current = block;
+    void *ptr = block->data + block->used;
+    block->used += size;
+    arena->last = ptr;
+    return ptr;
+}
+
+// Изменение размера выделения ptr (old_size - его текущий размер)
+// Последнее выделение растёт или сжимается на месте, остальные копируются
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size){
+    if(!ptr){
+        return arena_alloc(arena, new_size);
+    }
+
+    ArenaBlock *block = arena->current;
+    if(ptr == arena->last && block){
+        size_t offset = (size_t)((char *)ptr - block->data);
+        size_t size = align_up(new_size ? new_size : 1);
+        if(offset + size <= block->size){
+            block->used = offset + size;
+            return ptr;
+        }
+    }
+    if(new_size <= old_size){
+        return ptr;
+    }
+
+    void *copy = arena_alloc(arena, new_size);
+    if(copy){
+        memcpy(copy, ptr, old_size < new_size ? old_size : new_size);
+    }
+    return copy;
+}
+
+char *arena_strndup(Arena *arena, const char *str, size_t len){
+    char *copy = arena_alloc(arena, len + 1);
+    if(copy){
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+char *arena_strdup(Arena *arena, const char *str){
+    return arena_strndup(arena, str, strlen(str));
+}
+
+// Освобождение всех выделений за O(1): блоки остаются для повторного использования
+void arena_reset(Arena *arena){
+    arena->current = arena->head;
+    arena->last = NULL;
+    if(arena->head){
+        arena->head->used = 0;
+    }
+}
+
+// Возврат всех блоков системе
+void arena_free(Arena *arena){
+    ArenaBlock *block = arena->head;
+    while(block){
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(arena, arena->block_size);
+}
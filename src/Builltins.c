@@ -1,13 +1,25 @@
 //Builtins.c
 #include "Builtins.h"
 #include "JobControl.h"
+#include "JobStats.h"
 #include "History.h"
+#include "CommandHash.h"
+#include "Options.h"
+#include "Lexer.h"
+#include "ParseCache.h"
+#include "Parser.h"
+#include "Executor.h"
+#include "JobSched.h"
+#include "Spawn.h"
+#include "Deadline.h"
 
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <signal.h>
+#include <time.h>
+#include <fcntl.h>
 
 #define PATH_MAX_SIZE 1024
 #define ENV_MAX_NAME 128
@@ -22,11 +34,17 @@ static int builtin_jobs(char **args);
 static int builtin_fg(char **args);
 static int builtin_bg(char **args);
 static int builtin_kill(char **args);
+static int builtin_wait(char **args);
+static int builtin_jobq(char **args);
+static int builtin_jobctl(char **args);
+static int builtin_timeout(char **args);
 static int builtin_set(char **args);
 static int builtin_unset(char **args);
 static int builtin_unset(char **args);
 //static int builtin_ls(char **args);
 static int builtin_history(char **args);
+static int builtin_hash(char **args);
+static int builtin_parsecache(char **args);
 
 // Проверка, является ли команда встроенной
 int is_builtin(const char *command) {
@@ -40,10 +58,16 @@ int is_builtin(const char *command) {
         "fg",
         "bg",
         "kill",
+        "wait",
+        "jobq",
+        "jobctl",
+        "timeout",
         "set",
         "unset",
         //"ls",
         "history",
+        "hash",
+        "parsecache",
         NULL
     };
     
@@ -55,6 +79,26 @@ int is_builtin(const char *command) {
     return 0;
 }
 
+// Может ли builtin выполняться в процессе shell внутри pipeline
+// "Чистые" builtins только выводят данные и не меняют состояние shell,
+// поэтому их выполнение без fork не отличается от выполнения в подпроцессе
+int builtin_is_pure(char **args){
+    if(!args || !args[0]){
+        return 0;
+    }
+
+    if(strcmp(args[0], "echo") == 0 || strcmp(args[0], "pwd") == 0 ||
+       strcmp(args[0], "help") == 0 || strcmp(args[0], "jobs") == 0){
+        return 1;
+    }
+    // history clear, hash и parsecache с аргументами меняют состояние
+    if(strcmp(args[0], "history") == 0 || strcmp(args[0], "hash") == 0 ||
+       strcmp(args[0], "parsecache") == 0){
+        return args[1] == NULL;
+    }
+    return 0;
+}
+
 // Диспетчер встроенных команд
 // Вызывает соответствующую функцию в зависимости от args[0]
 int execute_builtin(char **args){
@@ -85,6 +129,18 @@ int execute_builtin(char **args){
     else if(strcmp(args[0], "kill") == 0){
         return builtin_kill(args);
     }
+    else if(strcmp(args[0], "wait") == 0){
+        return builtin_wait(args);
+    }
+    else if(strcmp(args[0], "jobq") == 0){
+        return builtin_jobq(args);
+    }
+    else if(strcmp(args[0], "jobctl") == 0){
+        return builtin_jobctl(args);
+    }
+    else if(strcmp(args[0], "timeout") == 0){
+        return builtin_timeout(args);
+    }
     else if(strcmp(args[0], "set") == 0){
         return builtin_set(args);
     }
@@ -97,6 +153,12 @@ int execute_builtin(char **args){
     else if(strcmp(args[0], "history") == 0){
         return builtin_history(args);
     }
+    else if(strcmp(args[0], "hash") == 0){
+        return builtin_hash(args);
+    }
+    else if(strcmp(args[0], "parsecache") == 0){
+        return builtin_parsecache(args);
+    }
 
     fprintf(stderr, "%s: builtin not found\n", args[0]);
     return 1;
@@ -206,25 +268,76 @@ static int builtin_help(char **args){
     printf("  echo [args]       Print arguments\n");
     printf("  exit [code]       Exit shell\n");
     printf("  help              Show this help\n");
-    printf("  jobs              List all jobs\n");
+    printf("  jobs [-l|--stats] List all jobs (with pids / resource usage)\n");
+    printf("  jobs -o [%%id]     Show captured output of a job (set -o bgcapture)\n");
     printf("  fg [%%job_id]      Bring job to foreground\n");
     printf("  bg [%%job_id]      Resume job in background\n");
     printf("  kill [-sig] [%%id] Send signal to job (default: SIGTERM)\n");
+    printf("  wait [-n] [-t sec] [%%id|pid...]  Wait for jobs to finish\n");
+    printf("  jobq [-j N] [--halt-on-error] [cmd...]  Run commands (or stdin lines), N at a time\n");
+    printf("  jobctl affinity|nice|ionice %%id VALUE  Change CPU set, nice or I/O class of a job\n");
+    printf("  jobctl run [-a cpus] [-n nice] [-i class] cmd...  Run command with these settings\n");
+    printf("  jobctl ttl [-s sig] [-k dur] %%id DURATION  Signal job when DURATION expires (0 - cancel)\n");
+    printf("  timeout [-s sig] [-k dur] DURATION cmd...  Run command with a deadline (exit 124)\n");
     printf("  set [VAR=value]   Set environment variable (no args: print all)\n");
+    printf("  set -o|+o [name]  Enable/disable shell option (lastpipe, pipebuf=SIZE,\n");
+    printf("                    bgcapture, bgcapsize=SIZE, pipefail)\n");
     printf("  unset [VAR]       Unset environment variable\n");
     printf("  history [clear]   Show command history or clear it\n");
+    printf("  hash [-r] [-p path] [name...]  Show, reset or fill command path cache\n");
+    printf("  parsecache [-r]   Show parsed line cache hits/misses or reset it\n");
     return 0;
 }
 
+// jobs -o [%N]: вывод, накопленный задачей при set -o bgcapture
+// Без номера - текущая задача (или последняя завершённая);
+// доступен и для недавно завершённых задач
+static int jobs_print_output(JobList *list, const char *spec){
+    Job *job = list->tail ? list->tail : job_history_get(0);
+    if(spec){
+        job = job_find_any(list, atoi(spec[0] == '%' ? spec + 1 : spec));
+    }
+    if(!job){
+        fprintf(stderr, "jobs: %s: no such job\n", spec ? spec : "current");
+        return 1;
+    }
+    if(!job->output){
+        fprintf(stderr, "jobs: %%%d: output is not captured (set -o bgcapture)\n", job->job_id);
+        return 1;
+    }
+
+    job_output_drain(list);
+    fflush(stdout);
+    return output_ring_dump(job->output, STDOUT_FILENO) < 0 ? 1 : 0;
+}
+
 // Вывод списка фоновых задач
+// jobs -o [%N] - накопленный вывод задачи (set -o bgcapture)
+// jobs -l - с PID процессов, временем работы, CPU и пиковым RSS
+// jobs --stats - таблица ресурсов, включая недавно завершённые задачи
 static int builtin_jobs(char **args){
-    (void)args;
     JobList *list = job_list_get();
-    job_list_print(list);
+    // Статусы обновляются без обработчика SIGCHLD - проверяем перед выводом
+    job_update_all(list);
+
+    if(args[1] == NULL){
+        job_list_print(list);
+    } else if(strcmp(args[1], "-o") == 0){
+        return jobs_print_output(list, args[2]);
+    } else if(strcmp(args[1], "-l") == 0){
+        job_stats_print_long(list);
+    } else if(strcmp(args[1], "--stats") == 0){
+        job_stats_print_table(list);
+    } else {
+        fprintf(stderr, "jobs: %s: invalid option\n", args[1]);
+        fprintf(stderr, "jobs: usage: jobs [-l | --stats | -o [%%job_id]]\n");
+        return 2;
+    }
     return 0;
 }
 
 // Перевод задачи на передний план
+// Возвращает код завершения задачи, как wait
 // Без аргументов берёт последнюю задачу (tail)
 static int builtin_fg(char **args){
     JobList *list = job_list_get();
@@ -269,7 +382,9 @@ static int builtin_fg(char **args){
         return 1;
     }
     
-    return 0;
+    // Код как у wait: последняя стадия (или pipefail), 128+N для сигнала
+    // и повторной остановки, 124 если задачу снял jobctl ttl
+    return job_exit_status(job);
 }
 
 // Возобновление остановленной задачи в фоне
@@ -311,6 +426,33 @@ static int builtin_bg(char **args){
     return 0;
 }
 
+// Номер сигнала по имени (TERM, SIGTERM) или числу
+// Возвращает -1 для неизвестного сигнала
+static int parse_signal(const char *name){
+    static const struct { const char *name; int sig; } signals[] = {
+        { "HUP", SIGHUP }, { "INT", SIGINT }, { "QUIT", SIGQUIT },
+        { "KILL", SIGKILL }, { "USR1", SIGUSR1 }, { "USR2", SIGUSR2 },
+        { "ALRM", SIGALRM }, { "TERM", SIGTERM }, { "CONT", SIGCONT },
+        { "STOP", SIGSTOP }, { "TSTP", SIGTSTP },
+    };
+
+    if(strncmp(name, "SIG", 3) == 0){
+        name += 3;
+    }
+    for(size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++){
+        if(strcmp(name, signals[i].name) == 0){
+            return signals[i].sig;
+        }
+    }
+
+    char *end;
+    long sig = strtol(name, &end, 10);
+    if(end == name || *end != '\0' || sig <= 0 || sig >= NSIG){
+        return -1;
+    }
+    return (int)sig;
+}
+
 // Отправка сигнала задаче
 // Поддерживает: kill %job_id, kill -SIGNAL %job_id
 static int builtin_kill(char **args){
@@ -325,20 +467,10 @@ static int builtin_kill(char **args){
     if(args[1][0] == '-' && args[1][1] != '\0'){
         const char *sig_str = args[1] + 1;
         
-        if(strcmp(sig_str, "STOP") == 0) sig = SIGSTOP;
-        else if(strcmp(sig_str, "CONT") == 0) sig = SIGCONT;
-        else if(strcmp(sig_str, "TERM") == 0) sig = SIGTERM;
-        else if(strcmp(sig_str, "KILL") == 0) sig = SIGKILL;
-        else if(strcmp(sig_str, "INT") == 0) sig = SIGINT;
-        else if(strcmp(sig_str, "HUP") == 0) sig = SIGHUP;
-        else if(strcmp(sig_str, "QUIT") == 0) sig = SIGQUIT;
-        else if(strcmp(sig_str, "TSTP") == 0) sig = SIGTSTP;
-        else {
-            sig = atoi(sig_str);
-            if(sig <= 0){
-                fprintf(stderr, "kill: invalid signal: %s\n", sig_str);
-                return 1;
-            }
+        sig = parse_signal(sig_str);
+        if(sig <= 0){
+            fprintf(stderr, "kill: invalid signal: %s\n", sig_str);
+            return 1;
         }
         
         arg_idx = 2;
@@ -389,6 +521,571 @@ static int builtin_kill(char **args){
     return 0;
 }
 
+// Цель команды wait: задача целиком (%N) или один её процесс (PID)
+typedef struct {
+    Job *job;
+    Process *proc;      // NULL - ждать всю задачу
+} WaitTarget;
+
+// Разбор спецификации задачи: %N, %%, %+, %- или PID
+// Возвращает 0 и заполняет target, 1 - цель не найдена,
+// 2 - PID уже удалённой задачи (статус в *status)
+static int wait_resolve(const char *spec, WaitTarget *target, int *status){
+    JobList *list = job_list_get();
+    target->job = NULL;
+    target->proc = NULL;
+
+    if(spec[0] == '%'){
+        if(strcmp(spec, "%%") == 0 || strcmp(spec, "%+") == 0 || spec[1] == '\0'){
+            target->job = list->tail;
+        } else if(strcmp(spec, "%-") == 0){
+            target->job = list->tail ? list->tail->prev : NULL;
+        } else {
+            target->job = job_list_find_by_id(list, atoi(spec + 1));
+        }
+        return target->job ? 0 : 1;
+    }
+
+    char *end;
+    long pid = strtol(spec, &end, 10);
+    if(end == spec || *end != '\0' || pid <= 0){
+        return 1;
+    }
+    target->proc = job_list_find_process(list, (pid_t)pid);
+    if(target->proc){
+        target->job = target->proc->job;
+        return 0;
+    }
+    *status = job_finished_status((pid_t)pid);
+    return *status >= 0 ? 2 : 1;
+}
+
+// Цель завершилась (или остановилась - тогда wait тоже возвращается)
+static int wait_target_done(WaitTarget *t){
+    if(t->proc){
+        return t->proc->state != PROC_RUNNING;
+    }
+    return t->job->state == JOB_COMPLETED || t->job->state == JOB_STOPPED;
+}
+
+static int wait_target_status(WaitTarget *t){
+    return t->proc ? t->proc->exit_status : job_exit_status(t->job);
+}
+
+// Ожидание завершения фоновых задач
+// wait - все работающие задачи, код 0
+// wait %N|PID... - указанные задачи, код последней
+// wait -n [%N|PID...] - первая завершившаяся из указанных (или любых)
+// wait -t SEC - не дольше SEC секунд, по истечении код 124
+// Ожидание блокирующее: poll по signalfd SIGCHLD без опроса в цикле,
+// Ctrl+C прерывает ожидание с кодом 130
+static int builtin_wait(char **args){
+    int any = 0;
+    double timeout = -1;
+    size_t i = 1;
+
+    for(; args[i] && args[i][0] == '-' && args[i][1] != '\0'; i++){
+        if(strcmp(args[i], "--") == 0){
+            i++;
+            break;
+        }
+        if(strcmp(args[i], "-n") == 0){
+            any = 1;
+        } else if(strcmp(args[i], "-t") == 0){
+            char *end;
+            timeout = args[i + 1] ? strtod(args[i + 1], &end) : -1;
+            if(!args[i + 1] || *end != '\0' || timeout < 0){
+                fprintf(stderr, "wait: -t: expected timeout in seconds\n");
+                return 2;
+            }
+            i++;
+        } else {
+            fprintf(stderr, "wait: %s: invalid option\n", args[i]);
+            fprintf(stderr, "wait: usage: wait [-n] [-t seconds] [%%job_id|pid...]\n");
+            return 2;
+        }
+    }
+
+    JobList *list = job_list_get();
+    size_t count = 0;
+    for(size_t k = i; args[k]; k++){
+        count++;
+    }
+    if(count == 0){
+        for(Job *j = list->head; j; j = j->next){
+            count++;
+        }
+    }
+
+    WaitTarget *targets = malloc((count ? count : 1) * sizeof(WaitTarget));
+    if(!targets){
+        perror("wait: malloc");
+        return 1;
+    }
+
+    // Разрешаем цели до ожидания: задачи удаляются из списка только в REPL
+    size_t n = 0;
+    int status = 0;
+    int explicit = args[i] != NULL;
+    if(explicit){
+        for(; args[i]; i++){
+            int finished_status = 0;
+            int rc = wait_resolve(args[i], &targets[n], &finished_status);
+            if(rc == 0){
+                n++;
+            } else if(rc == 2){
+                // Процесс уже собран и уведомлён - сразу известен статус
+                status = finished_status;
+                if(any){
+                    free(targets);
+                    return status;
+                }
+            } else {
+                fprintf(stderr, "wait: %s: no such job\n", args[i]);
+                status = 127;
+            }
+        }
+    } else {
+        for(Job *j = list->head; j; j = j->next){
+            // Остановленные задачи не завершатся без fg/bg
+            if(j->state == JOB_STOPPED || (any && j->waited)){
+                continue;
+            }
+            targets[n].job = j;
+            targets[n].proc = NULL;
+            n++;
+        }
+        if(any && n == 0){
+            free(targets);
+            return 127;
+        }
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    if(timeout >= 0){
+        deadline.tv_sec += (time_t)timeout;
+        deadline.tv_nsec += (long)((timeout - (double)(time_t)timeout) * 1e9);
+        if(deadline.tv_nsec >= 1000000000L){
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    int result = -1;
+    while(result < 0){
+        // Проверяем только процессы целей: wait может выполняться внутри
+        // pipeline, и чужие потомки собираться не должны
+        size_t pending = 0;
+        for(size_t k = 0; k < n; k++){
+            job_update(targets[k].job);
+            if(!wait_target_done(&targets[k])){
+                pending++;
+            } else if(any){
+                targets[k].job->waited = 1;
+                result = wait_target_status(&targets[k]);
+                break;
+            }
+        }
+        if(result >= 0){
+            break;
+        }
+        if(pending == 0){
+            // Все цели завершены: код последней указанной
+            if(n > 0 && explicit){
+                status = wait_target_status(&targets[n - 1]);
+            }
+            for(size_t k = 0; k < n; k++){
+                targets[k].job->waited = 1;
+            }
+            result = status;
+            break;
+        }
+
+        int timeout_ms = -1;
+        if(timeout >= 0){
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long left = (deadline.tv_sec - now.tv_sec) * 1000L + (deadline.tv_nsec - now.tv_nsec) / 1000000L;
+            if(left <= 0){
+                result = 124;
+                break;
+            }
+            timeout_ms = (int)left;
+        }
+
+        int ev = job_wait_event(timeout_ms);
+        if(ev == JOB_WAIT_INTERRUPTED){
+            result = 130;
+        }
+    }
+
+    free(targets);
+    return result;
+}
+
+// Источник элементов jobq: аргументы или строки stdin
+typedef struct {
+    char **items;       // NULL - читать stdin
+    size_t pos;
+    int stdin_fd;       // stdin элементов (/dev/null при чтении списка из stdin)
+    Arena arena;        // Разбор элемента; сбрасывается перед следующим
+} JobqSource;
+
+static char *jobq_next(void *ctx){
+    JobqSource *src = ctx;
+    if(src->items){
+        return src->items[src->pos] ? strdup(src->items[src->pos++]) : NULL;
+    }
+
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    while((len = getline(&line, &cap, stdin)) >= 0){
+        while(len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')){
+            line[--len] = '\0';
+        }
+        if(len > 0){
+            return line;
+        }
+    }
+    free(line);
+    clearerr(stdin);
+    return NULL;
+}
+
+// Разбор строки элемента и запуск в фоне, как с &
+static pid_t jobq_launch(const char *item, void *ctx, int *fail_status){
+    JobqSource *src = ctx;
+    Lexer lexer;
+    TokenArray tokens;
+    pid_t pid = -1;
+
+    *fail_status = 2;
+    arena_reset(&src->arena);
+    lexer_init(&lexer, item, &src->arena);
+    if(!lexer_tokenize_all(&lexer, &tokens)){
+        lexer_destroy(&lexer);
+        return -1;
+    }
+    Parser parser;
+    parser_init(&parser, &tokens);
+    ASTNode *ast = parser_parse(&parser);
+    if(ast){
+        pid = executor_launch(ast, src->stdin_fd, -1, fail_status);
+    }
+
+    lexer_destroy(&lexer);
+    return pid;
+}
+
+// Очередь команд с ограничением параллельности
+// jobq [-j N] [--halt-on-error] [--] [команда...]
+// Без команд в аргументах читает по одной команде на строку из stdin
+// -j N - сколько элементов работает одновременно (по умолчанию - число CPU)
+// --halt-on-error - после первой ошибки новые элементы не запускаются,
+// работающие дожидаются
+// Код каждого элемента выводится в stderr по мере завершения
+static int builtin_jobq(char **args){
+    long limit = sysconf(_SC_NPROCESSORS_ONLN);
+    int halt_on_error = 0;
+    size_t i = 1;
+
+    for(; args[i] && args[i][0] == '-'; i++){
+        if(strcmp(args[i], "--") == 0){
+            i++;
+            break;
+        }
+        if(strcmp(args[i], "--halt-on-error") == 0){
+            halt_on_error = 1;
+        } else if(strncmp(args[i], "-j", 2) == 0){
+            const char *value = args[i][2] ? args[i] + 2 : args[++i];
+            char *end;
+            limit = value ? strtol(value, &end, 10) : 0;
+            if(!value || *end != '\0' || limit <= 0){
+                fprintf(stderr, "jobq: -j: expected positive number\n");
+                return 2;
+            }
+        } else {
+            fprintf(stderr, "jobq: %s: invalid option\n", args[i]);
+            fprintf(stderr, "jobq: usage: jobq [-j N] [--halt-on-error] [command...]\n");
+            return 2;
+        }
+    }
+
+    JobqSource src = { args[i] ? &args[i] : NULL, 0, -1, { 0 } };
+    arena_init(&src.arena, ARENA_BLOCK_SIZE);
+    if(!src.items){
+        src.stdin_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+
+    JobQueue queue = {
+        .limit = limit > 0 ? (size_t)limit : 1,
+        .halt_on_error = halt_on_error,
+        .next = jobq_next,
+        .launch = jobq_launch,
+        .ctx = &src
+    };
+    int status = job_queue_run(&queue);
+    arena_free(&src.arena);
+
+    if(src.stdin_fd >= 0){
+        close(src.stdin_fd);
+    }
+    return status;
+}
+
+// Разбор значения параметра планирования: affinity (0-7,12), nice (-20..19),
+// ionice (idle, be[:N], rt[:N], none)
+// Возвращает 0 при успехе, -1 при ошибке (сообщение выведено)
+static int jobctl_parse(const char *what, const char *value, JobSched *sched){
+    if(strcmp(what, "affinity") == 0){
+        if(job_sched_parse_cpus(value, &sched->affinity) < 0){
+            fprintf(stderr, "jobctl: %s: invalid CPU list (expected e.g. 0-7,12)\n", value);
+            return -1;
+        }
+        sched->set_affinity = 1;
+    } else if(strcmp(what, "nice") == 0){
+        if(job_sched_parse_nice(value, &sched->nice) < 0){
+            fprintf(stderr, "jobctl: %s: nice must be between -20 and 19\n", value);
+            return -1;
+        }
+        sched->set_nice = 1;
+    } else if(strcmp(what, "ionice") == 0){
+        if(job_sched_parse_ioprio(value, &sched->ioprio) < 0){
+            fprintf(stderr, "jobctl: %s: expected idle, be[:0-7], rt[:0-7] or none\n", value);
+            return -1;
+        }
+        sched->set_ioprio = 1;
+    } else {
+        fprintf(stderr, "jobctl: %s: unknown setting\n", what);
+        return -1;
+    }
+    return 0;
+}
+
+// Выполнение команды из аргументов builtin (args - до NULL) как обычной команды:
+// передний план, Ctrl+Z, time, $PIPESTATUS
+static int execute_args(char **args){
+    size_t argc = 0;
+    while(args[argc]){
+        argc++;
+    }
+
+    // Узел ссылается на args вызывающего, в арене только он сам
+    // Слова уже раскрыты при вызове builtin - флаг раскрытия не ставится
+    Arena arena;
+    ASTArray nodes;
+    arena_init(&arena, sizeof(ASTNode));
+    if(ast_array_init(&nodes, &arena, 1) < 0){
+        arena_free(&arena);
+        return 1;
+    }
+    ASTNode *node = ast_create_command(&nodes, args, argc);
+    int status = executor_execute(node);
+    arena_free(&arena);
+    return status;
+}
+
+// jobctl run: запуск команды с параметрами планирования
+// Параметры применяет дочерний процесс перед exec, без taskset/nice/ionice
+static int jobctl_run(char **args){
+    JobSched sched;
+    job_sched_init(&sched);
+    size_t i = 1;
+
+    for(; args[i] && args[i][0] == '-'; i++){
+        if(strcmp(args[i], "--") == 0){
+            i++;
+            break;
+        }
+        const char *what = strcmp(args[i], "-a") == 0 ? "affinity" :
+                           strcmp(args[i], "-n") == 0 ? "nice" :
+                           strcmp(args[i], "-i") == 0 ? "ionice" : NULL;
+        if(!what){
+            fprintf(stderr, "jobctl: run: %s: invalid option\n", args[i]);
+            return 2;
+        }
+        if(!args[i + 1]){
+            fprintf(stderr, "jobctl: run: %s: option requires a value\n", args[i]);
+            return 2;
+        }
+        if(jobctl_parse(what, args[++i], &sched) < 0){
+            return 2;
+        }
+    }
+    if(!args[i]){
+        fprintf(stderr, "jobctl: usage: jobctl run [-a cpus] [-n nice] [-i class] command...\n");
+        return 2;
+    }
+
+    // Все запуски команды получают параметры через SpawnOptions
+    const JobSched *prev = spawn_set_sched(&sched);
+    int status = execute_args(args + i);
+    spawn_set_sched(prev);
+    return status;
+}
+
+// Опции срока: -s SIG (сигнал по истечении, по умолчанию TERM) и
+// -k DURATION (SIGKILL через DURATION после сигнала)
+// *i - индекс первого аргумента, после разбора - первого не-опции
+// Возвращает 0 при успехе, 2 при ошибке (сообщение выведено)
+static int deadline_options(const char *name, char **args, size_t *i, int *sig,
+                            struct timespec *kill_after){
+    *sig = SIGTERM;
+    kill_after->tv_sec = 0;
+    kill_after->tv_nsec = 0;
+
+    for(; args[*i] && args[*i][0] == '-' && args[*i][1] != '\0'; (*i)++){
+        const char *opt = args[*i];
+        if(strcmp(opt, "--") == 0){
+            (*i)++;
+            break;
+        }
+        if(strcmp(opt, "-s") != 0 && strcmp(opt, "-k") != 0){
+            fprintf(stderr, "%s: %s: invalid option\n", name, opt);
+            return 2;
+        }
+        const char *value = args[++(*i)];
+        if(!value){
+            fprintf(stderr, "%s: %s: option requires a value\n", name, opt);
+            return 2;
+        }
+        if(opt[1] == 's' && (*sig = parse_signal(value)) <= 0){
+            fprintf(stderr, "%s: %s: invalid signal\n", name, value);
+            return 2;
+        }
+        if(opt[1] == 'k' && parse_duration(value, kill_after) < 0){
+            fprintf(stderr, "%s: %s: invalid duration\n", name, value);
+            return 2;
+        }
+    }
+    return 0;
+}
+
+// jobctl ttl [-s SIG] [-k DURATION] %N|PID DURATION - срок фоновой задачи
+// Таймер ожидается в цикле событий shell вместе с SIGCHLD, по истечении
+// группа задачи получает сигнал, задача завершается с кодом 124
+// DURATION 0 снимает срок
+static int jobctl_ttl(char **args){
+    int sig;
+    struct timespec kill_after, duration;
+    size_t i = 1;
+    if(deadline_options("jobctl: ttl", args, &i, &sig, &kill_after) != 0){
+        return 2;
+    }
+    if(!args[i] || !args[i + 1] || args[i + 2]){
+        fprintf(stderr, "jobctl: usage: jobctl ttl [-s sig] [-k duration] %%job_id duration\n");
+        return 2;
+    }
+    if(parse_duration(args[i + 1], &duration) < 0){
+        fprintf(stderr, "jobctl: ttl: %s: invalid duration\n", args[i + 1]);
+        return 2;
+    }
+
+    WaitTarget target;
+    int status;
+    if(wait_resolve(args[i], &target, &status) != 0 || target.job->state == JOB_COMPLETED){
+        fprintf(stderr, "jobctl: %s: no such job\n", args[i]);
+        return 1;
+    }
+
+    Job *job = target.job;
+    deadline_free(job->ttl);
+    job->ttl = NULL;
+    if(duration.tv_sec == 0 && duration.tv_nsec == 0){
+        return 0;
+    }
+    job->ttl = deadline_create(&duration, sig, &kill_after);
+    return job->ttl ? 0 : 1;
+}
+
+// Выполнение команды со сроком
+// timeout [-s SIG] [-k DURATION] DURATION command [args...]
+// По истечении срока группа процессов команды получает SIG (по умолчанию TERM),
+// через -k DURATION после него - SIGKILL; код возврата 124
+// Срок отслеживает сам shell (timerfd в цикле ожидания), без процесса timeout
+static int builtin_timeout(char **args){
+    int sig;
+    struct timespec kill_after, duration;
+    size_t i = 1;
+    if(deadline_options("timeout", args, &i, &sig, &kill_after) != 0){
+        return 2;
+    }
+    if(!args[i] || !args[i + 1]){
+        fprintf(stderr, "timeout: usage: timeout [-s sig] [-k duration] duration command...\n");
+        return 2;
+    }
+    if(parse_duration(args[i], &duration) < 0){
+        fprintf(stderr, "timeout: %s: invalid duration\n", args[i]);
+        return 2;
+    }
+
+    // Нулевой срок - без ограничения, как у timeout(1)
+    if(duration.tv_sec == 0 && duration.tv_nsec == 0){
+        return execute_args(args + i + 1);
+    }
+
+    Deadline *deadline = deadline_create(&duration, sig, &kill_after);
+    if(!deadline){
+        return 1;
+    }
+    executor_push_deadline(deadline);
+    int status = execute_args(args + i + 1);
+    executor_pop_deadline();
+
+    if(deadline->expired){
+        status = DEADLINE_EXIT_CODE;
+    }
+    deadline_free(deadline);
+    return status;
+}
+
+// Параметры планирования задач
+// jobctl affinity %N|PID CPUS   - привязка всех процессов задачи к CPU
+// jobctl nice %N|PID N          - nice всей группы процессов задачи
+// jobctl ionice %N|PID CLASS    - класс ввода-вывода группы (idle, be[:N], rt[:N])
+// jobctl run [-a CPUS] [-n N] [-i CLASS] cmd... - запуск команды с параметрами
+// jobctl ttl [-s SIG] [-k DURATION] %N|PID DURATION - срок задачи
+static int builtin_jobctl(char **args){
+    if(!args[1]){
+        fprintf(stderr, "jobctl: usage: jobctl affinity|nice|ionice %%job_id value\n");
+        fprintf(stderr, "       jobctl run [-a cpus] [-n nice] [-i class] command...\n");
+        fprintf(stderr, "       jobctl ttl [-s sig] [-k duration] %%job_id duration\n");
+        return 2;
+    }
+    if(strcmp(args[1], "run") == 0){
+        return jobctl_run(args + 1);
+    }
+    if(strcmp(args[1], "ttl") == 0){
+        return jobctl_ttl(args + 1);
+    }
+    if(!args[2] || !args[3] || args[4]){
+        fprintf(stderr, "jobctl: usage: jobctl %s %%job_id value\n", args[1]);
+        return 2;
+    }
+
+    JobSched sched;
+    job_sched_init(&sched);
+    if(jobctl_parse(args[1], args[3], &sched) < 0){
+        return 2;
+    }
+
+    WaitTarget target;
+    int status;
+    if(wait_resolve(args[2], &target, &status) != 0 || target.job->state == JOB_COMPLETED){
+        fprintf(stderr, "jobctl: %s: no such job\n", args[2]);
+        return 1;
+    }
+    // Параметры меняются для всей группы: группу shell трогать нельзя
+    if(target.job->pgid <= 0 || target.job->pgid == getpgrp()){
+        fprintf(stderr, "jobctl: %s: job has no process group of its own\n", args[2]);
+        return 1;
+    }
+
+    return job_sched_apply_group(target.job->pgid, &sched) < 0 ? 1 : 0;
+}
+
 // Установка переменных окружения
 // Без аргументов выводит все переменные
 static int builtin_set(char **args){
@@ -400,6 +1097,15 @@ static int builtin_set(char **args){
         return 0;
     }
 
+    // set -o NAME / set +o NAME - включение/выключение опций shell
+    if(strcmp(args[1], "-o") == 0 || strcmp(args[1], "+o") == 0){
+        if(args[2] == NULL){
+            shell_options_print();
+            return 0;
+        }
+        return shell_option_set(args[2], args[1][0] == '-');
+    }
+
     // Парсинг формата NAME=VALUE
     char *arg = args[1];
     char *eq = strchr(arg, '=');
@@ -419,6 +1125,10 @@ static int builtin_set(char **args){
         *eq = '=';
         return 1;
     }
+    // Пути в кеше команд больше не соответствуют новому PATH
+    if(strcmp(name, "PATH") == 0){
+        command_hash_clear();
+    }
     *eq = '=';
 
     return 0;
@@ -436,6 +1146,9 @@ static int builtin_unset(char **args){
         perror("unset");
         return 1;
     }
+    if(strcmp(args[1], "PATH") == 0){
+        command_hash_clear();
+    }
 
     return 0;
 }
@@ -464,4 +1177,63 @@ static int builtin_history(char **args){
     }
     
     return 0;
-}
\ No newline at end of file
+}
+
+// Управление кешем расположения команд
+// hash - вывод таблицы
+// hash -r - очистка таблицы
+// hash -p path name - запомнить path для name без поиска в PATH
+// hash name... - найти команды в PATH и запомнить
+static int builtin_hash(char **args){
+    if(args[1] == NULL){
+        command_hash_print();
+        return 0;
+    }
+
+    int status = 0;
+    for(size_t i = 1; args[i] != NULL; i++){
+        if(strcmp(args[i], "-r") == 0){
+            command_hash_clear();
+            continue;
+        }
+
+        if(strcmp(args[i], "-p") == 0){
+            if(args[i + 1] == NULL || args[i + 2] == NULL){
+                fprintf(stderr, "hash: usage: hash -p path name\n");
+                return 1;
+            }
+            if(command_hash_add(args[i + 2], args[i + 1]) < 0){
+                status = 1;
+            }
+            i += 2;
+            continue;
+        }
+
+        if(is_builtin(args[i])){
+            continue;  // Встроенные команды не кешируются
+        }
+
+        if(!command_hash_lookup(args[i])){
+            fprintf(stderr, "hash: %s: not found\n", args[i]);
+            status = 1;
+        }
+    }
+
+    return status;
+}
+
+// Статистика кеша разбора строк
+// parsecache - число записей, попадания и промахи
+// parsecache -r - очистка кеша и счётчиков
+static int builtin_parsecache(char **args){
+    if(args[1] == NULL){
+        parse_cache_print();
+        return 0;
+    }
+    if(strcmp(args[1], "-r") == 0 && args[2] == NULL){
+        parse_cache_clear();
+        return 0;
+    }
+    fprintf(stderr, "parsecache: usage: parsecache [-r]\n");
+    return 2;
+}
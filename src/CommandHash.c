@@ -0,0 +1,239 @@
+// CommandHash.c
+// Кеш расположения команд: имя -> абсолютный путь
+// Заполняется при первом поиске команды в $PATH, дальше команды
+// запускаются по абсолютному пути без перебора каталогов
+// Сбрасывается при изменении PATH (set/unset) и командой hash -r
+
+#include "CommandHash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static CommandHash g_command_hash = {NULL, 0, 0};
+
+// FNV-1a хеш строки
+static size_t hash_string(const char *str){
+    size_t h = 14695981039346656037ULL;
+    for(const unsigned char *p = (const unsigned char *)str; *p; p++){
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static CommandHashEntry **command_hash_slot(const char *name){
+    size_t idx = hash_string(name) & (g_command_hash.bucket_count - 1);
+    CommandHashEntry **slot = &g_command_hash.buckets[idx];
+    while(*slot && strcmp((*slot)->name, name) != 0){
+        slot = &(*slot)->next;
+    }
+    return slot;
+}
+
+// Увеличение числа бакетов в 2 раза при заполнении больше 0.75
+static int command_hash_grow(void){
+    size_t new_count = g_command_hash.bucket_count ? g_command_hash.bucket_count * 2 : COMMAND_HASH_INITIAL_BUCKETS;
+    CommandHashEntry **new_buckets = calloc(new_count, sizeof(CommandHashEntry *));
+    if(!new_buckets){
+        perror("command_hash_grow: calloc failed");
+        return -1;
+    }
+
+    for(size_t i = 0; i < g_command_hash.bucket_count; i++){
+        CommandHashEntry *e = g_command_hash.buckets[i];
+        while(e){
+            CommandHashEntry *next = e->next;
+            size_t idx = hash_string(e->name) & (new_count - 1);
+            e->next = new_buckets[idx];
+            new_buckets[idx] = e;
+            e = next;
+        }
+    }
+
+    free(g_command_hash.buckets);
+    g_command_hash.buckets = new_buckets;
+    g_command_hash.bucket_count = new_count;
+    return 0;
+}
+
+// Проверка что path - исполняемый обычный файл
+static int is_executable(const char *path){
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0;
+}
+
+// Поиск команды в каталогах $PATH
+// Возвращает выделенную строку с полным путём или NULL
+static char *search_path(const char *name){
+    const char *path_env = getenv("PATH");
+    if(!path_env){
+        path_env = "/usr/local/bin:/usr/bin:/bin";
+    }
+
+    size_t name_len = strlen(name);
+    const char *dir = path_env;
+    while(1){
+        const char *end = strchr(dir, ':');
+        size_t dir_len = end ? (size_t)(end - dir) : strlen(dir);
+
+        // Пустой элемент PATH означает текущий каталог
+        const char *d = dir_len ? dir : ".";
+        size_t d_len = dir_len ? dir_len : 1;
+
+        char *full = malloc(d_len + name_len + 2);
+        if(!full){
+            perror("search_path: malloc failed");
+            return NULL;
+        }
+        memcpy(full, d, d_len);
+        full[d_len] = '/';
+        memcpy(full + d_len + 1, name, name_len + 1);
+
+        if(is_executable(full)){
+            return full;
+        }
+        free(full);
+
+        if(!end){
+            break;
+        }
+        dir = end + 1;
+    }
+    return NULL;
+}
+
+// Добавление (или замена) записи name -> path
+int command_hash_add(const char *name, const char *path){
+    if(g_command_hash.count + 1 > g_command_hash.bucket_count * 3 / 4){
+        if(command_hash_grow() < 0){
+            return -1;
+        }
+    }
+
+    CommandHashEntry **slot = command_hash_slot(name);
+    if(*slot){
+        char *new_path = strdup(path);
+        if(!new_path){
+            return -1;
+        }
+        free((*slot)->path);
+        (*slot)->path = new_path;
+        (*slot)->hits = 0;
+        return 0;
+    }
+
+    CommandHashEntry *e = malloc(sizeof(CommandHashEntry));
+    if(!e){
+        perror("command_hash_add: malloc failed");
+        return -1;
+    }
+    e->name = strdup(name);
+    e->path = strdup(path);
+    if(!e->name || !e->path){
+        free(e->name);
+        free(e->path);
+        free(e);
+        return -1;
+    }
+    e->hits = 0;
+    e->next = NULL;
+    *slot = e;
+    g_command_hash.count++;
+    return 0;
+}
+
+// Получение полного пути команды
+// Имена со '/' возвращаются как есть, остальные ищутся в кеше, затем в $PATH
+// Возвращает NULL если команда не найдена
+const char *command_hash_lookup(const char *name){
+    if(!name || !name[0]){
+        return NULL;
+    }
+    if(strchr(name, '/')){
+        return name;
+    }
+
+    if(g_command_hash.bucket_count){
+        CommandHashEntry *e = *command_hash_slot(name);
+        if(e){
+            e->hits++;
+            return e->path;
+        }
+    }
+
+    char *full = search_path(name);
+    if(!full){
+        return NULL;
+    }
+
+    int rc = command_hash_add(name, full);
+    free(full);
+    if(rc < 0){
+        return NULL;
+    }
+
+    CommandHashEntry *e = *command_hash_slot(name);
+    e->hits++;
+    return e->path;
+}
+
+// Удаление одной записи (например, файл по сохранённому пути исчез)
+void command_hash_remove(const char *name){
+    if(!g_command_hash.bucket_count){
+        return;
+    }
+
+    CommandHashEntry **slot = command_hash_slot(name);
+    CommandHashEntry *e = *slot;
+    if(!e){
+        return;
+    }
+    *slot = e->next;
+    free(e->name);
+    free(e->path);
+    free(e);
+    g_command_hash.count--;
+}
+
+// Очистка всех записей (hash -r, изменение PATH)
+void command_hash_clear(void){
+    for(size_t i = 0; i < g_command_hash.bucket_count; i++){
+        CommandHashEntry *e = g_command_hash.buckets[i];
+        while(e){
+            CommandHashEntry *next = e->next;
+            free(e->name);
+            free(e->path);
+            free(e);
+            e = next;
+        }
+        g_command_hash.buckets[i] = NULL;
+    }
+    g_command_hash.count = 0;
+}
+
+// Вывод таблицы в формате "hits  command"
+void command_hash_print(void){
+    if(g_command_hash.count == 0){
+        printf("hash: hash table empty\n");
+        return;
+    }
+
+    printf("hits\tcommand\n");
+    for(size_t i = 0; i < g_command_hash.bucket_count; i++){
+        for(CommandHashEntry *e = g_command_hash.buckets[i]; e; e = e->next){
+            printf("%4lu\t%s\n", e->hits, e->path);
+        }
+    }
+}
+
+// Полное освобождение памяти кеша
+// Вызывается при завершении shell
+void command_hash_free(void){
+    command_hash_clear();
+    free(g_command_hash.buckets);
+    g_command_hash.buckets = NULL;
+    g_command_hash.bucket_count = 0;
+}
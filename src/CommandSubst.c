@@ -0,0 +1,200 @@
+// CommandSubst.c
+// Подстановка команд $(...) и `...`
+// Внутренняя команда проходит тот же путь, что и строка ввода:
+// лексер -> раскрытие переменных -> парсер -> executor_capture()
+// $(< file) - чистое раскрытие: файл читается в буфер без запуска команды
+// Завершающие переводы строки отрезаются на месте, без копирования
+
+#include "CommandSubst.h"
+#include "Lexer.h"
+#include "Expander.h"
+#include "Parser.h"
+#include "Executor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define SUBST_READ_CHUNK 65536
+
+// Поиск конца подстановки, начинающейся в str[start] ('$' из "$(" или '`')
+// Учитывает вложенные скобки, кавычки и экранирование
+// Возвращает индекс закрывающей ')' или '`', COMMAND_SUBST_NOT_FOUND если не закрыта
+size_t command_subst_end(const char *str, size_t start){
+    size_t j;
+
+    if(str[start] == '`'){
+        for(j = start + 1; str[j]; j++){
+            if(str[j] == '\\' && str[j + 1]){
+                j++;
+            } else if(str[j] == '`'){
+                return j;
+            }
+        }
+        return COMMAND_SUBST_NOT_FOUND;
+    }
+
+    int depth = 1;
+    char quote = 0;
+    j = start + 2;  // После "$("
+    while(str[j]){
+        char c = str[j];
+
+        if(quote == '\''){
+            if(c == '\''){
+                quote = 0;
+            }
+            j++;
+            continue;
+        }
+        if(c == '\\' && str[j + 1]){
+            j += 2;
+            continue;
+        }
+        // Вложенная подстановка разбирается целиком (в том числе внутри "...")
+        if((c == '$' && str[j + 1] == '(') || c == '`'){
+            size_t end = command_subst_end(str, j);
+            if(end == COMMAND_SUBST_NOT_FOUND){
+                return COMMAND_SUBST_NOT_FOUND;
+            }
+            j = end + 1;
+            continue;
+        }
+        if(quote == '"'){
+            if(c == '"'){
+                quote = 0;
+            }
+        } else if(c == '\'' || c == '"'){
+            quote = c;
+        } else if(c == '('){
+            depth++;
+        } else if(c == ')' && --depth == 0){
+            return j;
+        }
+        j++;
+    }
+    return COMMAND_SUBST_NOT_FOUND;
+}
+
+// Чтение файла целиком для $(< file)
+static char *read_file(const char *path, size_t *len){
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        perror(path);
+        return NULL;
+    }
+
+    // Размер файла - начальная ёмкость буфера (для pipe/устройств st_size = 0)
+    struct stat st;
+    size_t cap = SUBST_READ_CHUNK;
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (size_t)st.st_size + 1 > cap){
+        cap = (size_t)st.st_size + 1;
+    }
+
+    char *buf = malloc(cap);
+    if(!buf){
+        perror("command_subst: malloc");
+        close(fd);
+        return NULL;
+    }
+
+    *len = 0;
+    while(1){
+        if(cap - *len < 2){
+            char *grown = realloc(buf, cap * 2);
+            if(!grown){
+                perror("command_subst: realloc");
+                break;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+        ssize_t n = read(fd, buf + *len, cap - *len - 1);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n <= 0){
+            if(n < 0){
+                perror(path);
+            }
+            break;
+        }
+        *len += (size_t)n;
+    }
+    close(fd);
+    buf[*len] = '\0';
+    return buf;
+}
+
+// Форма $(< file): только редирект ввода и имя файла
+static int is_file_read(const TokenArray *tokens){
+    size_t i = 0;
+    while(i < tokens->count && tokens->tokens[i].type == TOKEN_NEWLINE){
+        i++;
+    }
+    if(i + 1 >= tokens->count || tokens->tokens[i].type != TOKEN_REDIR_IN ||
+       tokens->tokens[i + 1].type != TOKEN_WORD){
+        return 0;
+    }
+    for(i += 2; i < tokens->count; i++){
+        if(tokens->tokens[i].type != TOKEN_NEWLINE && tokens->tokens[i].type != TOKEN_EOF){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Выполнение подстановки команды
+// Возвращает выделенную строку с выводом команды без завершающих '\n'
+// (пустую строку при ошибке разбора), NULL при нехватке памяти
+char *command_subst(const char *cmdline){
+    Lexer lexer;
+    TokenArray tokens;
+    Arena arena;
+    char *output = NULL;
+    size_t len = 0;
+
+    // Своя арена: арена внешней строки ещё занята её токенами
+    arena_init(&arena, ARENA_BLOCK_SIZE);
+    lexer_init(&lexer, cmdline, &arena);
+    if(!lexer_tokenize_all(&lexer, &tokens)){
+        arena_free(&arena);
+        return strdup("");
+    }
+    if(is_file_read(&tokens)){
+        size_t i = 0;
+        while(tokens.tokens[i].type != TOKEN_WORD){
+            i++;
+        }
+        // Имя файла раскрывается здесь: команда не идёт через Executor
+        char *path = arena_strndup(&arena, tokens.tokens[i].text, tokens.tokens[i].len);
+        char *expanded = path ? expander_expand_word(path) : NULL;
+        output = expanded ? read_file(expanded, &len) : NULL;
+        free(expanded);
+    } else {
+        Parser parser;
+        parser_init(&parser, &tokens);
+        ASTNode *ast = parser_parse(&parser);
+        if(ast){
+            output = executor_capture(ast, &len);
+        }
+    }
+
+    lexer_destroy(&lexer);
+    arena_free(&arena);
+
+    if(!output){
+        return strdup("");
+    }
+
+    // Отрезаем завершающие переводы строки прямо в буфере
+    while(len > 0 && output[len - 1] == '\n'){
+        len--;
+    }
+    output[len] = '\0';
+    return output;
+}
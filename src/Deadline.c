@@ -0,0 +1,137 @@
+// Deadline.c
+// Сроки выполнения команд на timerfd: timeout DURATION cmd и jobctl ttl %N DURATION
+// Дескриптор таймера ожидается в том же poll, что и signalfd SIGCHLD,
+// поэтому отдельный процесс timeout и периодический опрос не нужны
+// При срабатывании вызывающий получает сигнал для группы процессов команды;
+// если задан kill_after, таймер перевзводится и второе срабатывание даёт SIGKILL
+
+#include "Deadline.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
+
+static int deadline_arm(Deadline *deadline, const struct timespec *after){
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value = *after;
+    if(timerfd_settime(deadline->fd, 0, &spec, NULL) < 0){
+        perror("timerfd_settime");
+        return -1;
+    }
+    return 0;
+}
+
+// Создание и запуск таймера срока
+// Возвращает NULL при ошибке (сообщение выведено)
+Deadline *deadline_create(const struct timespec *duration, int signal,
+                          const struct timespec *kill_after){
+    Deadline *deadline = malloc(sizeof(Deadline));
+    if(!deadline){
+        perror("deadline_create: malloc failed");
+        return NULL;
+    }
+    deadline->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(deadline->fd < 0){
+        perror("timerfd_create");
+        free(deadline);
+        return NULL;
+    }
+    deadline->signal = signal;
+    deadline->kill_after = *kill_after;
+    deadline->expired = 0;
+    deadline->outer = NULL;
+
+    if(deadline_arm(deadline, duration) < 0){
+        deadline_free(deadline);
+        return NULL;
+    }
+    return deadline;
+}
+
+// Закрытие таймера: состояние expired остаётся для кода возврата
+void deadline_disarm(Deadline *deadline){
+    if(deadline && deadline->fd >= 0){
+        close(deadline->fd);
+        deadline->fd = -1;
+    }
+}
+
+void deadline_free(Deadline *deadline){
+    if(!deadline){
+        return;
+    }
+    deadline_disarm(deadline);
+    free(deadline);
+}
+
+// Проверка сработавших таймеров срока и всех внешних сроков
+// Возвращает сигнал, который нужно послать сейчас (0 - ни один срок не истёк)
+int deadline_expire(Deadline *deadline){
+    int sig = 0;
+
+    for(Deadline *d = deadline; d; d = d->outer){
+        uint64_t ticks;
+        if(d->fd < 0 || read(d->fd, &ticks, sizeof(ticks)) != sizeof(ticks)){
+            continue;
+        }
+
+        int kill_armed = d->kill_after.tv_sec > 0 || d->kill_after.tv_nsec > 0;
+        int next;
+        if(d->expired == 0){
+            next = d->signal;
+            d->expired = 1;
+            if(kill_armed && next != SIGKILL){
+                deadline_arm(d, &d->kill_after);
+            }
+        } else {
+            next = SIGKILL;
+            d->expired = 2;
+        }
+
+        // SIGKILL сильнее любого другого сигнала из цепочки
+        if(sig != SIGKILL){
+            sig = next;
+        }
+    }
+    return sig;
+}
+
+// Разбор длительности: число секунд (возможно дробное) с суффиксом
+// ms, s, m, h или d, как у timeout(1): 10, 1.5, 500ms, 2m
+// Возвращает 0 при успехе, -1 при ошибке формата
+int parse_duration(const char *str, struct timespec *out){
+    if(!str || !str[0]){
+        return -1;
+    }
+
+    char *end;
+    double value = strtod(str, &end);
+    if(end == str || value < 0){
+        return -1;
+    }
+
+    if(strcmp(end, "ms") == 0){
+        value /= 1000.0;
+    } else if(strcmp(end, "m") == 0){
+        value *= 60.0;
+    } else if(strcmp(end, "h") == 0){
+        value *= 3600.0;
+    } else if(strcmp(end, "d") == 0){
+        value *= 86400.0;
+    } else if(strcmp(end, "s") != 0 && end[0] != '\0'){
+        return -1;
+    }
+
+    // Ограничение, чтобы не переполнить time_t при очень больших значениях
+    if(value > 1e9){
+        value = 1e9;
+    }
+    out->tv_sec = (time_t)value;
+    out->tv_nsec = (long)((value - (double)out->tv_sec) * 1e9);
+    return 0;
+}
@@ -3,6 +3,10 @@
 #include "Executor.h"
 #include "Builtins.h"
 #include "JobControl.h"
+#include "Spawn.h"
+#include "Options.h"
+#include "Timing.h"
+#include "Expander.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,208 +15,594 @@
 #include <string.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <sys/mman.h>
+#include <limits.h>
+#include <errno.h>
+#include <sys/resource.h>
 
 // Флаг, указывающий что процесс выполняется в фоне
 // Используется чтобы избежать вызова tcsetpgrp в дочерних процессах фоновых задач
 static int g_in_background = 0;
 
+#define PROCSUBST_MAX 8          // Подстановок процессов в одной команде
+#define PROCSUBST_SHELL_FD 16    // Концы pipe подстановок в shell - не ниже этого номера
+
+// Запущенные подстановки процессов одной команды
+// Процессы подстановок не попадают в job list, их ждёт сама команда
+typedef struct {
+    char **argv;                    // args с /dev/fd/N вместо <(...), NULL - подстановок нет
+    char names[PROCSUBST_MAX][32];  // Строки /dev/fd/N, на которые указывает argv
+    int fds[PROCSUBST_MAX];         // Концы pipe со стороны команды (открыты в shell)
+    pid_t pids[PROCSUBST_MAX];
+    size_t count;
+} ProcSubstRun;
+
+// Отчёт выполняемой сейчас команды time (NULL - время не измеряется)
+// Каждый запущенный процесс и builtin регистрируются в нём как стадия
+static TimeReport *g_time_report = NULL;
+
+// Подстановки остановленных и фоновых команд: собираются без блокировки
+static pid_t *g_procsubst_deferred = NULL;
+static size_t g_procsubst_deferred_count = 0;
+static size_t g_procsubst_deferred_capacity = 0;
+
+// Коды возврата стадий последнего pipeline переднего плана ($PIPESTATUS)
+// Простая команда даёт массив из одного элемента
+static int *g_pipestatus = NULL;
+static size_t g_pipestatus_count = 0;
+static size_t g_pipestatus_capacity = 0;
+
+// Срок выполняемой сейчас команды timeout (NULL - без срока)
+// Вложенные timeout связаны через outer, ожидание следит за всеми
+static Deadline *g_deadline = NULL;
+
+static int execute_node(ASTNode *root);
+static ASTNode *expand_node(ASTNode *node, Arena *arena);
 static int execute_command(ASTNode *root);
 static int execute_pipeline(ASTNode *root);
 static int execute_redirect(ASTNode *root);
-static int execute_and_or(ASTNode *root);
+static int execute_list(ASTNode *root);
 static int execute_subshell(ASTNode *root);
 static int execute_background(ASTNode *root);
+static int execute_time(ASTNode *root);
+static char *capture_node(ASTNode *root, size_t *len);
+static pid_t spawn_node(ASTNode *node, SpawnOptions *opts, int *fail_status, ProcSubstRun *run);
+static void procsubst_wait(ProcSubstRun *run);
+static void procsubst_defer(ProcSubstRun *run);
+static void procsubst_reap_deferred(void);
+static int is_spawnable(ASTNode *node);
+static ASTNode *unwrap_redirects(ASTNode *node);
+static void pipestatus_set(const int *codes, size_t count);
+static pid_t wait_foreground(pid_t pid, int *status, struct rusage *usage);
 // Вспомогательная функция для преобразования AST в строку команды
 // Используется для отображения команды в job list
+// Результат в куче: AST лежит в арене строки и сбрасывается после выполнения,
+// а текст команды задачи должен жить, пока задача в списке
 static char* ast_to_string(ASTNode *node);
 
+// Оператор бинарного узла в тексте команды
+static const char *binary_op_to_str(ASTNodeType type) {
+    switch (type) {
+    case AST_PIPELINE: return " | ";
+    case AST_PIPELINE_ERR: return " |& ";
+    case AST_SEQUENCE: return "; ";
+    case AST_AND: return " && ";
+    case AST_OR: return " || ";
+    default: return " ";
+    }
+}
+
+static const char *redirect_op_to_str(RedirectType type) {
+    switch (type) {
+    case REDIR_IN: return "<";
+    case REDIR_OUT: return ">";
+    case REDIR_OUT_APPEND: return ">>";
+    case REDIR_ERR: return "&>";
+    case REDIR_ERR_APPEND: return "&>>";
+    case REDIR_HEREDOC: return "<<";
+    case REDIR_HERESTRING: return "<<<";
+    }
+    return ">";
+}
+
+// Обход с явным стеком и запись в растущий буфер (open_memstream):
+// state 0 - узел ещё не начат, 1 - левая часть (или содержимое) выведена
 static char* ast_to_string(ASTNode *node) {
     if (!node) return strdup("");
     
     char *result = NULL;
     size_t len = 0;
+    FILE *out = open_memstream(&result, &len);
+    if (!out) return strdup("???");
+    
+    ASTStack stack;
+    ast_stack_init(&stack);
+    int ok = ast_stack_push(&stack, node, 0) == 0;
     
-    switch (node->type) {
-    case AST_COMMAND: {
-        // Вычисляем длину итоговой строки (все аргументы + пробелы)
-        for (size_t i = 0; node->data.command.args[i]; i++) {
-            len += strlen(node->data.command.args[i]) + 1;        }
-        result = malloc(len + 1);
-        if (!result) return strdup("???");
-        result[0] = '\0';
+    while (ok && stack.count > 0) {
+        ASTStackItem *item = &stack.items[stack.count - 1];
+        node = item->node;
+        int state = item->state;
+        item->state = 1;
         
-        // Собираем команду из аргументов через пробел
-        for (size_t i = 0; node->data.command.args[i]; i++) {
-            if (i > 0) strcat(result, " ");
-            strcat(result, node->data.command.args[i]);
+        switch (node->type) {
+        case AST_COMMAND:
+            // Аргументы через пробел
+            for (size_t i = 0; node->data.command.args[i]; i++) {
+                fprintf(out, i > 0 ? " %s" : "%s", node->data.command.args[i]);
+            }
+            stack.count--;
+            break;
+            
+        case AST_SUBSHELL:
+            if (state == 0) {
+                fputc('(', out);
+                ok = ast_stack_push(&stack, ast_child(node, node->data.subshell), 0) == 0;
+            } else {
+                fputc(')', out);
+                stack.count--;
+            }
+            break;
+            
+        case AST_TIME:
+            fputs("time ", out);
+            stack.count--;
+            ok = ast_stack_push(&stack, ast_child(node, node->data.timed), 0) == 0;
+            break;
+            
+        case AST_REDIRECT:
+            if (state == 0) {
+                ok = ast_stack_push(&stack, ast_child(node, node->data.redirect.command), 0) == 0;
+            } else {
+                // Тело here-document может быть многострочным - показываем только оператор
+                const char *target = node->data.redirect.filename;
+                if (node->kind == REDIR_HEREDOC || node->kind == REDIR_HERESTRING) {
+                    target = "...";
+                }
+                fprintf(out, " %s %s", redirect_op_to_str(node->kind), target);
+                stack.count--;
+            }
+            break;
+            
+        case AST_BACKGROUND:
+            if (state == 0) {
+                ok = ast_stack_push(&stack, ast_child(node, node->data.binary.left), 0) == 0;
+            } else {
+                fputs(" &", out);
+                stack.count--;
+            }
+            break;
+            
+        default:
+            // Бинарный узел: левая часть, оператор, правая часть вместо узла
+            if (state == 0) {
+                ok = ast_stack_push(&stack, ast_child(node, node->data.binary.left), 0) == 0;
+            } else {
+                fputs(binary_op_to_str(node->type), out);
+                stack.count--;
+                ok = ast_stack_push(&stack, ast_child(node, node->data.binary.right), 0) == 0;
+            }
+            break;
         }
-        return result;
     }
-    case AST_PIPELINE:
-    case AST_PIPELINE_ERR: {
-        // Рекурсивно преобразуем левую и правую части pipeline
-        char *left = ast_to_string(node->data.binary.left);
-        char *right = ast_to_string(node->data.binary.right);
-        len = strlen(left) + strlen(right) + 4;        result = malloc(len + 1);
-        if (!result) { free(left); free(right); return strdup("???"); }
-        sprintf(result, "%s | %s", left, right);
-        free(left); free(right);
-        return result;
-    }
-    case AST_SUBSHELL: {
-        char *inner = ast_to_string(node->data.subshell);
-        len = strlen(inner) + 3;        result = malloc(len + 1);
-        if (!result) { free(inner); return strdup("???"); }
-        sprintf(result, "(%s)", inner);
-        free(inner);
-        return result;
-    }
-    case AST_REDIRECT: {
-        char *cmd = ast_to_string(node->data.redirect.command);
-        const char *redir = ">";
-        switch (node->data.redirect.type) {
-            case REDIR_IN: redir = "<"; break;
-            case REDIR_OUT: redir = ">"; break;
-            case REDIR_OUT_APPEND: redir = ">>"; break;
-            case REDIR_ERR: redir = "&>"; break;
-            case REDIR_ERR_APPEND: redir = "&>>"; break;
-        }
-        len = strlen(cmd) + strlen(redir) + strlen(node->data.redirect.filename) + 3;
-        result = malloc(len + 1);
-        if (!result) { free(cmd); return strdup("???"); }
-        sprintf(result, "%s %s %s", cmd, redir, node->data.redirect.filename);
-        free(cmd);
-        return result;
-    }
-    case AST_SEQUENCE: {
-        char *left = ast_to_string(node->data.binary.left);
-        char *right = ast_to_string(node->data.binary.right);
-        len = strlen(left) + strlen(right) + 3;        result = malloc(len + 1);
-        if (!result) { free(left); free(right); return strdup("???"); }
-        sprintf(result, "%s; %s", left, right);
-        free(left); free(right);
-        return result;
-    }
-    case AST_AND: {
-        char *left = ast_to_string(node->data.binary.left);
-        char *right = ast_to_string(node->data.binary.right);
-        len = strlen(left) + strlen(right) + 5;        result = malloc(len + 1);
-        if (!result) { free(left); free(right); return strdup("???"); }
-        sprintf(result, "%s && %s", left, right);
-        free(left); free(right);
-        return result;
-    }
-    case AST_OR: {
-        char *left = ast_to_string(node->data.binary.left);
-        char *right = ast_to_string(node->data.binary.right);
-        len = strlen(left) + strlen(right) + 5;        result = malloc(len + 1);
-        if (!result) { free(left); free(right); return strdup("???"); }
-        sprintf(result, "%s || %s", left, right);
-        free(left); free(right);
-        return result;
-    }
-    default:
+    
+    ast_stack_free(&stack);
+    fclose(out);
+    if (!ok) {
+        free(result);
         return strdup("???");
     }
+    return result;
+}
+
+// Регистрация запущенного процесса как стадии текущей команды time
+static void time_stage_started(pid_t pid, ASTNode *node) {
+    if (!g_time_report || pid <= 0) {
+        return;
+    }
+    char *cmd_str = ast_to_string(node);
+    time_report_add_stage(g_time_report, pid, cmd_str);
+    free(cmd_str);
+}
+
+// Начало стадии, выполняемой в процессе shell (builtin)
+// Возвращает индекс стадии или -1 если время не измеряется
+static long time_stage_self_begin(ASTNode *node) {
+    if (!g_time_report) {
+        return -1;
+    }
+    char *cmd_str = ast_to_string(node);
+    TimedStage *stage = time_report_add_stage(g_time_report, 0, cmd_str);
+    free(cmd_str);
+    if (!stage) {
+        return -1;
+    }
+    time_report_self_begin(stage);
+    return (long)(g_time_report->count - 1);
+}
+
+static void time_stage_self_end(long index) {
+    if (g_time_report && index >= 0) {
+        time_report_self_end(&g_time_report->stages[index]);
+    }
+}
+
+// Остановленная команда стала задачей: отчёт time переходит в Job и будет
+// выведен, когда задача завершится (после fg/bg)
+static void time_report_attach(Job *job) {
+    if (!g_time_report || !job) {
+        return;
+    }
+    time_report_phase(g_time_report, TIME_PHASE_STOPPED);
+    job->timing = g_time_report;
+    g_time_report = NULL;
+}
+
+// Можно ли запустить узел через spawn без выполнения кода shell в дочернем процессе
+// (внешняя команда, не builtin, возможно с редиректами)
+static int is_spawnable(ASTNode *node){
+    node = unwrap_redirects(node);
+    if(!node || node->type != AST_COMMAND){
+        return 0;
+    }
+    char **args = node->data.command.args;
+    return args && args[0] && !is_builtin(args[0]);
+}
+
+// Слово аргумента после раскрытия: копия в арене или само слово, если
+// раскрывать нечего. Возвращает NULL при нехватке памяти
+static char *expand_word(char *word, Arena *arena){
+    if(!expander_needs_expansion(word, strlen(word))){
+        return word;
+    }
+    char *expanded = expander_expand_word(word);
+    if(!expanded){
+        return NULL;
+    }
+    char *copy = arena_strdup(arena, expanded);
+    free(expanded);
+    return copy;
+}
+
+// Есть ли в команде, её редиректах или стадиях pipeline что раскрывать
+// Pipeline левоассоциативен - спуск по левой ветви циклом, правая часть -
+// одна стадия (команда с редиректами или subshell)
+static int node_needs_expansion(ASTNode *node){
+    while(node){
+        switch(node->type){
+        case AST_COMMAND:
+            return node->expand;
+        case AST_REDIRECT:
+            if(node->expand){
+                return 1;
+            }
+            node = ast_child(node, node->data.redirect.command);
+            break;
+        case AST_PIPELINE:
+        case AST_PIPELINE_ERR:
+            if(node_needs_expansion(ast_child(node, node->data.binary.right))){
+                return 1;
+            }
+            node = ast_child(node, node->data.binary.left);
+            break;
+        default:
+            return 0;
+        }
+    }
+    return 0;
+}
+
+// Раскрытие слов в копии дерева (тот же обход, что node_needs_expansion)
+// Возвращает 0 или -1 при нехватке памяти
+static int expand_in_place(ASTNode *node, Arena *arena){
+    while(node){
+        switch(node->type){
+        case AST_COMMAND: {
+            if(!node->expand){
+                return 0;
+            }
+            size_t argc = node->argc;
+            char **args = arena_alloc(arena, (argc + 1) * sizeof(char *));
+            if(!args){
+                return -1;
+            }
+            for(size_t i = 0; i < argc; i++){
+                args[i] = expand_word(node->data.command.args[i], arena);
+                if(!args[i]){
+                    return -1;
+                }
+            }
+            args[argc] = NULL;
+            node->data.command.args = args;
+            node->expand = 0;
+            return 0;
+        }
+
+        case AST_REDIRECT:
+            if(node->expand){
+                node->data.redirect.filename = expand_word(node->data.redirect.filename, arena);
+                if(!node->data.redirect.filename){
+                    return -1;
+                }
+                node->expand = 0;
+            }
+            node = ast_child(node, node->data.redirect.command);
+            break;
+
+        case AST_PIPELINE:
+        case AST_PIPELINE_ERR:
+            if(expand_in_place(ast_child(node, node->data.binary.right), arena) < 0){
+                return -1;
+            }
+            node = ast_child(node, node->data.binary.left);
+            break;
+
+        default:
+            return 0;
+        }
+    }
+    return 0;
+}
+
+// Раскрытие переменных и подстановок команд непосредственно перед выполнением
+// Дерево разбора не меняется (его можно выполнить повторно из кеша разбора):
+// поддерево копируется в arena одним блоком, и слова раскрываются в копии.
+// Раскрываются команда, редиректы и стадии pipeline; части subshell, ;, &&,
+// ||, & и time раскрываются, когда до них дойдёт выполнение (в том числе в
+// дочернем процессе), чтобы видеть $? и переменные на этот момент
+// Узлы без раскрытия возвращаются как есть, NULL - нехватка памяти
+static ASTNode *expand_node(ASTNode *node, Arena *arena){
+    if(!node_needs_expansion(node)){
+        return node;
+    }
+
+    ASTNode *copy = ast_copy(arena, node);
+    if(!copy || expand_in_place(copy, arena) < 0){
+        return NULL;
+    }
+    return copy;
 }
 
 // Главная функция выполнения AST
-// Диспетчеризует выполнение в зависимости от типа узла
+// Раскрывает слова ближайшей команды или pipeline во временную арену,
+// выполняет и обновляет $? - следующая команда строки видит этот код
 int executor_execute(ASTNode *root){
     if(!root){
         return 0;
     }
 
+    procsubst_reap_deferred();
+
+    Arena arena;
+    arena_init(&arena, 0);
+    ASTNode *node = expand_node(root, &arena);
+    int code = 1;
+    if(node){
+        code = execute_node(node);
+    } else {
+        fprintf(stderr, "executor_execute: expansion failed\n");
+    }
+    arena_free(&arena);
+
+    extern int g_last_exit_code;
+    g_last_exit_code = code;
+    return code;
+}
+
+// Диспетчеризация выполнения в зависимости от типа узла
+static int execute_node(ASTNode *root){
+    int code;
     switch (root->type) {
     case AST_COMMAND:
-        return execute_command(root);
+        code = execute_command(root);
+        break;
 
     case AST_PIPELINE:
     case AST_PIPELINE_ERR:
-        return execute_pipeline(root);  
+        // $PIPESTATUS заполняется самим pipeline по всем стадиям
+        return execute_pipeline(root);
 
     case AST_REDIRECT:
-        return execute_redirect(root);
+        code = execute_redirect(root);
+        break;
 
+    case AST_SEQUENCE:
     case AST_AND:
     case AST_OR:
-        return execute_and_or(root);
+        return execute_list(root);
 
     case AST_SUBSHELL:
-        return execute_subshell(root);
-
-    case AST_SEQUENCE:
-        executor_execute(root->data.binary.left);
-        return executor_execute(root->data.binary.right);
+        code = execute_subshell(root);
+        break;
 
     case AST_BACKGROUND:
         return execute_background(root);
 
+    case AST_TIME:
+        return execute_time(root);
+
     default:
-        fprintf(stderr, "executor_execute: unknown node type\n");
+        fprintf(stderr, "execute_node: unknown node type\n");
         return 1;
     }
+
+    pipestatus_set(&code, 1);
+    return code;
+}
+
+// Код возврата по статусу wait: exit code, 128+N для сигнала или остановки
+int executor_wait_code(int status){
+    if(WIFEXITED(status)){
+        return WEXITSTATUS(status);
+    }
+    if(WIFSIGNALED(status)){
+        return 128 + WTERMSIG(status);
+    }
+    if(WIFSTOPPED(status)){
+        return 128 + WSTOPSIG(status);
+    }
+    return 1;
+}
+
+// Сохранение кодов стадий для $PIPESTATUS
+static void pipestatus_set(const int *codes, size_t count){
+    if(count > g_pipestatus_capacity){
+        int *buf = realloc(g_pipestatus, count * sizeof(int));
+        if(!buf){
+            perror("pipestatus: realloc failed");
+            return;
+        }
+        g_pipestatus = buf;
+        g_pipestatus_capacity = count;
+    }
+    memcpy(g_pipestatus, codes, count * sizeof(int));
+    g_pipestatus_count = count;
+}
+
+// Срок для последующих запусков (timeout): команды, выполняемые до
+// executor_pop_deadline, получают сигнал deadline по его истечении
+void executor_push_deadline(Deadline *deadline){
+    deadline->outer = g_deadline;
+    g_deadline = deadline;
+}
+
+void executor_pop_deadline(void){
+    if(g_deadline){
+        g_deadline = g_deadline->outer;
+    }
+}
+
+// Ожидание процесса переднего плана с учётом срока timeout
+// По истечении срока сигнал получает группа процесса (в фоне группа общая
+// с shell - тогда только сам процесс), ожидание продолжается
+static pid_t wait_foreground(pid_t pid, int *status, struct rusage *usage){
+    pid_t result;
+    while((result = job_wait_foreground(pid, status, usage, g_deadline)) == 0){
+        int sig = deadline_expire(g_deadline);
+        if(sig){
+            kill(g_in_background ? pid : -pid, sig);
+        }
+    }
+    return result;
+}
+
+// Коды возврата стадий последнего pipeline (слева направо)
+const int *executor_pipestatus(size_t *count){
+    *count = g_pipestatus_count;
+    return g_pipestatus;
+}
+
+// Запуск узла в фоне в новой группе процессов без ожидания
+// Простая внешняя команда запускается через spawn, остальное - через fork
+// stdin_fd >= 0 - подставляется как stdin, output_fd >= 0 - как stdout и stderr
+// (редиректы узла применяются после)
+// Используется для & и для элементов очереди jobq
+// Возвращает PID или -1 (*fail_status - код ошибки запуска)
+pid_t executor_launch(ASTNode *node, int stdin_fd, int output_fd, int *fail_status){
+    SpawnOptions opts;
+    // Новая группа процессов, SIGTTIN/SIGTTOU остаются игнорируемыми
+    spawn_options_init(&opts, 0, 1);
+    if(stdin_fd >= 0 && stdin_fd != STDIN_FILENO){
+        spawn_options_dup2(&opts, stdin_fd, STDIN_FILENO);
+    }
+    if(output_fd >= 0){
+        spawn_options_dup2(&opts, output_fd, STDOUT_FILENO);
+        spawn_options_dup2(&opts, output_fd, STDERR_FILENO);
+    }
+
+    // Внешняя команда запускается без fork shell - раскрываем её здесь
+    Arena arena;
+    arena_init(&arena, 0);
+    ASTNode *expanded = expand_node(node, &arena);
+    if(!expanded){
+        arena_free(&arena);
+        *fail_status = 1;
+        return -1;
+    }
+
+    pid_t pid;
+    if(is_spawnable(expanded)){
+        ProcSubstRun run;
+        pid = spawn_node(expanded, &opts, fail_status, &run);
+        arena_free(&arena);
+        if(pid < 0){
+            return -1;
+        }
+        // Не ждём: подстановки завершатся вместе с фоновой командой
+        procsubst_defer(&run);
+    } else {
+        fflush(stdout);
+        fflush(stderr);
+        pid = fork();
+
+        if(pid < 0){
+            perror("fork");
+            arena_free(&arena);
+            *fail_status = 1;
+            return -1;
+        }
+
+        if(pid == 0){
+            spawn_child_setup(&opts);
+            // Устанавливаем флаг, чтобы вложенные команды не вызывали tcsetpgrp
+            g_in_background = 1;
+
+            int code = executor_execute(expanded);
+            exit(code);
+        }
+        arena_free(&arena);
+
+        // Родительский процесс: гарантируем что дочерний в своей группе
+        setpgid(pid, pid);
+    }
+    return pid;
 }
 
 // Выполнение команды в фоне (cmd &)
-// Создаёт дочерний процесс, не ждёт завершения, добавляет в job list
+// Не ждёт завершения, добавляет задачу в job list
+// При set -o bgcapture stdout и stderr задачи идут в pipe, который shell
+// вычитывает в кольцевой буфер задачи (jobs -o %N, fg)
 static int execute_background(ASTNode *root){
-    pid_t pid = fork();
+    ASTNode *inner = ast_child(root, root->data.binary.left);
+    int fail_status = 0;
     
-    if(pid < 0){
-        perror("fork");
-        return 1;
+    int capture[2] = {-1, -1};
+    if(shell_option_get(OPT_BGCAPTURE) && pipe2(capture, O_CLOEXEC) < 0){
+        perror("bgcapture: pipe");
+        capture[0] = capture[1] = -1;
     }
     
-    if(pid == 0){
-        // Дочерний процесс: создаём новую группу процессов
-        setpgid(0, 0);
-        // Устанавливаем флаг, чтобы вложенные команды не вызывали tcsetpgrp
-        g_in_background = 1;
-        
-        // Восстанавливаем обработчики сигналов
-        signal(SIGINT, SIG_DFL);
-        signal(SIGQUIT, SIG_DFL);
-        signal(SIGTSTP, SIG_DFL);
-        // Игнорируем попытки чтения/записи в терминал
-        signal(SIGTTIN, SIG_IGN);
-        signal(SIGTTOU, SIG_IGN);
-        signal(SIGCHLD, SIG_DFL);
-        
-        // Оптимизация: для простой команды сразу делаем exec
-        if(root->data.subshell && root->data.subshell->type == AST_COMMAND){
-            char **args = root->data.subshell->data.command.args;
-            if(args && args[0]){
-                if(is_builtin(args[0])){
-                    exit(execute_builtin(args));
-                }
-                execvp(args[0], args);
-                perror(args[0]);
-                exit(127);
-            }
+    pid_t pid = executor_launch(inner, -1, capture[1], &fail_status);
+    if(capture[1] >= 0){
+        close(capture[1]);
+    }
+    if(pid < 0){
+        if(capture[0] >= 0){
+            close(capture[0]);
         }
-        
-        int code = executor_execute(root->data.subshell);
-        exit(code);
+        return fail_status;
     }
     
-    // Родительский процесс: гарантируем что дочерний в своей группе
-    setpgid(pid, pid);
-    
     // Сохраняем PID для $! (последний фоновый процесс)
     extern pid_t g_last_bg_pid;
     g_last_bg_pid = pid;
     
     // Создаём строковое представление команды для job list
-    char *cmd_str = ast_to_string(root->data.subshell);
+    char *cmd_str = ast_to_string(inner);
     
     // Добавляем задачу в список фоновых задач
     Job *job = job_create(pid, cmd_str, JOB_BACKGROUND);
     if(job){
         job_add_process(job, pid, cmd_str);
+        if(capture[0] >= 0){
+            job_capture_output(job, capture[0], (size_t)shell_option_get(OPT_BGCAPSIZE));
+        }
         job_list_add(job_list_get(), job);
         printf("[%d] %d\n", job->job_id, pid);
     } else {
+        if(capture[0] >= 0){
+            close(capture[0]);
+        }
         printf("[bg] %d\n", pid);
     }
     
@@ -221,127 +611,514 @@ static int execute_background(ASTNode *root){
     return 0;
 }
 
-// Выполнение простой команды
-// Встроенные команды выполняются в текущем процессе, внешние через fork/exec
-static int execute_command(ASTNode *root){
-    char **args = root->data.command.args;
+// Скомпилированные редиректы команды
+// Все файлы открываются в shell с O_CLOEXEC (ошибки открытия сообщаются до запуска),
+// для каждого стандартного дескриптора запоминается только последний редирект
+typedef struct {
+    int *fds;           // Все открытые файлы (закрываются после запуска команды)
+    size_t fd_count;
+    int target_fd[3];   // Какой файл станет stdin/stdout/stderr, -1 - не менять
+} RedirectPlan;
 
-    if(!args || !args[0]){
-        fprintf(stderr, "execute_command: no command\n");
-        return 1;
+static void redirect_plan_close(RedirectPlan *plan) {
+    for (size_t i = 0; i < plan->fd_count; i++) {
+        close(plan->fds[i]);
+    }
+    free(plan->fds);
+    plan->fds = NULL;
+    plan->fd_count = 0;
+}
+
+// Дескриптор для чтения тела here-document/here-string без файла на диске
+// Маленькое тело помещается в pipe целиком (запись до PIPE_BUF не блокируется
+// на пустом pipe), большое пишется в memfd. Вспомогательный процесс не нужен
+// Возвращает дескриптор с O_CLOEXEC или -1
+static int heredoc_open(const char *body) {
+    size_t len = strlen(body);
+    
+    if (len <= PIPE_BUF) {
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) < 0) {
+            perror("here-document: pipe2");
+            return -1;
+        }
+        if (len > 0 && write(fds[1], body, len) != (ssize_t)len) {
+            perror("here-document: write");
+            close(fds[0]);
+            close(fds[1]);
+            return -1;
+        }
+        close(fds[1]);
+        return fds[0];
+    }
+    
+    int fd = memfd_create("here-document", MFD_CLOEXEC);
+    if (fd < 0) {
+        perror("here-document: memfd_create");
+        return -1;
+    }
+    size_t written = 0;
+    while (written < len) {
+        ssize_t n = write(fd, body + written, len - written);
+        if (n < 0) {
+            perror("here-document: write");
+            close(fd);
+            return -1;
+        }
+        written += (size_t)n;
+    }
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+// Компиляция цепочки редиректов в RedirectPlan
+// Узлы цепочки идут от последнего редиректа в команде к первому, файлы
+// открываются в порядке записи в команде (как в bash), последний побеждает
+// Возвращает 0 и команду без редиректов в *command, -1 при ошибке открытия
+static int redirect_compile(ASTNode *node, RedirectPlan *plan, ASTNode **command) {
+    size_t count = 0;
+    ASTNode *current = node;
+    while (current && current->type == AST_REDIRECT) {
+        count++;
+        current = ast_child(current, current->data.redirect.command);
+    }
+    *command = current;
+    
+    plan->fds = malloc((count ? count : 1) * sizeof(int));
+    plan->fd_count = 0;
+    plan->target_fd[0] = plan->target_fd[1] = plan->target_fd[2] = -1;
+    if (!plan->fds) {
+        perror("redirect_compile: malloc");
+        return -1;
+    }
+    
+    // Собираем узлы в порядке записи в команде
+    ASTNode **order = malloc((count ? count : 1) * sizeof(ASTNode *));
+    if (!order) {
+        perror("redirect_compile: malloc");
+        free(plan->fds);
+        plan->fds = NULL;
+        return -1;
+    }
+    current = node;
+    for (size_t i = count; i-- > 0;) {
+        order[i] = current;
+        current = ast_child(current, current->data.redirect.command);
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        const char *filename = order[i]->data.redirect.filename;
+        RedirectType type = order[i]->kind;
+        int flags = O_CLOEXEC;
+        
+        // Открываем файл согласно типу редиректа
+        switch (type) {
+            case REDIR_IN:
+                flags |= O_RDONLY;
+                break;
+            case REDIR_OUT:
+            case REDIR_ERR:
+                flags |= O_WRONLY | O_CREAT | O_TRUNC;
+                break;
+            case REDIR_OUT_APPEND:
+            case REDIR_ERR_APPEND:
+                flags |= O_WRONLY | O_CREAT | O_APPEND;
+                break;
+            case REDIR_HEREDOC:
+            case REDIR_HERESTRING:
+                break;
+        }
+        
+        // Для here-document filename содержит тело, а не имя файла
+        int is_heredoc = (type == REDIR_HEREDOC || type == REDIR_HERESTRING);
+        int fd = is_heredoc ? heredoc_open(filename) : open(filename, flags, 0644);
+        if (fd < 0) {
+            if (!is_heredoc) {
+                perror(filename);
+            }
+            free(order);
+            redirect_plan_close(plan);
+            return -1;
+        }
+        plan->fds[plan->fd_count++] = fd;
+        
+        if (type == REDIR_IN || is_heredoc) {
+            plan->target_fd[STDIN_FILENO] = fd;
+        } else {
+            plan->target_fd[STDOUT_FILENO] = fd;
+            // &> и &>> - stdout и stderr в один файл
+            if (type == REDIR_ERR || type == REDIR_ERR_APPEND) {
+                plan->target_fd[STDERR_FILENO] = fd;
+            }
+        }
+    }
+    
+    free(order);
+    return 0;
+}
+
+// Перенос редиректов в действия над дескрипторами для spawn/fork
+// Добавляются после dup2 от pipeline, поэтому редирект команды имеет приоритет
+static void redirect_plan_to_spawn(const RedirectPlan *plan, SpawnOptions *opts) {
+    for (int target = 0; target < 3; target++) {
+        if (plan->target_fd[target] >= 0) {
+            spawn_options_dup2(opts, plan->target_fd[target], target);
+        }
+    }
+}
+
+// Закрытие концов pipe подстановок в shell (процессы продолжают работать)
+static void procsubst_close(ProcSubstRun *run) {
+    for (size_t k = 0; k < run->count; k++) {
+        if (run->fds[k] >= 0) {
+            close(run->fds[k]);
+            run->fds[k] = -1;
+        }
+    }
+    free(run->argv);
+    run->argv = NULL;
+}
+
+// Ожидание завершения процессов подстановок команды
+// Вызывается после завершения самой команды: её концы pipe уже закрыты,
+// поэтому подстановка получает EOF или SIGPIPE и завершается
+static void procsubst_wait(ProcSubstRun *run) {
+    procsubst_close(run);
+    for (size_t k = 0; k < run->count; k++) {
+        while (waitpid(run->pids[k], NULL, 0) < 0 && errno == EINTR) {}
+    }
+    run->count = 0;
+}
+
+// Передача PID подстановок в список отложенного сбора
+static void procsubst_defer(ProcSubstRun *run) {
+    procsubst_close(run);
+    for (size_t k = 0; k < run->count; k++) {
+        if (g_procsubst_deferred_count >= g_procsubst_deferred_capacity) {
+            size_t cap = g_procsubst_deferred_capacity ? g_procsubst_deferred_capacity * 2 : 8;
+            pid_t *grown = realloc(g_procsubst_deferred, cap * sizeof(pid_t));
+            if (!grown) {
+                perror("procsubst_defer: realloc");
+                break;
+            }
+            g_procsubst_deferred = grown;
+            g_procsubst_deferred_capacity = cap;
+        }
+        g_procsubst_deferred[g_procsubst_deferred_count++] = run->pids[k];
+    }
+    run->count = 0;
+}
+
+// Сбор завершившихся отложенных подстановок без блокировки
+static void procsubst_reap_deferred(void) {
+    size_t kept = 0;
+    for (size_t i = 0; i < g_procsubst_deferred_count; i++) {
+        if (waitpid(g_procsubst_deferred[i], NULL, WNOHANG) == 0) {
+            g_procsubst_deferred[kept++] = g_procsubst_deferred[i];
+        }
+    }
+    g_procsubst_deferred_count = kept;
+}
+
+// Запуск подстановок процессов команды <(cmd) и >(cmd)
+// Каждая подстановка - pipe и дочерний процесс (fork, как subshell), который
+// выполняет вложенный AST. Конец pipe для команды остаётся в shell на номере
+// не ниже PROCSUBST_SHELL_FD, аргумент заменяется на /dev/fd/N:
+// child_fd_base >= 0 - номер, под которым конец окажется у запускаемой команды
+// (см. procsubst_to_spawn), -1 - номер в самом shell (для builtins)
+// Возвращает 0 (run->argv == NULL если подстановок нет) или -1 при ошибке
+static int procsubst_start(ASTNode *command, ProcSubstRun *run, int child_fd_base) {
+    run->argv = NULL;
+    run->count = 0;
+    
+    size_t n = command->procsub_count;
+    if (n == 0) {
+        return 0;
+    }
+    if (n > PROCSUBST_MAX) {
+        fprintf(stderr, "%s: too many process substitutions (max %d)\n",
+                command->data.command.args[0], PROCSUBST_MAX);
+        return -1;
+    }
+    
+    size_t argc = command->argc;
+    run->argv = malloc((argc + 1) * sizeof(char *));
+    if (!run->argv) {
+        perror("procsubst_start: malloc");
+        return -1;
+    }
+    memcpy(run->argv, command->data.command.args, (argc + 1) * sizeof(char *));
+    
+    for (size_t k = 0; k < n; k++) {
+        ASTProcSubst *ps = &command->data.command.procsubs[k];
+        ASTNode *inner = ast_child(command, ps->node);
+        int pipefd[2];
+        if (pipe2(pipefd, O_CLOEXEC) < 0) {
+            perror("process substitution: pipe");
+            procsubst_wait(run);
+            return -1;
+        }
+        // <(cmd): подстановка пишет, команда читает; >(cmd) - наоборот
+        int sub_end = ps->output ? pipefd[0] : pipefd[1];
+        int cmd_end = ps->output ? pipefd[1] : pipefd[0];
+        
+        fflush(stdout);
+        fflush(stderr);
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("process substitution: fork");
+            close(pipefd[0]);
+            close(pipefd[1]);
+            procsubst_wait(run);
+            return -1;
+        }
+        if (pid == 0) {
+            // Группа shell, терминал не захватывается
+            SpawnOptions opts;
+            spawn_options_init(&opts, SPAWN_PGID_INHERIT, 1);
+            spawn_options_dup2(&opts, sub_end, ps->output ? STDIN_FILENO : STDOUT_FILENO);
+            spawn_options_close_from(&opts, STDERR_FILENO + 1);
+            spawn_child_setup(&opts);
+            g_in_background = 1;
+            exit(executor_execute(inner));
+        }
+        
+        close(sub_end);
+        int fd = fcntl(cmd_end, F_DUPFD_CLOEXEC, PROCSUBST_SHELL_FD);
+        close(cmd_end);
+        run->fds[run->count] = fd;
+        run->pids[run->count] = pid;
+        run->count++;
+        if (fd < 0) {
+            perror("process substitution: fcntl");
+            procsubst_wait(run);
+            return -1;
+        }
+        
+        snprintf(run->names[k], sizeof(run->names[k]), "/dev/fd/%d",
+                 child_fd_base >= 0 ? child_fd_base + (int)k : fd);
+        run->argv[ps->arg_index] = run->names[k];
+    }
+    return 0;
+}
+
+// Передача концов pipe подстановок в запускаемую команду
+// Добавляются после всех остальных dup2 (источники выше PROCSUBST_SHELL_FD,
+// поэтому не затираются), лишние дескрипторы закрываются одним close_range
+static void procsubst_to_spawn(const ProcSubstRun *run, SpawnOptions *opts) {
+    if (run->count == 0) {
+        return;
+    }
+    for (size_t k = 0; k < run->count; k++) {
+        spawn_options_dup2(opts, run->fds[k], STDERR_FILENO + 1 + (int)k);
+    }
+    spawn_options_close_from(opts, STDERR_FILENO + 1 + (int)run->count);
+}
+
+// Команда стадии без редиректов
+static ASTNode *unwrap_redirects(ASTNode *node) {
+    while (node && node->type == AST_REDIRECT) {
+        node = ast_child(node, node->data.redirect.command);
+    }
+    return node;
+}
+
+// Запуск узла (команда, возможно с редиректами) через spawn
+// Файлы редиректов открываются здесь и закрываются сразу после запуска
+// Возвращает PID или -1; *fail_status - код возврата если процесс не запущен
+// Подстановки процессов запускаются здесь же, в *run остаются их PID:
+// вызывающий ждёт их (procsubst_wait) или откладывает (procsubst_defer)
+static pid_t spawn_node(ASTNode *node, SpawnOptions *opts, int *fail_status, ProcSubstRun *run) {
+    RedirectPlan plan = {NULL, 0, {-1, -1, -1}};
+    ASTNode *command = node;
+    
+    run->count = 0;
+    run->argv = NULL;
+    if (node->type == AST_REDIRECT) {
+        if (redirect_compile(node, &plan, &command) < 0) {
+            *fail_status = 1;
+            return -1;
+        }
+        redirect_plan_to_spawn(&plan, opts);
+    }
+    
+    // Подстановки получают дескрипторы 3, 4, ... в дочернем процессе
+    if (procsubst_start(command, run, STDERR_FILENO + 1) < 0) {
+        redirect_plan_close(&plan);
+        *fail_status = 1;
+        return -1;
     }
-
-    // Встроенные команды выполняются без fork
-    if(is_builtin(args[0])){
-        return execute_builtin(args);
+    procsubst_to_spawn(run, opts);
+    
+    pid_t pid = spawn_command(run->argv ? run->argv : command->data.command.args, opts);
+    redirect_plan_close(&plan);
+    
+    if (pid < 0) {
+        procsubst_wait(run);
+        *fail_status = 127;  // Код 127 - команда не найдена (стандарт POSIX)
+        return -1;
     }
+    
+    // Концы pipe теперь есть у команды, в shell они больше не нужны
+    procsubst_close(run);
+    return pid;
+}
 
-    pid_t pid = fork();
+// Запуск внешней команды на переднем плане и ожидание её завершения
+// node - команда или команда с редиректами (is_spawnable)
+static int execute_external(ASTNode *node){
+    // Spawn без копирования адресного пространства shell
+    // Дочерний процесс получает свою группу (если не в фоне) и сигналы по умолчанию
+    SpawnOptions opts;
+    spawn_options_init(&opts, g_in_background ? SPAWN_PGID_INHERIT : 0, g_in_background);
 
+    int fail_status = 0;
+    ProcSubstRun run;
+    pid_t pid = spawn_node(node, &opts, &fail_status, &run);
     if(pid < 0){
-        perror("fork");
-        return 1;
+        return fail_status;
     }
 
-    if(pid == 0){
-        // Дочерний процесс: создаём новую группу если не в фоне
-        if(!g_in_background){
-            setpgid(0, 0);  // Делаем себя лидером новой группы
-        }
-        // Восстанавливаем обработчики сигналов по умолчанию
-        // чтобы команды могли корректно реагировать на Ctrl+C, Ctrl+Z
-        signal(SIGINT, SIG_DFL);
-        signal(SIGTSTP, SIG_DFL);
-        signal(SIGQUIT, SIG_DFL);
-        signal(SIGTTIN, SIG_DFL);
-        signal(SIGTTOU, SIG_DFL);
-        
-        // Заменяем процесс на внешнюю команду
-        execvp(args[0], args);
-
-        // Если execvp вернулся - ошибка (команда не найдена)
-        perror(args[0]);
-        exit(127);  // Код 127 - команда не найдена (стандарт POSIX)
-    }
+    time_stage_started(pid, node);
 
     // Родительский процесс (shell):
     if(!g_in_background){
-        setpgid(pid, pid);  // Гарантируем что дочерний процесс в своей группе
         // Передаём управление терминалом дочернему процессу
         // чтобы он мог получать сигналы от Ctrl+C/Ctrl+Z
         tcsetpgrp(STDIN_FILENO, pid);
-    } else {
-        // Для фоновой задачи помещаем в группу текущего процесса который уже в фоновой группе созданной execute_background
-        setpgid(pid, getpgrp());
     }
     
     int status;
+    struct rusage usage;
     // Ожидаем завершения или остановки процесса (WUNTRACED для Ctrl+Z)
-    waitpid(pid, &status, WUNTRACED);
+    // wait4 дополнительно возвращает rusage процесса для time
+    wait_foreground(pid, &status, &usage);
+    if(!WIFSTOPPED(status)){
+        time_report_reaped(g_time_report, pid, &usage);
+    }
     
     // Возвращаем управление терминалом shell'у
     if(!g_in_background){
         tcsetpgrp(STDIN_FILENO, getpgrp());
     }
 
-    // Процесс завершился нормально - возвращаем код выхода
-    if(WIFEXITED(status)){
-        return WEXITSTATUS(status);
+    // Подстановки процессов остановленной команды не ждём
+    if(WIFSTOPPED(status)){
+        procsubst_defer(&run);
+    } else {
+        procsubst_wait(&run);
     }
-    
-    // Если subshell остановлен (Ctrl+Z), создаём job
+
+    // Если процесс остановлен (Ctrl+Z), создаём job
     if(WIFSTOPPED(status)){
-        char *cmd_str = ast_to_string(root);
+        char *cmd_str = ast_to_string(node);
         Job *job = job_create(pid, cmd_str, JOB_STOPPED);
         if(job){
             job_add_process(job, pid, cmd_str);
+            time_report_attach(job);
             job_list_add(job_list_get(), job);
             printf("\n[%d] Stopped   %s\n", job->job_id, cmd_str);
         }
         free(cmd_str);
-        return 0;
     }
     
-    return 1;
+    // Сигнал или остановка - 128+N, как в bash (Ctrl+Z даёт 148)
+    return executor_wait_code(status);
+}
+
+// Выполнение builtin в процессе shell
+// Подстановки процессов видны builtin как /dev/fd/N дескрипторов shell
+static int execute_builtin_command(ASTNode *command){
+    ProcSubstRun run;
+    if(procsubst_start(command, &run, -1) < 0){
+        return 1;
+    }
+    int code = execute_builtin(run.argv ? run.argv : command->data.command.args);
+    procsubst_wait(&run);
+    return code;
+}
+
+// Выполнение простой команды
+// Встроенные команды выполняются в текущем процессе, внешние через spawn
+static int execute_command(ASTNode *root){
+    char **args = root->data.command.args;
+
+    if(!args || !args[0]){
+        fprintf(stderr, "execute_command: no command\n");
+        return 1;
+    }
+
+    // Встроенные команды выполняются без fork
+    if(is_builtin(args[0])){
+        long stage = time_stage_self_begin(root);
+        int code = execute_builtin_command(root);
+        time_stage_self_end(stage);
+        return code;
+    }
+
+    return execute_external(root);
 }
-// Также определяет где нужно перенаправлять stderr
-static int collect_pipeline_commands(ASTNode *root, ASTNode **commands, int *pipe_stderr, int max_commands) {
-    int count = 0;
-    ASTNode *current = root;
+
+// Стадия pipeline
+typedef struct {
+    ASTNode *node;      // Команда стадии
+    int pipe_stderr;    // После стадии стоит |& (stderr тоже в pipe)
+    pid_t pid;          // PID процесса; 0 - выполнена в shell, -1 - не запустилась
+    int status;         // Код возврата стадии (сигнал - 128+N)
+    ProcSubstRun procsubst; // Подстановки процессов стадии, запущенной через spawn
+    int waited;         // Процесс уже собран (завершён или остановлен)
+} PipelineStage;
+
+// Собрать команды pipeline в плоский массив стадий
+// Парсер строит pipeline левоассоциативно: ((a | b) | c) | d,
+// поэтому спускаемся по левой ветви, запоминая узлы, и обходим их снизу вверх
+// Возвращает выделенный массив (освобождает вызывающий) и количество стадий
+static PipelineStage *collect_pipeline_stages(ASTNode *root, size_t *count) {
+    size_t depth = 0;
+    for (ASTNode *n = root; n && (n->type == AST_PIPELINE || n->type == AST_PIPELINE_ERR); n = ast_child(n, n->data.binary.left)) {
+        depth++;
+    }
     
-    // Проходим по цепочке pipeline
-    while (current && (current->type == AST_PIPELINE || current->type == AST_PIPELINE_ERR)) {
-        if (count >= max_commands - 1) {
-            fprintf(stderr, "pipeline: too many commands\n");
-            return -1;
-        }
-        commands[count] = current->data.binary.left;  // Левая часть - команда
-        // Запоминаем нужно ли перенаправить stderr
-        pipe_stderr[count] = (current->type == AST_PIPELINE_ERR);
-        count++;
-        current = current->data.binary.right;  // Идём вправо по цепочке
+    ASTNode **spine = malloc((depth ? depth : 1) * sizeof(ASTNode *));
+    PipelineStage *stages = calloc(depth + 1, sizeof(PipelineStage));
+    if (!spine || !stages) {
+        perror("collect_pipeline_stages: malloc");
+        free(spine);
+        free(stages);
+        return NULL;
     }
     
-    // Последняя команда в цепочке (самая правая)
-    if (current) {
-        commands[count++] = current;
+    ASTNode *n = root;
+    for (size_t k = 0; k < depth; k++) {
+        spine[k] = n;
+        n = ast_child(n, n->data.binary.left);
     }
     
-    return count;
+    // Самая левая команда, затем правые части снизу вверх
+    size_t c = 0;
+    stages[c++].node = n;
+    for (size_t k = depth; k-- > 0;) {
+        // Запоминаем нужно ли перенаправить stderr предыдущей стадии
+        stages[c - 1].pipe_stderr = (spine[k]->type == AST_PIPELINE_ERR);
+        stages[c++].node = ast_child(spine[k], spine[k]->data.binary.right);
+    }
+    
+    free(spine);
+    *count = c;
+    return stages;
 }
 
-// Выполнение одной команды в pipeline (вызывается в дочернем процессе)
+// Выполнение одной команды в pipeline (вызывается в дочернем процессе после fork)
+// Сюда попадают только стадии, которым нужен код shell: builtins, subshell, редиректы
 static void execute_pipeline_command(ASTNode *node) {
     if (node->type == AST_COMMAND) {
         char **args = node->data.command.args;
         if (args && args[0]) {
             if (is_builtin(args[0])) {
-                int code = execute_builtin(args);
+                int code = execute_builtin_command(node);
                 exit(code);
             }
-            execvp(args[0], args);
-            perror(args[0]);
-            exit(127);
+            spawn_exec(args);
         }
         exit(0);
     } else {
@@ -350,386 +1127,594 @@ static void execute_pipeline_command(ASTNode *node) {
     }
 }
 
+// Выполнение builtin в процессе shell с временно подменёнными stdin/stdout/stderr
+// in_fd/out_fd/err_fd < 0 - дескриптор не меняется
+static int execute_builtin_redirected(ASTNode *command, int in_fd, int out_fd, int err_fd) {
+    int saved_in = -1, saved_out = -1, saved_err = -1;
+    
+    fflush(stdout);
+    fflush(stderr);
+    if (in_fd >= 0) {
+        saved_in = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 0);
+        if (saved_in < 0 || dup2(in_fd, STDIN_FILENO) < 0) {
+            perror("redirect stdin");
+            if (saved_in >= 0) close(saved_in);
+            return 1;
+        }
+    }
+    if (out_fd >= 0) {
+        saved_out = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+        if (saved_out < 0 || dup2(out_fd, STDOUT_FILENO) < 0) {
+            perror("redirect stdout");
+            if (saved_out >= 0) close(saved_out);
+            if (saved_in >= 0) {
+                dup2(saved_in, STDIN_FILENO);
+                close(saved_in);
+            }
+            return 1;
+        }
+    }
+    if (err_fd >= 0) {
+        saved_err = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 0);
+        if (saved_err < 0 || dup2(err_fd, STDERR_FILENO) < 0) {
+            perror("redirect stderr");
+            if (saved_err >= 0) close(saved_err);
+            saved_err = -1;
+        }
+    }
+    
+    int code = execute_builtin_command(command);
+    
+    // Сбрасываем буферы stdio пока stdout/stderr ещё перенаправлены
+    fflush(stdout);
+    fflush(stderr);
+    if (saved_out >= 0) {
+        dup2(saved_out, STDOUT_FILENO);
+        close(saved_out);
+    }
+    if (saved_err >= 0) {
+        dup2(saved_err, STDERR_FILENO);
+        close(saved_err);
+    }
+    if (saved_in >= 0) {
+        dup2(saved_in, STDIN_FILENO);
+        close(saved_in);
+        // EOF прочитанного pipe не должен остаться признаком stdin shell
+        clearerr(stdin);
+    }
+    return code;
+}
+
+// Можно ли выполнить стадию pipeline в процессе shell без fork
+// Чистые builtins - в любой позиции, остальные builtins - только последней стадией
+// и только при включённой опции lastpipe (иначе изменения состояния shell
+// не должны быть видны, как в подпроцессе)
+static int pipeline_stage_in_process(ASTNode *node, int is_last) {
+    if (!node || node->type != AST_COMMAND) {
+        return 0;
+    }
+    char **args = node->data.command.args;
+    if (!args || !args[0] || !is_builtin(args[0])) {
+        return 0;
+    }
+    return builtin_is_pure(args) || (is_last && shell_option_get(OPT_LASTPIPE));
+}
+
+// Максимальный размер pipe для непривилегированных процессов
+// Читается из /proc один раз, 0 если недоступен
+static long pipe_max_size(void) {
+    static long cached = -1;
+    if (cached < 0) {
+        cached = 0;
+        FILE *f = fopen("/proc/sys/fs/pipe-max-size", "r");
+        if (f) {
+            if (fscanf(f, "%ld", &cached) != 1) {
+                cached = 0;
+            }
+            fclose(f);
+        }
+    }
+    return cached;
+}
+
+// Размер буфера pipe для pipeline: PIPEBUF=SIZE перед pipeline,
+// иначе опция set -o pipebuf=SIZE; 0 - оставить размер ядра по умолчанию
+static long pipeline_pipe_size(ASTNode *root) {
+    long size = (long)root->data.binary.pipe_size;
+    if (size <= 0) {
+        size = shell_option_get(OPT_PIPEBUF);
+    }
+    long max = pipe_max_size();
+    if (max > 0 && size > max) {
+        size = max;
+    }
+    return size;
+}
+
 // Выполнение pipeline (cmd1 | cmd2 | cmd3)
-// Создаёт pipes между командами, fork для каждой команды, настраивает stdin/stdout/stderr
+// Количество стадий не ограничено. Pipe для стадии создаётся только в момент
+// её запуска, у родителя одновременно открыт лишь читающий конец предыдущего pipe
+// и текущий pipe. Внешние команды запускаются через spawn, builtins выполняются
+// в процессе shell, остальные стадии через fork. Дочерние процессы получают
+// чистую таблицу дескрипторов (всё начиная с 3 закрывается)
 static int execute_pipeline(ASTNode *root) {
-    ASTNode *commands[64];
-    int pipe_stderr[64] = {0};    
-    int cmd_count = collect_pipeline_commands(root, commands, pipe_stderr, 64);
-    if (cmd_count < 0) {
+    size_t cmd_count = 0;
+    PipelineStage *stages = collect_pipeline_stages(root, &cmd_count);
+    if (!stages) {
         return 1;
     }
     
     if (cmd_count == 1) {
-        return executor_execute(commands[0]);
-    }
-    
-    // Создаём pipes для связи между командами
-    int pipes[cmd_count - 1][2];
-    for (int i = 0; i < cmd_count - 1; i++) {
-        if (pipe(pipes[i]) < 0) {
-            perror("pipe");
-            // При ошибке закрываем уже созданные pipes
-            for (int j = 0; j < i; j++) {
-                close(pipes[j][0]);
-                close(pipes[j][1]);
-            }
-            return 1;
-        }
+        ASTNode *only = stages[0].node;
+        free(stages);
+        return executor_execute(only);
     }
     
     // Определяем PGID для процессов pipeline
-    // Если в фоне - используем текущую группу (созданную execute_background)
-    // Если на переднем плане - первый процесс станет лидером новой группы
-    pid_t pipeline_pgid = g_in_background ? getpgrp() : 0;
-    
-    // Создаём процесс для каждой команды в pipeline
-    pid_t pids[cmd_count];
-    for (int i = 0; i < cmd_count; i++) {
-        pids[i] = fork();
+    // Если в фоне - остаёмся в текущей группе (созданной execute_background)
+    // Если на переднем плане - первый запущенный процесс становится лидером новой группы
+    pid_t pipeline_pgid = g_in_background ? SPAWN_PGID_INHERIT : 0;
+    
+    long pipe_size = pipeline_pipe_size(root);
+    
+    // Читающий конец pipe от предыдущей стадии (stdin текущей)
+    int prev_fd = -1;
+    int launch_failed = 0;
+    
+    for (size_t i = 0; i < cmd_count; i++) {
+        PipelineStage *st = &stages[i];
+        int is_last = (i == cmd_count - 1);
+        st->pid = -1;
+        st->status = 127;
         
-        if (pids[i] < 0) {
-            perror("fork");
-            // При ошибке закрываем все pipes
-            for (int j = 0; j < cmd_count - 1; j++) {
-                close(pipes[j][0]);
-                close(pipes[j][1]);
-            }
-            return 1;
+        if (launch_failed) {
+            continue;
         }
         
-        if (pids[i] == 0) {
-            // Дочерний процесс: присоединяемся к группе pipeline
-            // Для первого процесса на переднем плане: создаём новую группу (pgid=0 -> свой PID)
-            // Для остальных или в фоне: присоединяемся к существующей группе
-            if (g_in_background) {
-                // В фоне: все процессы в группе фоновой задачи
-                setpgid(0, pipeline_pgid);
-            } else {
-                // На переднем плане: первый создаёт группу, остальные присоединяются
-                setpgid(0, pids[0] == 0 ? 0 : pids[0]);
-            }
-            
-            signal(SIGINT, SIG_DFL);
-            signal(SIGTSTP, SIG_DFL);
-            signal(SIGQUIT, SIG_DFL);
-            signal(SIGTTIN, SIG_DFL);
-            signal(SIGTTOU, SIG_DFL);
-            
-            // Настройка stdin: читаем из предыдущего pipe (если не первая команда)
-            if (i > 0) {
-                // Заменяем stdin на читающий конец предыдущего pipe
-                if (dup2(pipes[i-1][0], STDIN_FILENO) < 0) {
-                    perror("dup2");
-                    exit(1);
-                }
-            }
-            
-            // Настройка stdout: пишем в следующий pipe (если не последняя команда)
-            if (i < cmd_count - 1) {
-                // Заменяем stdout на пишущий конец текущего pipe
-                if (dup2(pipes[i][1], STDOUT_FILENO) < 0) {
-                    perror("dup2");
-                    exit(1);
+        if (pipeline_stage_in_process(st->node, is_last)) {
+            // Вывод промежуточной стадии накапливается в memfd, который затем
+            // становится stdin следующей стадии: ни fork, ни потока-писателя,
+            // и нет риска заблокироваться на заполненном pipe
+            int out_fd = is_last ? -1 : memfd_create("pipeline-builtin", MFD_CLOEXEC);
+            if (is_last || out_fd >= 0) {
+                // Последняя стадия (lastpipe) может читать stdin (jobq) - на время
+                // её выполнения stdin shell подменяется pipe от предыдущей стадии.
+                // Чистые builtins stdin не читают: pipe просто закрывается
+                int in_fd = is_last ? prev_fd : -1;
+                
+                long stage = time_stage_self_begin(st->node);
+                st->status = execute_builtin_redirected(st->node, in_fd, out_fd,
+                                                        st->pipe_stderr ? out_fd : -1);
+                time_stage_self_end(stage);
+                st->pid = 0;
+                
+                if (prev_fd >= 0) {
+                    close(prev_fd);
+                    prev_fd = -1;
                 }
-                // Для |& (pipe stderr) также перенаправляем stderr
-                if (pipe_stderr[i]) {
-                    if (dup2(pipes[i][1], STDERR_FILENO) < 0) {
-                        perror("dup2");
-                        exit(1);
-                    }
+                if (out_fd >= 0) {
+                    lseek(out_fd, 0, SEEK_SET);
+                    prev_fd = out_fd;
                 }
+                continue;
             }
-            
-            // Закрываем все копии pipe дескрипторов (уже сделали dup2)
-            for (int j = 0; j < cmd_count - 1; j++) {
-                close(pipes[j][0]);
-                close(pipes[j][1]);
+        }
+        
+        // Pipe к следующей стадии создаётся только сейчас
+        // O_CLOEXEC: процессы после exec не наследуют чужие концы pipe,
+        // dup2 на stdin/stdout снимает флаг только с нужных дескрипторов
+        int pipefd[2] = {-1, -1};
+        if (!is_last && pipe2(pipefd, O_CLOEXEC) < 0) {
+            perror("pipe");
+            launch_failed = 1;
+            continue;
+        }
+        // Больший буфер - меньше переключений контекста между стадиями
+        // (одинаково для | и |&). Ошибка не критична: остаётся размер по умолчанию
+        if (!is_last && pipe_size > 0) {
+            fcntl(pipefd[1], F_SETPIPE_SZ, (int)pipe_size);
+        }
+        
+        SpawnOptions opts;
+        spawn_options_init(&opts, pipeline_pgid, g_in_background);
+        
+        // Настройка stdin: читаем из предыдущего pipe (если не первая команда)
+        if (prev_fd >= 0) {
+            spawn_options_dup2(&opts, prev_fd, STDIN_FILENO);
+        }
+        // Настройка stdout: пишем в следующий pipe (если не последняя команда)
+        if (!is_last) {
+            spawn_options_dup2(&opts, pipefd[1], STDOUT_FILENO);
+            // Для |& (pipe stderr) также перенаправляем stderr
+            if (st->pipe_stderr) {
+                spawn_options_dup2(&opts, pipefd[1], STDERR_FILENO);
             }
-            
-            execute_pipeline_command(commands[i]);
-            exit(1);
         }
+        // Все остальные дескрипторы закрываются одним close_range
+        spawn_options_close_from(&opts, STDERR_FILENO + 1);
         
-        // Родитель: гарантируем правильную группу для каждого дочернего процесса
-        if (g_in_background) {
-            setpgid(pids[i], pipeline_pgid);
+        if (is_spawnable(st->node)) {
+            // Ошибка запуска (команда не найдена) не прерывает pipeline
+            st->pid = spawn_node(st->node, &opts, &st->status, &st->procsubst);
         } else {
-            // На переднем плане: первый процесс - лидер, остальные в его группе
-            if (i == 0) {
-                setpgid(pids[i], pids[i]);  // Первый становится лидером
-            } else {
-                setpgid(pids[i], pids[0]);  // Остальные в группу первого
+            st->pid = fork();
+            
+            if (st->pid < 0) {
+                perror("fork");
+                st->status = 1;
+                launch_failed = 1;
+            } else if (st->pid == 0) {
+                spawn_child_setup(&opts);
+                execute_pipeline_command(st->node);
+                exit(1);
+            } else if (pipeline_pgid != SPAWN_PGID_INHERIT) {
+                // Родитель: гарантируем правильную группу для дочернего процесса
+                setpgid(st->pid, pipeline_pgid ? pipeline_pgid : st->pid);
             }
         }
+        
+        time_stage_started(st->pid, st->node);
+        
+        // Родитель закрывает концы, переданные дочернему процессу
+        if (prev_fd >= 0) {
+            close(prev_fd);
+        }
+        if (!is_last) {
+            close(pipefd[1]);
+        }
+        prev_fd = pipefd[0];
+        
+        // Первый запущенный процесс - лидер группы, остальные присоединяются к нему
+        // Терминал передаём группе сразу, пока shell запускает остальные стадии
+        if (st->pid > 0 && pipeline_pgid == 0) {
+            pipeline_pgid = st->pid;
+            tcsetpgrp(STDIN_FILENO, pipeline_pgid);
+        }
     }
     
-    // Родитель закрывает все pipes (дочерние процессы уже сделали dup2)
-    for (int i = 0; i < cmd_count - 1; i++) {
-        close(pipes[i][0]);
-        close(pipes[i][1]);
-    }
-    
-    // Передаём терминал группе pipeline ТОЛЬКО если не в фоне
-    if (!g_in_background) {
-        tcsetpgrp(STDIN_FILENO, pids[0]);
+    if (prev_fd >= 0) {
+        close(prev_fd);
     }
     
-    int last_status = 0;
     int any_stopped = 0;
+    int stopped_status = 0;
     
-    // Ожидаем завершения всех команд в pipeline
-    for (int i = 0; i < cmd_count; i++) {
+    size_t pending = 0;
+    for (size_t i = 0; i < cmd_count; i++) {
+        if (stages[i].pid > 0) {
+            pending++;
+        }
+    }
+    
+    // Ожидаем завершения всех процессов pipeline в порядке их завершения:
+    // wait4 по группе процессов (в фоне группа общая с shell - тогда по PID).
+    // Момент сбора каждой стадии и её rusage нужны для time
+    size_t next = 0;
+    while (pending > 0) {
         int status;
-        waitpid(pids[i], &status, WUNTRACED);
+        struct rusage usage;
+        pid_t pid;
+        
+        if (pipeline_pgid > 0) {
+            pid = job_wait_foreground(-pipeline_pgid, &status, &usage, g_deadline);
+        } else {
+            while (stages[next].pid <= 0 || stages[next].waited) {
+                next++;
+            }
+            pid = job_wait_foreground(stages[next].pid, &status, &usage, g_deadline);
+        }
+        if (pid == 0) {
+            // Истёк срок timeout: сигнал всей группе или каждой стадии
+            int sig = deadline_expire(g_deadline);
+            for (size_t k = 0; sig && k < cmd_count; k++) {
+                if (pipeline_pgid > 0) {
+                    kill(-pipeline_pgid, sig);
+                    break;
+                }
+                if (stages[k].pid > 0 && !stages[k].waited) {
+                    kill(stages[k].pid, sig);
+                }
+            }
+            continue;
+        }
+        if (pid < 0) {
+            break;
+        }
+        
+        size_t i = 0;
+        while (i < cmd_count && (stages[i].pid != pid || stages[i].waited)) {
+            i++;
+        }
+        if (i == cmd_count) {
+            continue;
+        }
+        stages[i].waited = 1;
+        pending--;
         
         // Если хотя бы один процесс остановлен (Ctrl+Z)
         if (WIFSTOPPED(status)) {
             any_stopped = 1;
+            stopped_status = executor_wait_code(status);
+        } else {
+            time_report_reaped(g_time_report, pid, &usage);
         }
-        
-        // Код возврата pipeline = код возврата последней команды
-        if (i == cmd_count - 1) {
-            if (WIFEXITED(status)) {
-                last_status = WEXITSTATUS(status);
-            } else {
-                last_status = 1;
-            }
+        stages[i].status = executor_wait_code(status);
+    }
+    
+    // Стадии, выполненные в shell или не запустившиеся, уже имеют код в status
+    // Код pipeline - код последней стадии, при set -o pipefail - самой правой
+    // стадии с ненулевым кодом
+    int *codes = malloc(cmd_count * sizeof(int));
+    int last_status = stages[cmd_count - 1].status;
+    for (size_t i = 0; i < cmd_count; i++) {
+        if (codes) {
+            codes[i] = stages[i].status;
+        }
+        if (stages[i].status != 0 && shell_option_get(OPT_PIPEFAIL)) {
+            last_status = stages[i].status;
         }
     }
+    if (codes) {
+        pipestatus_set(codes, cmd_count);
+        free(codes);
+    }
     
     // Возвращаем управление терминалом shell'у ТОЛЬКО если не в фоне
-    if (!g_in_background) {
+    // и если терминал вообще передавался (была хотя бы одна внешняя стадия)
+    if (pipeline_pgid > 0) {
         tcsetpgrp(STDIN_FILENO, getpgrp());
     }
     
+    for (size_t i = 0; i < cmd_count; i++) {
+        if (any_stopped) {
+            procsubst_defer(&stages[i].procsubst);
+        } else {
+            procsubst_wait(&stages[i].procsubst);
+        }
+    }
+    
     // Если pipeline остановлен - создаём job (только на переднем плане)
     if (any_stopped && !g_in_background) {
         char *cmd_str = ast_to_string(root);
-        Job *job = job_create(pids[0], cmd_str, JOB_STOPPED);
+        Job *job = job_create(pipeline_pgid, cmd_str, JOB_STOPPED);
         if(job){
             // Добавляем все процессы pipeline в job
-            for(int i = 0; i < cmd_count; i++){
-                job_add_process(job, pids[i], cmd_str);
+            for(size_t i = 0; i < cmd_count; i++){
+                if(stages[i].pid > 0){
+                    job_add_process(job, stages[i].pid, cmd_str);
+                }
             }
+            time_report_attach(job);
             job_list_add(job_list_get(), job);
             printf("\n[%d] Stopped   %s\n", job->job_id, cmd_str);
         }
         free(cmd_str);
-        return 0;
+        free(stages);
+        return stopped_status;
     }
     
+    free(stages);
     return last_status;
 }
 
-// Вспомогательная структура для хранения информации о редиректе
-typedef struct {
-    RedirectType type;
-    int fd;  // открытый файловый дескриптор
-} RedirectInfo;
-
-// Собрать все редиректы из вложенной структуры AST в массив
-// Возвращает количество редиректов, заполняет массив redirects
-// Также возвращает финальную команду (не-редирект узел)
-static int collect_redirects(ASTNode *node, RedirectInfo **redirects, ASTNode **command) {
-    int count = 0;
-    int capacity = 4;
-    RedirectInfo *redir_array = malloc(capacity * sizeof(RedirectInfo));
-    if (!redir_array) {
-        perror("collect_redirects: malloc");
-        return -1;
+#define CAPTURE_PIPE_SIZE (1024 * 1024)   // Буфер pipe при захвате вывода
+#define CAPTURE_READ_CHUNK 65536           // Минимум свободного места перед read
+
+// Чистый builtin без подстановок процессов: выполняется в процессе shell,
+// stdout временно заменяется потоком в растущий буфер (open_memstream)
+static char *capture_builtin(char **args, size_t *len) {
+    char *buf = NULL;
+    size_t size = 0;
+    
+    fflush(stdout);
+    FILE *saved = stdout;
+    FILE *mem = open_memstream(&buf, &size);
+    if (!mem) {
+        perror("open_memstream");
+        return NULL;
     }
+    stdout = mem;
+    execute_builtin(args);
+    fclose(mem);
+    stdout = saved;
     
-    // Идем по цепочке редиректов, собирая их в массив
-    ASTNode *current = node;
-    while (current && current->type == AST_REDIRECT) {
-        // Расширяем массив при необходимости
-        if (count >= capacity) {
-            capacity *= 2;
-            RedirectInfo *new_array = realloc(redir_array, capacity * sizeof(RedirectInfo));
-            if (!new_array) {
-                perror("collect_redirects: realloc");
-                // Закрываем уже открытые файлы
-                for (int i = 0; i < count; i++) {
-                    if (redir_array[i].fd >= 0) close(redir_array[i].fd);
-                }
-                free(redir_array);
-                return -1;
-            }
-            redir_array = new_array;
+    *len = size;
+    return buf;
+}
+
+// Выполнение AST с захватом stdout (подстановка команды $(...))
+// Чистые builtins выполняются без fork. Внешняя команда запускается через
+// spawn, прочее - одним fork; вывод читается из pipe с увеличенным буфером
+// большими блоками прямо в растущий буфер результата
+// Возвращает выделенный буфер (len байт и '\0') или NULL при ошибке
+char *executor_capture(ASTNode *root, size_t *len) {
+    *len = 0;
+    
+    Arena arena;
+    arena_init(&arena, 0);
+    root = expand_node(root, &arena);
+    char *buf = root ? capture_node(root, len) : NULL;
+    arena_free(&arena);
+    return buf;
+}
+
+// Захват вывода уже раскрытого узла (executor_capture)
+static char *capture_node(ASTNode *root, size_t *len) {
+    if (root->type == AST_COMMAND && root->procsub_count == 0 &&
+        root->data.command.args[0] && is_builtin(root->data.command.args[0]) &&
+        builtin_is_pure(root->data.command.args)) {
+        return capture_builtin(root->data.command.args, len);
+    }
+    
+    int pipefd[2];
+    if (pipe2(pipefd, O_CLOEXEC) < 0) {
+        perror("command substitution: pipe");
+        return NULL;
+    }
+    long pipe_size = pipe_max_size();
+    if (pipe_size <= 0 || pipe_size > CAPTURE_PIPE_SIZE) {
+        pipe_size = CAPTURE_PIPE_SIZE;
+    }
+    fcntl(pipefd[1], F_SETPIPE_SZ, (int)pipe_size);
+    
+    // Группа shell: команда остаётся на переднем плане вместе с ним
+    SpawnOptions opts;
+    spawn_options_init(&opts, SPAWN_PGID_INHERIT, g_in_background);
+    spawn_options_dup2(&opts, pipefd[1], STDOUT_FILENO);
+    spawn_options_close_from(&opts, STDERR_FILENO + 1);
+    
+    ProcSubstRun run = {0};
+    pid_t pid;
+    if (is_spawnable(root)) {
+        int fail_status = 0;
+        pid = spawn_node(root, &opts, &fail_status, &run);
+    } else {
+        fflush(stdout);
+        pid = fork();
+        if (pid == 0) {
+            spawn_child_setup(&opts);
+            g_in_background = 1;
+            exit(executor_execute(root));
         }
-        
-        // Открываем файл согласно типу редиректа
-        int fd = -1;
-        switch (current->data.redirect.type) {
-            case REDIR_IN:
-                fd = open(current->data.redirect.filename, O_RDONLY);
-                break;
-            case REDIR_OUT:
-                fd = open(current->data.redirect.filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-                break;
-            case REDIR_OUT_APPEND:
-                fd = open(current->data.redirect.filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
-                break;
-            case REDIR_ERR:
-                fd = open(current->data.redirect.filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-                break;
-            case REDIR_ERR_APPEND:
-                fd = open(current->data.redirect.filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
-                break;
+        if (pid < 0) {
+            perror("fork");
         }
-        
-        if (fd < 0) {
-            perror(current->data.redirect.filename);
-            // Закрываем уже открытые файлы
-            for (int i = 0; i < count; i++) {
-                if (redir_array[i].fd >= 0) close(redir_array[i].fd);
+    }
+    close(pipefd[1]);
+    
+    size_t cap = 2 * CAPTURE_READ_CHUNK;
+    char *buf = malloc(cap);
+    if (!buf) {
+        perror("command substitution: malloc");
+    }
+    while (buf) {
+        if (cap - *len < CAPTURE_READ_CHUNK) {
+            char *grown = realloc(buf, cap * 2);
+            if (!grown) {
+                perror("command substitution: realloc");
+                break;
             }
-            free(redir_array);
-            return -1;
+            buf = grown;
+            cap *= 2;
         }
-        
-        redir_array[count].type = current->data.redirect.type;
-        redir_array[count].fd = fd;
-        count++;
-        
-        current = current->data.redirect.command;
+        ssize_t n = read(pipefd[0], buf + *len, cap - *len - 1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        *len += (size_t)n;
     }
+    close(pipefd[0]);
     
-    *redirects = redir_array;
-    *command = current;
-    return count;
+    if (pid > 0) {
+        while (waitpid(pid, NULL, 0) < 0 && errno == EINTR) {}
+    }
+    procsubst_wait(&run);
+    
+    if (buf) {
+        buf[*len] = '\0';
+    }
+    return buf;
 }
 
 // Выполнение перенаправления ввода/вывода
-// Собирает все редиректы, открывает файлы, применяет только последний для каждого дескриптора
+// Для внешней команды редиректы передаются в spawn как действия над дескрипторами,
+// shell свои stdin/stdout/stderr не трогает. Только для builtins (выполняются
+// в процессе shell) дескрипторы временно подменяются и затем восстанавливаются
 static int execute_redirect(ASTNode *root){
-    RedirectInfo *redirects = NULL;
-    ASTNode *command = NULL;
+    if (is_spawnable(root)) {
+        return execute_external(root);
+    }
     
-    // Собираем все редиректы в массив
-    int redir_count = collect_redirects(root, &redirects, &command);
-    if (redir_count < 0) {
+    RedirectPlan plan;
+    ASTNode *command = NULL;
+    if (redirect_compile(root, &plan, &command) < 0) {
         return 1;
     }
     
-    // Сохраняем оригинальные дескрипторы
-    int saved_stdin = -1, saved_stdout = -1, saved_stderr = -1;
-    int stdin_redirected = 0, stdout_redirected = 0, stderr_redirected = 0;
+    // Сохраняем оригинальные дескрипторы (O_CLOEXEC - не утекают в дочерние процессы)
+    int saved[3] = {-1, -1, -1};
+    int code = 1;
     
-    // Проходим по редиректам от начала массива
-    // redirects[0] = последний (внешний) редирект в команде
-    // redirects[count-1] = первый (внутренний) редирект
-    // Для каждого дескриптора применяем только первый найденный (= последний в команде)
-    for (int i = 0; i < redir_count; i++) {
-        switch (redirects[i].type) {
-            case REDIR_IN:
-                if (!stdin_redirected) {
-                    saved_stdin = dup(STDIN_FILENO);
-                    if (saved_stdin < 0 || dup2(redirects[i].fd, STDIN_FILENO) < 0) {
-                        perror("redirect stdin");
-                        goto cleanup_error;
-                    }
-                    stdin_redirected = 1;
-                }
-                break;
-                
-            case REDIR_OUT:
-            case REDIR_OUT_APPEND:
-                if (!stdout_redirected) {
-                    saved_stdout = dup(STDOUT_FILENO);
-                    if (saved_stdout < 0 || dup2(redirects[i].fd, STDOUT_FILENO) < 0) {
-                        perror("redirect stdout");
-                        goto cleanup_error;
-                    }
-                    stdout_redirected = 1;
-                }
-                break;
-                
-            case REDIR_ERR:
-            case REDIR_ERR_APPEND:
-                if (!stdout_redirected) {
-                    saved_stdout = dup(STDOUT_FILENO);
-                    if (saved_stdout < 0 || dup2(redirects[i].fd, STDOUT_FILENO) < 0) {
-                        perror("redirect stdout");
-                        goto cleanup_error;
-                    }
-                    stdout_redirected = 1;
-                }
-                if (!stderr_redirected) {
-                    saved_stderr = dup(STDERR_FILENO);
-                    if (saved_stderr < 0 || dup2(redirects[i].fd, STDERR_FILENO) < 0) {
-                        perror("redirect stderr");
-                        goto cleanup_error;
-                    }
-                    stderr_redirected = 1;
-                }
-                break;
+    fflush(stdout);
+    fflush(stderr);
+    for (int target = 0; target < 3; target++) {
+        if (plan.target_fd[target] < 0) {
+            continue;
+        }
+        saved[target] = fcntl(target, F_DUPFD_CLOEXEC, 0);
+        if (saved[target] < 0 || dup2(plan.target_fd[target], target) < 0) {
+            perror("redirect");
+            goto restore;
         }
     }
     
-    // Закрываем все открытые файловые дескрипторы
-    for (int i = 0; i < redir_count; i++) {
-        close(redirects[i].fd);
-    }
-    free(redirects);
+    // Закрываем открытые файлы: копии уже на stdin/stdout/stderr
+    redirect_plan_close(&plan);
     
     // Выполняем команду
-    int code = executor_execute(command);
+    code = executor_execute(command);
     
+restore:
+    redirect_plan_close(&plan);
+    fflush(stdout);
+    fflush(stderr);
     // Восстанавливаем оригинальные дескрипторы
-    if (saved_stdin >= 0) {
-        dup2(saved_stdin, STDIN_FILENO);
-        close(saved_stdin);
-    }
-    if (saved_stdout >= 0) {
-        dup2(saved_stdout, STDOUT_FILENO);
-        close(saved_stdout);
-    }
-    if (saved_stderr >= 0) {
-        dup2(saved_stderr, STDERR_FILENO);
-        close(saved_stderr);
+    for (int target = 0; target < 3; target++) {
+        if (saved[target] >= 0) {
+            dup2(saved[target], target);
+            close(saved[target]);
+        }
     }
     
     return code;
-
-cleanup_error:
-    // Закрываем все открытые дескрипторы при ошибке
-    for (int i = 0; i < redir_count; i++) {
-        close(redirects[i].fd);
-    }
-    free(redirects);
-    if (saved_stdin >= 0) close(saved_stdin);
-    if (saved_stdout >= 0) close(saved_stdout);
-    if (saved_stderr >= 0) close(saved_stderr);
-    return 1;
 }
 
-// Выполнение логических операторов && и ||
-// && - выполняет правую часть только если левая успешна (код 0)
-// || - выполняет правую часть только если левая неуспешна (код != 0)
-static int execute_and_or(ASTNode *root){
-    int left_code = executor_execute(root->data.binary.left);
+// Выполнение ;, && и || без рекурсии
+// Парсер строит цепочки левоассоциативно: a && b || c - OR(AND(a, b), c).
+// Левые ветви спускаются в явный стек, правая часть выполняется вместо
+// своего узла (её код - код всего узла), поэтому стек C не растёт с длиной
+// цепочки - строки из тысяч && и ; не переполняют его
+// && выполняет правую часть только если левая успешна (код 0),
+// || - только если неуспешна, ; - всегда
+static int execute_list(ASTNode *root){
+    ASTStack stack;
+    ast_stack_init(&stack);
+    int code = 0;
+    ASTNode *node = root;
 
-    if(root->type == AST_AND){
-        if(left_code == 0){
-            return executor_execute(root->data.binary.right);
+    while(node){
+        while(node->type == AST_SEQUENCE || node->type == AST_AND || node->type == AST_OR){
+            if(ast_stack_push(&stack, node, 0) < 0){
+                ast_stack_free(&stack);
+                return 1;
+            }
+            node = ast_child(node, node->data.binary.left);
         }
-        return left_code;
-    }
+        code = executor_execute(node);
 
-    if(root->type == AST_OR){
-        if(left_code != 0){
-            return executor_execute(root->data.binary.right);
+        // Ближайший узел, чья правая часть выполняется при этом коде;
+        // пропущенные узлы возвращают код левой части
+        node = NULL;
+        while(stack.count > 0){
+            ASTNode *parent = stack.items[--stack.count].node;
+            if(parent->type == AST_SEQUENCE || (parent->type == AST_AND) == (code == 0)){
+                node = ast_child(parent, parent->data.binary.right);
+                break;
+            }
         }
-        return left_code;
     }
 
-    return 1;
+    ast_stack_free(&stack);
+    return code;
 }
 
 // Выполнение subshell (команды в скобках)
 // Создаёт отдельный процесс для изоляции окружения
+// Вложенные subshell выполняются рекурсивно: глубину ограничивает парсер
+// (PARSER_MAX_DEPTH), поэтому стек дочернего процесса не переполняется
 static int execute_subshell(ASTNode *root){
     pid_t pid = fork();
     
@@ -740,18 +1725,13 @@ static int execute_subshell(ASTNode *root){
     
     if(pid == 0){
         // Дочерний процесс: создаём изолированное окружение
-        if(!g_in_background){
-            setpgid(0, 0);  // Новая группа процессов
-        }
-        // Восстанавливаем обработку сигналов
-        signal(SIGINT, SIG_DFL);
-        signal(SIGTSTP, SIG_DFL);
-        signal(SIGQUIT, SIG_DFL);
-        signal(SIGTTIN, SIG_DFL);
-        signal(SIGTTOU, SIG_DFL);
+        // (новая группа процессов если не в фоне, сигналы по умолчанию)
+        SpawnOptions opts;
+        spawn_options_init(&opts, g_in_background ? SPAWN_PGID_INHERIT : 0, g_in_background);
+        spawn_child_setup(&opts);
         
         // Выполняем команды внутри subshell и завершаемся
-        int code = executor_execute(root->data.subshell);
+        int code = executor_execute(ast_child(root, root->data.subshell));
         exit(code);
     }
     
@@ -763,29 +1743,54 @@ static int execute_subshell(ASTNode *root){
         setpgid(pid, getpgrp());
     }
     
+    time_stage_started(pid, root);
+    
     int status;
-    waitpid(pid, &status, WUNTRACED);
+    struct rusage usage;
+    wait_foreground(pid, &status, &usage);
+    if(!WIFSTOPPED(status)){
+        time_report_reaped(g_time_report, pid, &usage);
+    }
     
     if(!g_in_background){
         tcsetpgrp(STDIN_FILENO, getpgrp());
     }
     
-    if(WIFEXITED(status)){
-        return WEXITSTATUS(status);
-    }
-    
     // Если subshell остановлен (Ctrl+Z), создаём job
     if(WIFSTOPPED(status)){
         char *cmd_str = ast_to_string(root);
         Job *job = job_create(pid, cmd_str, JOB_STOPPED);
         if(job){
             job_add_process(job, pid, cmd_str);
+            time_report_attach(job);
             job_list_add(job_list_get(), job);
             printf("\n[%d] Stopped   %s\n", job->job_id, cmd_str);
         }
         free(cmd_str);
-        return 0;
     }
     
-    return 1;
+    // Сигнал или остановка - 128+N, как в bash (Ctrl+Z даёт 148)
+    return executor_wait_code(status);
+}
+
+// Выполнение time [-p|-m] pipeline
+// Отчёт (real/user/sys/maxrss для pipeline и каждой стадии) выводится в stderr
+// после завершения. Если pipeline остановлен, отчёт переходит в задачу и
+// выводится при её завершении после fg/bg
+static int execute_time(ASTNode *root){
+    TimeReport *saved = g_time_report;
+    TimeReport *report = time_report_create(root->kind,
+                                            g_in_background ? TIME_PHASE_BACKGROUND : TIME_PHASE_FOREGROUND);
+    g_time_report = report;
+    
+    int code = executor_execute(ast_child(root, root->data.timed));
+    
+    // g_time_report сбрасывается, если отчёт передан остановленной задаче
+    if(g_time_report == report){
+        fflush(stdout);
+        time_report_print(report);
+        time_report_free(report);
+    }
+    g_time_report = saved;
+    return code;
 }
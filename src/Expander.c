@@ -1,11 +1,18 @@
 // Expander.c
 // Модуль раскрытия переменных окружения
-// Поддерживает: $VAR, ${VAR}, $?, $$, $!
+// Раскрытие выполняется Executor'ом для каждой команды перед её запуском
+// Поддерживает: $VAR, ${VAR}, $?, $$, $!, $PIPESTATUS
+// Раскрывает также тела here-document с ограничителем без кавычек
+// Подстановка команд $(...) и `...` выполняется через CommandSubst.c
 // $? - код возврата последней команды
 // $$ - PID текущего shell
 // $! - PID последнего фонового процесса
+// ${PIPESTATUS[N]} - код N-й стадии последнего pipeline, ${PIPESTATUS[@]} - все
+// через пробел, $PIPESTATUS - первая стадия (как в bash)
 
 #include "Expander.h"
+#include "CommandSubst.h"
+#include "Executor.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -20,25 +27,30 @@ extern int g_last_exit_code;   // Код возврата последней к
 extern pid_t g_last_bg_pid;    // PID последнего фонового процесса
 
 static char *get_variable(const char *name);
+static char *get_pipestatus(const char *subscript);
 static char *expand_string(const char *str);
 static int buffer_append(char **buf, size_t *len, size_t *cap, const char *str);
 
-// Раскрытие переменных во всех токенах типа TOKEN_WORD
-// Проходит по массиву токенов и заменяет $VAR на значения
-int expander_expand(TokenArray *tokens){
-    for(size_t i = 0; i < tokens->count; i++){
-        // Раскрываем только обычные слова (не операторы, не редиректы)
-        if(tokens->tokens[i].type == TOKEN_WORD && tokens->tokens[i].quote != QUOTE_SINGLE){
-            char *expanded = expand_string(tokens->tokens[i].text);
-            if(expanded){
-                free(tokens->tokens[i].text);
-                tokens->tokens[i].text = expanded;
-            }
+// Есть ли в слове $, ` или \ - только такие слова меняются при раскрытии
+// Парсер отмечает по нему узлы, которым нужно раскрытие при выполнении
+int expander_needs_expansion(const char *text, size_t len){
+    for(size_t i = 0; i < len; i++){
+        if(text[i] == '$' || text[i] == '`' || text[i] == '\\'){
+            return 1;
         }
     }
     return 0;
 }
 
+// Раскрытие одного слова AST непосредственно перед выполнением команды
+// Значения переменных и $? берутся на момент выполнения, поэтому разобранное
+// дерево можно выполнять повторно (кеш разбора). Текст в одинарных кавычках
+// лексер хранит с экранированными $, ` и \ - раскрытие возвращает его как есть
+// Возвращает выделенную строку или NULL при нехватке памяти
+char *expander_expand_word(const char *word){
+    return expand_string(word);
+}
+
 // Получение значения переменной по имени
 // Обрабатывает специальные переменные ($?, $$, $!) и обычные из окружения
 static char *get_variable(const char *name){
@@ -67,11 +79,56 @@ static char *get_variable(const char *name){
         return buf;
     }
 
+    // $PIPESTATUS и ${PIPESTATUS[...]} - коды стадий последнего pipeline
+    if(strncmp(name, "PIPESTATUS", 10) == 0 && (name[10] == '\0' || name[10] == '[')){
+        return get_pipestatus(name + 10);
+    }
+
     // Обычная переменная окружения (например, $HOME, $PATH)
     char *val = getenv(name);
     return val ? strdup(val) : strdup("");
 }
 
+// Значение PIPESTATUS по индексу: "" - элемент 0, "[N]" - элемент N,
+// "[@]" или "[*]" - все элементы через пробел
+static char *get_pipestatus(const char *subscript){
+    size_t count;
+    const int *codes = executor_pipestatus(&count);
+
+    int all = strcmp(subscript, "[@]") == 0 || strcmp(subscript, "[*]") == 0;
+    if(all){
+        char *buf = malloc(count * 12 + 1);
+        if(!buf){
+            return NULL;
+        }
+        size_t len = 0;
+        buf[0] = '\0';
+        for(size_t i = 0; i < count; i++){
+            len += sprintf(buf + len, i ? " %d" : "%d", codes[i]);
+        }
+        return buf;
+    }
+
+    size_t index = 0;
+    if(subscript[0] == '['){
+        char *end;
+        long n = strtol(subscript + 1, &end, 10);
+        if(end == subscript + 1 || strcmp(end, "]") != 0 || n < 0){
+            return strdup("");
+        }
+        index = (size_t)n;
+    }
+    if(index >= count){
+        return strdup("");
+    }
+
+    char *buf = malloc(16);
+    if(buf){
+        snprintf(buf, 16, "%d", codes[index]);
+    }
+    return buf;
+}
+
 // Добавление строки в динамический буфер с автоматическим расширением
 // Удваивает capacity при необходимости
 static int buffer_append(char **buf, size_t *len, size_t *cap, const char *str){
@@ -91,8 +148,30 @@ static int buffer_append(char **buf, size_t *len, size_t *cap, const char *str){
     return 0;
 }
 
-// Раскрытие переменных в строке
-// Находит $VAR, ${VAR}, $?, $$, $! и заменяет на значения
+// Текст команды подстановки str[start..end]
+// Для $(...) - как есть, для `...` снимается экранирование перед `, $ и обратной косой чертой
+static char *substitution_command(const char *str, size_t start, size_t end){
+    if(str[start] == '$'){
+        return strndup(str + start + 2, end - start - 2);
+    }
+
+    char *cmd = malloc(end - start);
+    if(!cmd){
+        return NULL;
+    }
+    size_t n = 0;
+    for(size_t j = start + 1; j < end; j++){
+        if(str[j] == '\\' && (str[j + 1] == '`' || str[j + 1] == '$' || str[j + 1] == '\\')){
+            j++;
+        }
+        cmd[n++] = str[j];
+    }
+    cmd[n] = '\0';
+    return cmd;
+}
+
+// Раскрытие переменных и подстановок команд в строке
+// Находит $VAR, ${VAR}, $?, $$, $!, $(...), `...` и заменяет на значения
 static char *expand_string(const char *str){
     if(!str){
         return NULL;
@@ -107,8 +186,8 @@ static char *expand_string(const char *str){
     
     // Проходим по строке посимвольно
     while(str[i]){
-        // Копируем обычные символы до символа '$'
-        while(str[i] && str[i] != '$'){
+        // Копируем обычные символы до '$', '`' или '\'
+        while(str[i] && str[i] != '$' && str[i] != '`' && str[i] != '\\'){
             if(len + 2 >= cap){
                 cap *= 2;
                 char *buf = realloc(result, cap);
@@ -121,6 +200,48 @@ static char *expand_string(const char *str){
             result[len++] = str[i++];
         }
 
+        // \$, \` и \\ (сохранены лексером) - символ без раскрытия
+        if(str[i] == '\\'){
+            char escaped[2] = { str[i], '\0' };
+            if(str[i + 1] == '$' || str[i + 1] == '`' || str[i + 1] == '\\'){
+                escaped[0] = str[i + 1];
+                i++;
+            }
+            i++;
+            if(buffer_append(&result, &len, &cap, escaped) < 0){
+                free(result);
+                return NULL;
+            }
+            continue;
+        }
+
+        // Подстановка команды $(...) или `...`
+        if(str[i] == '`' || (str[i] == '$' && str[i + 1] == '(')){
+            size_t end = command_subst_end(str, i);
+            if(end == COMMAND_SUBST_NOT_FOUND){
+                // Незакрытая подстановка остаётся как есть
+                if(buffer_append(&result, &len, &cap, str + i) < 0){
+                    free(result);
+                    return NULL;
+                }
+                break;
+            }
+
+            char *inner = substitution_command(str, i, end);
+            char *output = inner ? command_subst(inner) : NULL;
+            free(inner);
+            if(output){
+                int rc = buffer_append(&result, &len, &cap, output);
+                free(output);
+                if(rc < 0){
+                    free(result);
+                    return NULL;
+                }
+            }
+            i = end + 1;
+            continue;
+        }
+
         // Нашли символ '$' - начинается переменная
         if(str[i] == '$'){
             i++;
@@ -132,10 +253,15 @@ static char *expand_string(const char *str){
             if(str[i] == '{'){
                 i++;
                 while(str[i] && str[i] != '}'){
-                    var_name[var_len++] = str[i++];
+                    if(var_len < VAR_NAME_SIZE - 1){
+                        var_name[var_len++] = str[i];
+                    }
+                    i++;
                 }
                 var_name[var_len] = '\0';
-                i++;  // Пропускаем закрывающую '}'
+                if(str[i] == '}'){
+                    i++;  // Пропускаем закрывающую '}' (у незакрытой её нет)
+                }
             }
             // Специальная переменная $? (код возврата)
             else if(str[i] == '?'){
@@ -158,20 +284,33 @@ static char *expand_string(const char *str){
             // Обычная переменная $VAR (начинается с буквы или _, состоит из букв, цифр, _)
             else if(isalpha(str[i]) || str[i] == '_'){
                 while(isalnum(str[i]) || str[i] == '_'){
-                    var_name[var_len++] = str[i++];
+                    // Слишком длинное имя обрезается, как в ${VAR}
+                    if(var_len < VAR_NAME_SIZE - 1){
+                        var_name[var_len++] = str[i];
+                    }
+                    i++;
                 }
                 var_name[var_len] = '\0';
             }
             // Не распознанный формат - оставляем '$' как есть
             else{
-                result[len++] = '$';
+                if(buffer_append(&result, &len, &cap, "$") < 0){
+                    free(result);
+                    return NULL;
+                }
                 continue;
             }
 
             // Получаем значение переменной и добавляем в результат
             char *value = get_variable(var_name);
-            buffer_append(&result, &len, &cap, value);
-            free(value);
+            if(value){
+                int rc = buffer_append(&result, &len, &cap, value);
+                free(value);
+                if(rc < 0){
+                    free(result);
+                    return NULL;
+                }
+            }
         }
     }
 
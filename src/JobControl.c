@@ -1,6 +1,11 @@
 // JobControl.c
+// Список задач (jobs) и управление терминалом
+// Сбор дочерних процессов событийный: SIGCHLD заблокирован и читается через
+// signalfd, REPL и редактор строки ждут этот дескриптор вместе со stdin.
+// Обработчика сигнала нет - список задач меняется только из основного потока
 
 #include "JobControl.h"
+#include "Options.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,10 +13,14 @@
 #include <unistd.h>
 #include <signal.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <poll.h>
+#include <fcntl.h>
 #include <errno.h>
 
 // Глобальный список всех задач (jobs)
-static JobList g_job_list = {NULL, NULL, 1};
+static JobList g_job_list;
 // Process group ID shell (для возврата управления терминалом)
 static pid_t g_shell_pgid = 0;
 // Сохранённые настройки терминала shell
@@ -22,6 +31,39 @@ static int g_terminal_fd = STDIN_FILENO;
 static int g_is_interactive = 0;
 // Маска сигналов для блокировки во время критических операций
 static sigset_t g_child_mask;
+// signalfd для SIGCHLD: становится читаемым когда дочерний процесс сменил состояние
+// В маске также SIGINT - он попадает в signalfd только пока заблокирован (wait)
+static int g_child_event_fd = -1;
+// PID процесса shell: дочерние процессы (fork) не обслуживают задачи shell
+static pid_t g_shell_pid = 0;
+// Завершённые задачи, уже удалённые из списка (кольцо): статистика для
+// jobs --stats и статусы для wait PID. g_history_next - место следующей записи
+static Job *g_history[JOB_HISTORY_SIZE];
+static size_t g_history_next = 0;
+
+// Освобождение задачи вместе с процессами
+static void job_free(Job *job) {
+    if (!job) {
+        return;
+    }
+    
+    Process *proc = job->processes;
+    while (proc) {
+        Process *next_proc = proc->next;
+        free(proc->command);
+        free(proc);
+        proc = next_proc;
+    }
+    
+    time_report_free(job->timing);
+    if (job->output_fd >= 0) {
+        close(job->output_fd);
+    }
+    output_ring_free(job->output);
+    deadline_free(job->ttl);
+    free(job->command_line);
+    free(job);
+}
 
 // Инициализация системы job control
 // Вызывается при старте shell для настройки списка задач и маски сигналов
@@ -29,7 +71,12 @@ void job_control_init(void) {
     // Инициализация списка задач
     g_job_list.head = NULL;
     g_job_list.tail = NULL;
-    g_job_list.next_job_id = 1;
+    job_index_init(&g_job_list.by_id);
+    job_index_init(&g_job_list.by_pgid);
+    job_index_init(&g_job_list.by_pid);
+    g_job_list.id_bitmap = NULL;
+    g_job_list.id_bitmap_words = 0;
+    g_shell_pid = getpid();
     
     // Проверяем интерактивный ли режим (есть ли терминал)
     g_terminal_fd = STDIN_FILENO;
@@ -56,26 +103,29 @@ void job_control_cleanup(void) {
     
     while (current) {
         Job *next = current->next;
-        
-        // Освобождаем все процессы в задаче
-        Process *proc = current->processes;
-        while (proc) {
-            Process *next_proc = proc->next;
-            free(proc->command);
-            free(proc);
-            proc = next_proc;
-        }
-        
-        free(current->command_line);
-        free(current);
-        
+        job_free(current);
         current = next;
     }
     
-    // Сбрасываем список
+    for (size_t i = 0; i < JOB_HISTORY_SIZE; i++) {
+        job_free(g_history[i]);
+        g_history[i] = NULL;
+    }
+    
+    // Сбрасываем список и индексы
     g_job_list.head = NULL;
     g_job_list.tail = NULL;
-    g_job_list.next_job_id = 1;
+    job_index_free(&g_job_list.by_id);
+    job_index_free(&g_job_list.by_pgid);
+    job_index_free(&g_job_list.by_pid);
+    free(g_job_list.id_bitmap);
+    g_job_list.id_bitmap = NULL;
+    g_job_list.id_bitmap_words = 0;
+
+    if (g_child_event_fd >= 0) {
+        close(g_child_event_fd);
+        g_child_event_fd = -1;
+    }
 }
 
 // Настройка терминала для job control
@@ -127,7 +177,44 @@ JobList* job_list_get(void) {
     return &g_job_list;
 }
 
+#define ID_BITS (sizeof(unsigned long) * 8)
+
+// Выделение наименьшего свободного номера задачи по битовой карте
+// Номера завершённых задач переиспользуются, как в bash
+// Возвращает номер (>= 1) или -1 при ошибке
+static int job_id_alloc(JobList *list){
+    for(size_t w = 0; w < list->id_bitmap_words; w++){
+        if(~list->id_bitmap[w]){
+            int bit = __builtin_ctzl(~list->id_bitmap[w]);
+            list->id_bitmap[w] |= 1UL << bit;
+            return (int)(w * ID_BITS) + bit + 1;
+        }
+    }
+
+    // Все номера заняты - расширяем карту
+    size_t words = list->id_bitmap_words ? list->id_bitmap_words * 2 : 1;
+    unsigned long *grown = realloc(list->id_bitmap, words * sizeof(unsigned long));
+    if(!grown){
+        perror("job_id_alloc: realloc failed");
+        return -1;
+    }
+    memset(grown + list->id_bitmap_words, 0, (words - list->id_bitmap_words) * sizeof(unsigned long));
+    size_t w = list->id_bitmap_words;
+    list->id_bitmap = grown;
+    list->id_bitmap_words = words;
+    list->id_bitmap[w] = 1UL;
+    return (int)(w * ID_BITS) + 1;
+}
+
+static void job_id_release(JobList *list, int job_id){
+    size_t bit = (size_t)job_id - 1;
+    if(job_id > 0 && bit / ID_BITS < list->id_bitmap_words){
+        list->id_bitmap[bit / ID_BITS] &= ~(1UL << (bit % ID_BITS));
+    }
+}
+
 // Создание новой задачи (Job)
+// Номер задачи назначается при добавлении в список (job_list_add)
 // pgid - process group ID задачи
 // command_line - строковое представление команды для отображения
 // state - начальное состояние (JOB_BACKGROUND, JOB_FOREGROUND, JOB_STOPPED)
@@ -138,8 +225,7 @@ Job* job_create(pid_t pgid, const char *command_line, JobState state) {
         return NULL;
     }
     
-    // Присваиваем уникальный ID и увеличиваем счётчик
-    job->job_id = g_job_list.next_job_id++;
+    job->job_id = 0;
     job->pgid = pgid;
     job->state = state;
     job->processes = NULL;
@@ -149,6 +235,11 @@ Job* job_create(pid_t pgid, const char *command_line, JobState state) {
         return NULL;
     }
     job->notified = 0;  // Ещё не уведомляли о завершении
+    job->waited = 0;
+    job->timing = NULL;
+    job->output_fd = -1;
+    job->ttl = NULL;
+    job->output = NULL;
     job->next = NULL;
     job->prev = NULL;
     
@@ -169,8 +260,12 @@ void job_add_process(Job *job, pid_t pid, const char *command) {
     }
     
     proc->pid = pid;
+    proc->job = job;
     proc->state = PROC_RUNNING;  // Изначально все процессы запущены
     proc->exit_status = -1;
+    clock_gettime(CLOCK_REALTIME, &proc->start);
+    proc->end = proc->start;
+    memset(&proc->usage, 0, sizeof(proc->usage));
     proc->command = strdup(command);
     if (!proc->command) {
         free(proc);
@@ -180,6 +275,11 @@ void job_add_process(Job *job, pid_t pid, const char *command) {
     // Добавляем в начало списка процессов
     proc->next = job->processes;
     job->processes = proc;
+
+    // Задача уже в списке - процесс сразу попадает в индекс PID
+    if (job->job_id > 0) {
+        job_index_insert(&g_job_list.by_pid, pid, proc);
+    }
 }
 
 // Добавление задачи в список
@@ -192,6 +292,16 @@ void job_list_add(JobList *list, Job *job) {
     // Блокируем сигналы на время модификации списка
     sigset_t old_mask;
     sigprocmask(SIG_BLOCK, &g_child_mask, &old_mask);
+
+    int job_id = job_id_alloc(list);
+    job->job_id = job_id > 0 ? job_id : 0;
+    if (job->job_id > 0) {
+        job_index_insert(&list->by_id, job->job_id, job);
+    }
+    job_index_insert(&list->by_pgid, job->pgid, job);
+    for (Process *p = job->processes; p; p = p->next) {
+        job_index_insert(&list->by_pid, p->pid, p);
+    }
     
     // Добавляем в конец списка (tail)
     if (list->tail) {
@@ -207,7 +317,108 @@ void job_list_add(JobList *list, Job *job) {
     sigprocmask(SIG_SETMASK, &old_mask, NULL);
 }
 
-// Удаление задачи из списка и освобождение памяти
+// Чтение доступного вывода задачи из pipe в её буфер без блокировки
+// При EOF pipe закрывается
+static void job_output_read(Job *job){
+    char buf[8192];
+    while(job->output_fd >= 0){
+        ssize_t n = read(job->output_fd, buf, sizeof(buf));
+        if(n > 0){
+            output_ring_write(job->output, buf, (size_t)n);
+            continue;
+        }
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n == 0){
+            close(job->output_fd);
+            job->output_fd = -1;
+        }
+        break;  // EAGAIN - данных пока нет
+    }
+}
+
+// Включение перехвата вывода задачи: fd - читающий конец pipe,
+// capacity - размер буфера (0 - по умолчанию)
+void job_capture_output(Job *job, int fd, size_t capacity){
+    job->output = output_ring_create(capacity);
+    if(!job->output){
+        close(fd);
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    job->output_fd = fd;
+}
+
+// Перенос доступного вывода всех задач в их буферы
+void job_output_drain(JobList *list){
+    for(Job *j = list->head; j; j = j->next){
+        if(j->output_fd >= 0){
+            job_output_read(j);
+        }
+    }
+}
+
+// Заполнение pollfd дескрипторами задач: pipe вывода и таймеры ttl (не больше max)
+// В дочернем процессе shell задачи не обслуживаются - там копия списка
+// Возвращает число заполненных элементов
+size_t job_pollfds(JobList *list, struct pollfd *fds, size_t max){
+    size_t n = 0;
+    if(getpid() != g_shell_pid){
+        return 0;
+    }
+    for(Job *j = list->head; j && n < max; j = j->next){
+        if(j->output_fd >= 0){
+            fds[n].fd = j->output_fd;
+            fds[n].events = POLLIN;
+            fds[n].revents = 0;
+            n++;
+        }
+        if(j->ttl && j->ttl->fd >= 0 && n < max){
+            fds[n].fd = j->ttl->fd;
+            fds[n].events = POLLIN;
+            fds[n].revents = 0;
+            n++;
+        }
+    }
+    return n;
+}
+
+// Обработка дескрипторов задач после poll
+// Вызывается из цикла событий (REPL, ожидание ввода, wait, команда на переднем плане):
+// вывод переносится в буферы, задачам с истёкшим сроком посылается сигнал
+void job_poll_dispatch(JobList *list){
+    if(getpid() != g_shell_pid){
+        return;
+    }
+    job_output_drain(list);
+
+    for(Job *j = list->head; j; j = j->next){
+        int sig = j->ttl ? deadline_expire(j->ttl) : 0;
+        if(sig && j->state != JOB_COMPLETED){
+            job_kill(j, sig);
+            // Остановленная задача получит сигнал только после продолжения
+            if(sig != SIGKILL){
+                job_kill(j, SIGCONT);
+            }
+        }
+    }
+}
+
+// Задача по номеру: сначала в списке, затем в истории завершённых
+Job* job_find_any(JobList *list, int job_id){
+    Job *j = job_list_find_by_id(list, job_id);
+    for(size_t i = 0; !j && job_history_get(i); i++){
+        if(job_history_get(i)->job_id == job_id){
+            j = job_history_get(i);
+        }
+    }
+    return j;
+}
+
+// Удаление задачи из списка
+// Завершённая задача переходит в кольцо истории (вытесняя самую старую),
+// остальные освобождаются
 void job_list_remove(JobList *list, Job *job) {
     if (!list || !job) {
         return;
@@ -226,17 +437,44 @@ void job_list_remove(JobList *list, Job *job) {
         list->tail = job->prev;
     }
     
-    // Освобождаем все процессы задачи
-    Process *proc = job->processes;
-    while (proc) {
-        Process *next_proc = proc->next;
-        free(proc->command);
-        free(proc);
-        proc = next_proc;
+    // Удаляем из индексов и освобождаем номер
+    job_index_remove(&list->by_id, job->job_id, job);
+    job_index_remove(&list->by_pgid, job->pgid, job);
+    job_id_release(list, job->job_id);
+    
+    for (Process *proc = job->processes; proc; proc = proc->next) {
+        job_index_remove(&list->by_pid, proc->pid, proc);
     }
+    job->next = NULL;
+    job->prev = NULL;
     
-    free(job->command_line);
-    free(job);
+    if (job_is_completed(job) != 1) {
+        job_free(job);
+        return;
+    }
+    
+    // В историю задача уходит с буфером вывода, но без pipe: дочитываем
+    // то, что уже есть, остальное (от оставшихся потомков) не ждём
+    if (job->output_fd >= 0) {
+        job_output_read(job);
+        if (job->output_fd >= 0) {
+            close(job->output_fd);
+            job->output_fd = -1;
+        }
+    }
+    deadline_disarm(job->ttl);
+    
+    job_free(g_history[g_history_next]);
+    g_history[g_history_next] = job;
+    g_history_next = (g_history_next + 1) % JOB_HISTORY_SIZE;
+}
+
+// Завершённая задача из истории: 0 - последняя удалённая, NULL - нет такой
+Job* job_history_get(size_t index){
+    if(index >= JOB_HISTORY_SIZE){
+        return NULL;
+    }
+    return g_history[(g_history_next + JOB_HISTORY_SIZE - 1 - index) % JOB_HISTORY_SIZE];
 }
 
 // Поиск задачи по ID (используется в fg/bg/kill командах)
@@ -244,12 +482,7 @@ Job* job_list_find_by_id(JobList *list, int job_id){
     if(!list){
         return NULL;
     }
-
-    for(Job *j = list->head; j; j = j->next){
-        if(j->job_id == job_id) return j;
-    }
-
-    return NULL;
+    return job_index_find(&list->by_id, job_id);
 }
 
 // Поиск задачи по process group ID
@@ -257,90 +490,450 @@ Job* job_list_find_by_pgid(JobList *list, pid_t pgid){
     if(!list){
         return NULL;
     }
+    return job_index_find(&list->by_pgid, pgid);
+}
 
-    for(Job *j = list->head; j; j = j->next){
-        if(j->pgid == pgid) return j;
+// Поиск процесса по PID среди всех задач
+Process* job_list_find_process(JobList *list, pid_t pid){
+    if(!list){
+        return NULL;
     }
-
-    return NULL;
+    return job_index_find(&list->by_pid, pid);
 }
 
 // Поиск задачи по PID любого из процессов в задаче
 // (задача может содержать несколько процессов, например pipeline)
 Job* job_list_find_by_pid(JobList *list, pid_t pid){
-    if(!list){
-        return NULL;
+    Process *p = job_list_find_process(list, pid);
+    return p ? p->job : NULL;
+}
+
+// Процесс собран: сохраняем rusage и время завершения для статистики
+static void job_process_reaped(Job *j, Process *p, struct rusage *usage){
+    p->state = PROC_COMPLETED;
+    p->usage = *usage;
+    clock_gettime(CLOCK_REALTIME, &p->end);
+    time_report_reaped(j->timing, p->pid, usage);
+}
+
+// Применение статуса от wait4 к процессу задачи
+static void job_apply_status(Job *j, Process *p, int status, struct rusage *usage){
+    if(WIFEXITED(status)){
+        // Нормальное завершение через exit()
+        p->exit_status = WEXITSTATUS(status);
+        job_process_reaped(j, p, usage);
+    }
+    else if(WIFSIGNALED(status)){
+        // Завершение по сигналу (например, SIGKILL)
+        p->exit_status = 128 + WTERMSIG(status);  // Стандартное соглашение
+        job_process_reaped(j, p, usage);
+    }
+    else if(WIFSTOPPED(status)){
+        // Остановлен (Ctrl+Z), статус для wait - 128 + номер сигнала остановки
+        p->state = PROC_STOPPED;
+        p->exit_status = 128 + WSTOPSIG(status);
+        time_report_phase(j->timing, TIME_PHASE_STOPPED);
+    }
+    else if(WIFCONTINUED(status)){
+        // Продолжен после остановки (SIGCONT)
+        p->state = PROC_RUNNING;
+    }
+}
+
+// Обновление состояния задачи на основе состояний процессов
+static void job_refresh_state(Job *j){
+    if(job_is_completed(j)){
+        j->state = JOB_COMPLETED;
     }
+    else if(job_is_stopped(j)){
+        j->state = JOB_STOPPED;
+    }
+}
 
-    for(Job *j = list->head; j; j = j->next){
-        for(Process *p = j->processes; p; p = p->next){
-            if(p->pid == pid) return j;
+// Обновление статусов процессов одной задачи
+// wait4 по каждому незавершённому процессу: не трогает чужих потомков
+// Использует WNOHANG для неблокирующей проверки статусов
+void job_update(Job *j){
+    if(!j) return;
+
+    for(Process *p = j->processes; p; p = p->next){
+        // Пропускаем уже завершённые процессы
+        if(p->state == PROC_COMPLETED){
+            continue;
+        }
+
+        int status;
+        struct rusage usage;
+        // WNOHANG - не блокируемся если процесс ещё работает
+        // WUNTRACED - получаем информацию об остановленных (Ctrl+Z)
+        // WCONTINUED - получаем информацию о продолженных (SIGCONT)
+        // wait4 - вместе со статусом получаем rusage для time
+        pid_t result = wait4(p->pid, &status, WNOHANG | WUNTRACED | WCONTINUED, &usage);
+
+        if(result == 0){
+            continue;  // Процесс ещё работает
+        }
+
+        if(result < 0){
+            if(errno == ECHILD){
+                // Процесса больше нет - помечаем как завершённый
+                p->state = PROC_COMPLETED;
+                clock_gettime(CLOCK_REALTIME, &p->end);
+            }
+            continue;
         }
+
+        job_apply_status(j, p, status, &usage);
     }
 
-    return NULL;
+    job_refresh_state(j);
 }
 
 // Обновление статусов всех задач и процессов
-// Вызывается из обработчика SIGCHLD и перед выводом jobs
-// Использует waitpid с WNOHANG для неблокирующей проверки статусов
+// Безопасно во время выполнения команды (builtins jobs/fg/bg/kill/wait)
 void job_update_all(JobList *list){
     if(!list) return;
 
     for(Job *j = list->head; j; j = j->next){
-        for(Process *p = j->processes; p; p = p->next){
-            // Пропускаем уже завершённые процессы
-            if(p->state == PROC_COMPLETED){
+        job_update(j);
+    }
+}
+
+// Сбор только тех дочерних процессов, которые сменили состояние
+// waitid(P_ALL, WNOWAIT) возвращает очередного изменившегося потомка без
+// сбора, затем wait4 по его PID забирает статус вместе с rusage.
+// Число системных вызовов пропорционально числу событий, а не задач.
+// Собирает и потомков вне списка задач (отложенные подстановки процессов),
+// поэтому вызывается только когда команда переднего плана не выполняется:
+// из REPL и из ожидания ввода в редакторе строки
+void job_reap_children(JobList *list){
+    if(!list) return;
+
+    // Сигналы SIGCHLD сливаются: одно чтение, затем проход до WNOHANG == 0
+    if(g_child_event_fd >= 0){
+        struct signalfd_siginfo info[8];
+        while(read(g_child_event_fd, info, sizeof(info)) > 0){}
+    }
+
+    for(;;){
+        siginfo_t info;
+        info.si_pid = 0;
+        if(waitid(P_ALL, 0, &info, WEXITED | WSTOPPED | WCONTINUED | WNOHANG | WNOWAIT) < 0 || info.si_pid == 0){
+            break;  // ECHILD или изменившихся потомков больше нет
+        }
+
+        int status;
+        struct rusage usage;
+        pid_t pid = wait4(info.si_pid, &status, WNOHANG | WUNTRACED | WCONTINUED, &usage);
+        if(pid <= 0){
+            break;
+        }
+
+        Process *p = job_list_find_process(list, pid);
+        if(!p){
+            continue;  // Не процесс задачи - просто собран
+        }
+        job_apply_status(p->job, p, status, &usage);
+        job_refresh_state(p->job);
+    }
+}
+
+// signalfd событий дочерних процессов для текущего процесса
+// Дочерний процесс shell (fork) мог закрыть унаследованный дескриптор
+// (close_range в стадии pipeline) - тогда создаётся свой с той же маской
+static int job_event_fd(void){
+    static pid_t owner = 0;
+    static int fd = -1;
+
+    if(getpid() == g_shell_pid){
+        return g_child_event_fd;
+    }
+    if(owner != getpid()){
+        sigset_t event_mask;
+        sigemptyset(&event_mask);
+        sigaddset(&event_mask, SIGCHLD);
+        sigaddset(&event_mask, SIGINT);
+        owner = getpid();
+        fd = signalfd(-1, &event_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    }
+    return fd;
+}
+
+// Ожидание события дочерних процессов не дольше timeout_ms (-1 - без ограничения)
+// На время ожидания SIGINT блокируется и тоже читается из signalfd,
+// так что Ctrl+C прерывает ожидание, хотя shell его игнорирует
+// Возвращает JOB_WAIT_EVENT, JOB_WAIT_TIMEOUT или JOB_WAIT_INTERRUPTED
+int job_wait_event(int timeout_ms){
+    int event_fd = job_event_fd();
+    if(event_fd < 0){
+        // Без signalfd - опрос с коротким интервалом
+        usleep(10000);
+        return JOB_WAIT_EVENT;
+    }
+
+    sigset_t wait_mask, old_mask;
+    sigemptyset(&wait_mask);
+    sigaddset(&wait_mask, SIGINT);
+    sigaddset(&wait_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &wait_mask, &old_mask);
+
+    // В дочернем процессе shell (builtin в pipeline) SIGCHLD разблокирован
+    // spawn_child_setup: блокируем его насовсем, а событие, которое могло
+    // потеряться до блокировки, покрывает повторная проверка у вызывающего
+    if(!sigismember(&old_mask, SIGCHLD)){
+        sigaddset(&old_mask, SIGCHLD);
+        sigprocmask(SIG_SETMASK, &old_mask, NULL);
+        return JOB_WAIT_EVENT;
+    }
+
+    // Вместе с событиями процессов вычитываем перехваченный вывод задач,
+    // иначе задача с полным pipe не завершится и ожидание не кончится
+    int result = JOB_WAIT_TIMEOUT;
+    struct pollfd pfd[1 + JOB_POLL_MAX];
+    pfd[0].fd = event_fd;
+    pfd[0].events = POLLIN;
+    pfd[0].revents = 0;
+    size_t nfds = 1 + job_pollfds(&g_job_list, pfd + 1, JOB_POLL_MAX);
+    int ready;
+    while((ready = poll(pfd, nfds, timeout_ms)) < 0 && errno == EINTR){}
+
+    if(ready > 0 && nfds > 1){
+        job_poll_dispatch(&g_job_list);
+        result = JOB_WAIT_EVENT;
+    }
+    if(ready > 0 && pfd[0].revents){
+        result = JOB_WAIT_EVENT;
+        struct signalfd_siginfo info;
+        while(read(event_fd, &info, sizeof(info)) == sizeof(info)){
+            if(info.ssi_signo == SIGINT){
+                result = JOB_WAIT_INTERRUPTED;
+            }
+        }
+    }
+
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+    return result;
+}
+
+// Ожидание процесса переднего плана (who - PID или -PGID, как в wait4)
+// Вместо блокирующего wait4 - poll по signalfd SIGCHLD, таймерам срока
+// команды (timeout, deadline с внешними сроками) и дескрипторам фоновых задач,
+// так что во время команды работают bgcapture и jobctl ttl
+// Возвращает PID, 0 - сработал таймер срока (сигнал определяет вызывающий
+// через deadline_expire), -1 - ошибка wait4
+pid_t job_wait_foreground(pid_t who, int *status, struct rusage *usage, Deadline *deadline){
+    // В дочернем процессе shell SIGCHLD разблокирован spawn_child_setup:
+    // блокируем насовсем, иначе signalfd не получит событие
+    sigset_t chld_mask;
+    sigemptyset(&chld_mask);
+    sigaddset(&chld_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld_mask, NULL);
+
+    int event_fd = job_event_fd();
+    struct pollfd pfd[1 + JOB_POLL_MAX];
+    for(;;){
+        pid_t pid = wait4(who, status, WUNTRACED | WNOHANG, usage);
+        if(pid != 0){
+            if(pid < 0 && errno == EINTR){
                 continue;
             }
+            return pid;
+        }
 
-            int status;
-            // WNOHANG - не блокируемся если процесс ещё работает
-            // WUNTRACED - получаем информацию об остановленных (Ctrl+Z)
-            // WCONTINUED - получаем информацию о продолженных (SIGCONT)
-            pid_t result = waitpid(p->pid, &status, WNOHANG | WUNTRACED | WCONTINUED);
+        // Без signalfd - обычное блокирующее ожидание (срок не соблюдается)
+        if(event_fd < 0){
+            while((pid = wait4(who, status, WUNTRACED, usage)) < 0 && errno == EINTR){}
+            return pid;
+        }
 
-            if(result == 0){
-                continue;  // Процесс ещё работает
+        // Событие, пришедшее между wait4 и poll, остаётся в signalfd
+        size_t nfds = 0;
+        pfd[nfds].fd = event_fd;
+        pfd[nfds].events = POLLIN;
+        pfd[nfds++].revents = 0;
+        size_t first_timer = nfds;
+        for(Deadline *d = deadline; d && nfds < 1 + JOB_POLL_MAX; d = d->outer){
+            if(d->fd >= 0){
+                pfd[nfds].fd = d->fd;
+                pfd[nfds].events = POLLIN;
+                pfd[nfds++].revents = 0;
             }
+        }
+        size_t first_job = nfds;
+        nfds += job_pollfds(&g_job_list, pfd + nfds, 1 + JOB_POLL_MAX - nfds);
 
-            if(result < 0){
-                if(errno == ECHILD){
-                    // Процесса больше нет - помечаем как завершённый
-                    p->state = PROC_COMPLETED;
-                }
+        if(poll(pfd, nfds, -1) < 0){
+            if(errno == EINTR){
                 continue;
             }
+            perror("poll");
+            return -1;
+        }
 
-            // Обрабатываем различные статусы завершения
-            if(WIFEXITED(status)){
-                // Нормальное завершение через exit()
-                p->state = PROC_COMPLETED;
-                p->exit_status = WEXITSTATUS(status);
+        if(pfd[0].revents){
+            struct signalfd_siginfo info;
+            while(read(event_fd, &info, sizeof(info)) == sizeof(info)){}
+        }
+        if(first_job < nfds){
+            job_poll_dispatch(&g_job_list);
+        }
+        for(size_t i = first_timer; i < first_job; i++){
+            if(pfd[i].revents){
+                return 0;
             }
-            else if(WIFSIGNALED(status)){
-                // Завершение по сигналу (например, SIGKILL)
-                p->state = PROC_COMPLETED;
-                p->exit_status = 128 + WTERMSIG(status);  // Стандартное соглашение
+        }
+    }
+}
+
+// Статус задачи для wait: код последней стадии pipeline
+// (процессы добавляются в начало списка) или статус остановки
+// При set -o pipefail - код самой правой стадии с ненулевым кодом
+// Задача, снятая по сроку (jobctl ttl), завершается с кодом 124
+int job_exit_status(Job *job){
+    if(!job || !job->processes){
+        return 0;
+    }
+    if(job->ttl && job->ttl->expired && job->state == JOB_COMPLETED){
+        return DEADLINE_EXIT_CODE;
+    }
+    if(job->state == JOB_STOPPED){
+        for(Process *p = job->processes; p; p = p->next){
+            if(p->state == PROC_STOPPED){
+                return p->exit_status;
             }
-            else if(WIFSTOPPED(status)){
-                // Остановлен (Ctrl+Z)
-                p->state = PROC_STOPPED;
+        }
+    }
+    if(shell_option_get(OPT_PIPEFAIL)){
+        for(Process *p = job->processes; p; p = p->next){
+            if(p->exit_status > 0){
+                return p->exit_status;
             }
-            else if(WIFCONTINUED(status)){
-                // Продолжен после остановки (SIGCONT)
-                p->state = PROC_RUNNING;
+        }
+    }
+    return job->processes->exit_status;
+}
+
+// Статус процесса задачи, уже удалённой из списка (например, wait $! после
+// уведомления о завершении). Возвращает -1 если PID неизвестен
+int job_finished_status(pid_t pid){
+    Job *j;
+    for(size_t i = 0; (j = job_history_get(i)) != NULL; i++){
+        for(Process *p = j->processes; p; p = p->next){
+            if(p->pid == pid){
+                return p->exit_status;
             }
         }
+    }
+    return -1;
+}
 
-        // Обновляем состояние задачи на основе состояний процессов
-        if(job_is_completed(j)){
-            j->state = JOB_COMPLETED;
+// Занятый слот очереди: работающий элемент
+typedef struct {
+    pid_t pid;
+    size_t number;      // Порядковый номер элемента (с 1)
+    char *item;
+} JobQueueSlot;
+
+// Отчёт о завершении элемента очереди (stderr, stdout остаётся элементам)
+static void job_queue_report(size_t number, int status, const char *item){
+    fprintf(stderr, "jobq: #%zu exit %d\t%s\n", number, status, item);
+}
+
+// Выполнение очереди: не больше queue->limit элементов одновременно,
+// следующий запускается сразу после завершения любого работающего
+// Ожидание - по событиям signalfd (job_wait_event), без опроса; проверяются
+// только PID слотов, поэтому чужие потомки не собираются
+// Ctrl+C завершает работающие элементы (SIGTERM группе) и прекращает запуск
+// Возвращает 0, число неудачных элементов (не больше 101) или 130 при прерывании
+int job_queue_run(JobQueue *queue){
+    size_t limit = queue->limit ? queue->limit : 1;
+    JobQueueSlot *slots = malloc(limit * sizeof(JobQueueSlot));
+    if(!slots){
+        perror("jobq: malloc");
+        return 1;
+    }
+
+    size_t running = 0;
+    size_t launched = 0;
+    size_t failed = 0;
+    int exhausted = 0;
+    int halted = 0;
+    int interrupted = 0;
+
+    for(;;){
+        // Заполняем свободные слоты
+        while(!exhausted && !halted && running < limit){
+            char *item = queue->next(queue->ctx);
+            if(!item){
+                exhausted = 1;
+                break;
+            }
+            launched++;
+            int fail_status = 1;
+            pid_t pid = queue->launch(item, queue->ctx, &fail_status);
+            if(pid < 0){
+                job_queue_report(launched, fail_status, item);
+                free(item);
+                failed++;
+                halted = queue->halt_on_error;
+                continue;
+            }
+            slots[running].pid = pid;
+            slots[running].number = launched;
+            slots[running].item = item;
+            running++;
+        }
+
+        if(running == 0){
+            break;
+        }
+
+        // Сбор завершившихся элементов: слот освобождается перестановкой последнего
+        int reaped = 0;
+        for(size_t k = 0; k < running;){
+            int status;
+            pid_t pid = waitpid(slots[k].pid, &status, WNOHANG);
+            if(pid == 0 || (pid < 0 && errno == EINTR)){
+                k++;
+                continue;
+            }
+            int code = 1;
+            if(pid > 0){
+                code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            }
+            job_queue_report(slots[k].number, code, slots[k].item);
+            if(code != 0){
+                failed++;
+                halted |= queue->halt_on_error;
+            }
+            free(slots[k].item);
+            slots[k] = slots[--running];
+            reaped = 1;
+        }
+        if(reaped){
+            continue;
         }
-        else if(job_is_stopped(j)){
-            j->state = JOB_STOPPED;
+
+        if(job_wait_event(-1) == JOB_WAIT_INTERRUPTED && !interrupted){
+            interrupted = 1;
+            halted = 1;
+            for(size_t k = 0; k < running; k++){
+                kill(-slots[k].pid, SIGTERM);
+            }
         }
     }
+
+    // Непрочитанные элементы при остановке не запускаются
+    free(slots);
+    if(interrupted){
+        return 130;
+    }
+    return failed > 101 ? 101 : (int)failed;
+}
+
+// Дескриптор событий дочерних процессов для poll (-1 если недоступен)
+int job_control_event_fd(void){
+    return g_child_event_fd;
 }
 
 // Проверка завершены ли все процессы в задаче
@@ -438,16 +1031,36 @@ void job_print(Job *job){
         marker = '-';
     }
 
-    printf("[%d]%c %s\t%s\n", job->job_id, marker, job_state_to_string(job->state), job->command_line);
+    const char *state = job_state_to_string(job->state);
+    if(job->state == JOB_COMPLETED && job->ttl && job->ttl->expired){
+        state = "Timed out";
+    }
+    printf("[%d]%c %s\t%s\n", job->job_id, marker, state, job->command_line);
+}
+
+// Есть ли завершённые задачи, о которых ещё не сообщили
+int job_has_pending_notifications(JobList *list){
+    if(!list){
+        return 0;
+    }
+    for(Job *j = list->head; j; j = j->next){
+        if(j->state == JOB_COMPLETED && !j->notified){
+            return 1;
+        }
+    }
+    return 0;
 }
 
 // Уведомление о завершённых задачах и их удаление из списка
-// Вызывается в начале каждого REPL цикла
+// Вызывается в начале каждого REPL цикла и из редактора строки,
+// когда задача завершилась во время ожидания ввода
 void job_notify_completed(JobList *list){
     if(!list){
         return;
     }
     
+    job_output_drain(list);
+    
     Job *j = list->head;
     while(j){
         Job *next = j->next;
@@ -457,6 +1070,11 @@ void job_notify_completed(JobList *list){
             job_print(j);
             j->notified = 1;
             
+            // Отчёт time для задачи, завершившейся в фоне
+            if(j->timing){
+                time_report_print(j->timing);
+            }
+            
             // Удаляем завершённый job из списка
             job_list_remove(list, j);
         }
@@ -476,12 +1094,66 @@ int job_kill(Job *job, int signal){
     return kill(-job->pgid, signal);
 }
 
+// Ожидание задачи на переднем плане с передачей её вывода из pipe в терминал
+// Задача пишет в pipe, а не в терминал, поэтому блокирующий wait4 не подходит:
+// pipe заполнится и задача встанет. poll по pipe и signalfd SIGCHLD
+static void job_foreground_forward(Job *job){
+    while(!job_is_completed(job) && !job_is_stopped(job)){
+        struct pollfd fds[2];
+        nfds_t n = 0;
+        if(job->output_fd >= 0){
+            fds[n].fd = job->output_fd;
+            fds[n].events = POLLIN;
+            n++;
+        }
+        if(g_child_event_fd >= 0){
+            fds[n].fd = g_child_event_fd;
+            fds[n].events = POLLIN;
+            n++;
+        }
+        // Pipe закрыт (или нет signalfd) - дальше обычное блокирующее ожидание
+        if(job->output_fd < 0 || g_child_event_fd < 0){
+            return;
+        }
+        if(poll(fds, n, -1) < 0 && errno != EINTR){
+            return;
+        }
+
+        char buf[8192];
+        ssize_t got;
+        while(job->output_fd >= 0 && (got = read(job->output_fd, buf, sizeof(buf))) != 0){
+            if(got < 0){
+                if(errno == EINTR){
+                    continue;
+                }
+                break;
+            }
+            ssize_t off = 0;
+            while(off < got){
+                ssize_t w = write(STDOUT_FILENO, buf + off, (size_t)(got - off));
+                if(w < 0 && errno != EINTR){
+                    break;
+                }
+                off += w > 0 ? w : 0;
+            }
+        }
+        if(job->output_fd >= 0 && got == 0){
+            close(job->output_fd);
+            job->output_fd = -1;
+        }
+
+        struct signalfd_siginfo info;
+        while(read(g_child_event_fd, &info, sizeof(info)) == sizeof(info)){}
+        job_update(job);
+    }
+}
+
 // Перевод задачи на передний план (команда fg)
 // cont - нужно ли отправить SIGCONT (если задача была остановлена)
 // 1. Переводим задачу в состояние JOB_FOREGROUND
 // 2. Передаём терминал задаче через tcsetpgrp
 // 3. Если нужно - отправляем SIGCONT для продолжения выполнения
-// 4. Ждём завершения или остановки задачи через waitpid
+// 4. Ждём завершения или остановки задачи (job_wait_foreground)
 // 5. Возвращаем терминал shell
 int job_foreground(Job *job, int cont){
     if(!job){
@@ -490,6 +1162,7 @@ int job_foreground(Job *job, int cont){
 
     job->state = JOB_FOREGROUND;
     job->notified = 0;
+    time_report_phase(job->timing, TIME_PHASE_FOREGROUND);
 
     // Передаём управление терминалом задаче
     if(g_is_interactive){
@@ -507,36 +1180,52 @@ int job_foreground(Job *job, int cont){
         }
     }
 
+    // Перехваченный вывод: показываем накопленное и дальше передаём в терминал
+    if(job->output){
+        fflush(stdout);
+        job_output_read(job);
+        output_ring_dump(job->output, STDOUT_FILENO);
+        output_ring_clear(job->output);
+        if(job->output_fd >= 0){
+            job_foreground_forward(job);
+        }
+    }
+
     int status;
+    struct rusage usage;
     pid_t pid;
     // Ждём пока задача не завершится или не остановится
+    // Вместо блокирующего wait4 - poll по signalfd SIGCHLD, таймерам ttl и
+    // pipe вывода задач (job_wait_foreground): срок jobctl ttl соблюдается и
+    // на переднем плане - job_poll_dispatch посылает сигнал группе задачи, и
+    // fg возвращает 124, как wait; вывод других задач с bgcapture вычитывается
     while(!job_is_completed(job) && !job_is_stopped(job)){
         // Ждём любой процесс из process group задачи
-        pid = waitpid(-job->pgid, &status, WUNTRACED);
+        pid = job_wait_foreground(-job->pgid, &status, &usage, NULL);
         if(pid > 0){
             // Обновляем статус конкретного процесса
-            for(Process *p = job->processes; p; p = p->next){
-                if(p->pid == pid){
-                    if(WIFSTOPPED(status)){
-                        // Процесс остановлен (Ctrl+Z)
-                        p->state = PROC_STOPPED;
-                        job->state = JOB_STOPPED;
-                    } else if(WIFEXITED(status) || WIFSIGNALED(status)){
-                        // Процесс завершён
-                        p->state = PROC_COMPLETED;
-                        p->exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
-                    }
-                    break;
+            Process *p = job_list_find_process(&g_job_list, pid);
+            if(p && p->job == job){
+                job_apply_status(job, p, status, &usage);
+                if(p->state == PROC_STOPPED){
+                    // Процесс остановлен (Ctrl+Z)
+                    job->state = JOB_STOPPED;
                 }
             }
-        } else if(pid < 0 && errno == ECHILD){
-            break;  // Нет больше дочерних процессов
+        } else if(pid < 0){
+            break;  // Нет больше дочерних процессов (или ошибка poll)
         }
     }
     
     // Обновляем состояние job если все процессы завершились
     if(job_is_completed(job)){
         job->state = JOB_COMPLETED;
+        // Отчёт time: задача завершилась на переднем плане
+        if(job->timing){
+            time_report_print(job->timing);
+            time_report_free(job->timing);
+            job->timing = NULL;
+        }
     }
 
     // Возвращаем терминал shell и восстанавливаем настройки терминала
@@ -563,6 +1252,7 @@ int job_background(Job *job, int cont){
 
     job->state = JOB_BACKGROUND;
     job->notified = 0;
+    time_report_phase(job->timing, TIME_PHASE_BACKGROUND);
 
     if(cont){
         // Отправляем SIGCONT для продолжения выполнения
@@ -584,21 +1274,24 @@ int job_control_is_interactive(void){
 
 // Настройка обработчиков сигналов для shell
 // Shell игнорирует большинство сигналов, чтобы не прерываться
-// SIGCHLD обрабатывается для отслеживания завершения дочерних процессов
+// SIGCHLD блокируется и доставляется через signalfd (см. job_reap_children).
+// Действие остаётся SIG_DFL: при SIG_IGN ядро собирало бы потомков само
 void job_control_setup_signals(void){
-    signal(SIGCHLD, job_handle_sigchld);  // Обработчик завершения дочерних процессов
+    sigset_t chld_mask;
+    sigemptyset(&chld_mask);
+    sigaddset(&chld_mask, SIGCHLD);
+    if(sigprocmask(SIG_BLOCK, &chld_mask, NULL) < 0){
+        perror("sigprocmask");
+    }
+    sigset_t event_mask = chld_mask;
+    sigaddset(&event_mask, SIGINT);
+    g_child_event_fd = signalfd(-1, &event_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if(g_child_event_fd < 0){
+        perror("signalfd");
+    }
+
     signal(SIGINT, SIG_IGN);   // Игнорируем Ctrl+C (передаём дочернему процессу)
     signal(SIGTSTP, SIG_IGN);  // Игнорируем Ctrl+Z (передаём дочернему процессу)
     signal(SIGTTOU, SIG_IGN);  // Игнорируем сигнал при попытке записи в терминал из фона
     signal(SIGTTIN, SIG_IGN);  // Игнорируем сигнал при попытке чтения из терминала из фона
 }
-
-// Обработчик сигнала SIGCHLD
-// Вызывается когда дочерний процесс завершается или меняет состояние
-// Сохраняем errno чтобы не влиять на прерванные системные вызовы
-void job_handle_sigchld(int sig) {
-    (void)sig;
-    int saved_errno = errno;  // Сохраняем errno (может быть испорчен waitpid)
-    job_update_all(&g_job_list);  // Обновляем статусы всех задач
-    errno = saved_errno;  // Восстанавливаем errno
-}
\ No newline at end of file
@@ -0,0 +1,126 @@
+// JobIndex.c
+// Хеш-индекс целочисленный ключ -> указатель для списка задач
+// (PID -> Process, PGID -> Job, номер -> Job)
+// Цепочки в бакетах, число бакетов - степень двойки, рост при заполнении 0.75
+// Ключи могут повторяться (PID переиспользуется ядром, пока завершённая
+// задача ждёт уведомления): новая запись ставится в начало цепочки,
+// поэтому поиск возвращает самую свежую
+
+#include "JobIndex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Мультипликативный хеш Фибоначчи: соседние PID расходятся по бакетам
+static size_t hash_key(long key, size_t bucket_count){
+    unsigned long long h = (unsigned long long)key * 11400714819323198485ULL;
+    return (size_t)(h >> 32) & (bucket_count - 1);
+}
+
+void job_index_init(JobIndex *index){
+    index->buckets = NULL;
+    index->bucket_count = 0;
+    index->count = 0;
+}
+
+// Увеличение числа бакетов в 2 раза
+static int job_index_grow(JobIndex *index){
+    size_t new_count = index->bucket_count ? index->bucket_count * 2 : JOB_INDEX_INITIAL_BUCKETS;
+    JobIndexEntry **new_buckets = calloc(new_count, sizeof(JobIndexEntry *));
+    if(!new_buckets){
+        perror("job_index_grow: calloc failed");
+        return -1;
+    }
+
+    // Записи с одинаковым ключом должны сохранить порядок (свежая первой):
+    // цепочка переворачивается, затем записи по одной ставятся в начало новых
+    for(size_t i = 0; i < index->bucket_count; i++){
+        JobIndexEntry *e = index->buckets[i];
+        JobIndexEntry *reversed = NULL;
+        while(e){
+            JobIndexEntry *next = e->next;
+            e->next = reversed;
+            reversed = e;
+            e = next;
+        }
+        while(reversed){
+            JobIndexEntry *next = reversed->next;
+            size_t idx = hash_key(reversed->key, new_count);
+            reversed->next = new_buckets[idx];
+            new_buckets[idx] = reversed;
+            reversed = next;
+        }
+    }
+
+    free(index->buckets);
+    index->buckets = new_buckets;
+    index->bucket_count = new_count;
+    return 0;
+}
+
+// Добавление записи key -> value в начало цепочки
+int job_index_insert(JobIndex *index, long key, void *value){
+    if(index->count + 1 > index->bucket_count * 3 / 4){
+        if(job_index_grow(index) < 0){
+            return -1;
+        }
+    }
+
+    JobIndexEntry *e = malloc(sizeof(JobIndexEntry));
+    if(!e){
+        perror("job_index_insert: malloc failed");
+        return -1;
+    }
+    size_t idx = hash_key(key, index->bucket_count);
+    e->key = key;
+    e->value = value;
+    e->next = index->buckets[idx];
+    index->buckets[idx] = e;
+    index->count++;
+    return 0;
+}
+
+// Самая свежая запись с ключом key или NULL
+void *job_index_find(const JobIndex *index, long key){
+    if(!index->bucket_count){
+        return NULL;
+    }
+    for(JobIndexEntry *e = index->buckets[hash_key(key, index->bucket_count)]; e; e = e->next){
+        if(e->key == key){
+            return e->value;
+        }
+    }
+    return NULL;
+}
+
+// Удаление конкретной записи key -> value
+void job_index_remove(JobIndex *index, long key, const void *value){
+    if(!index->bucket_count){
+        return;
+    }
+    JobIndexEntry **slot = &index->buckets[hash_key(key, index->bucket_count)];
+    while(*slot){
+        JobIndexEntry *e = *slot;
+        if(e->key == key && e->value == value){
+            *slot = e->next;
+            free(e);
+            index->count--;
+            return;
+        }
+        slot = &e->next;
+    }
+}
+
+// Освобождение всех записей (сами значения не освобождаются)
+void job_index_free(JobIndex *index){
+    for(size_t i = 0; i < index->bucket_count; i++){
+        JobIndexEntry *e = index->buckets[i];
+        while(e){
+            JobIndexEntry *next = e->next;
+            free(e);
+            e = next;
+        }
+    }
+    free(index->buckets);
+    job_index_init(index);
+}
@@ -0,0 +1,255 @@
+// JobSched.c
+// Параметры планирования задач для jobctl: привязка к CPU (sched_setaffinity),
+// nice (setpriority) и приоритет ввода-вывода (ioprio_set)
+// Для работающей задачи параметры применяются ко всей группе процессов:
+// nice и ioprio ядро меняет сразу для группы (PRIO_PGRP, IOPRIO_WHO_PGRP),
+// привязка к CPU задаётся каждому потоку каждого процесса группы по /proc
+// Для запускаемой команды параметры применяет сам дочерний процесс до exec,
+// поэтому taskset/nice/ionice и лишний exec на задачу не нужны
+
+#include "JobSched.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+// Константы ioprio_set (linux/ioprio.h есть не во всех заголовках)
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_CLASS_NONE 0
+#define IOPRIO_CLASS_RT 1
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_LEVEL_MAX 7
+#define IOPRIO_LEVEL_DEFAULT 4
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_WHO_PGRP 2
+
+#define IOPRIO_VALUE(cls, level) (((cls) << IOPRIO_CLASS_SHIFT) | (level))
+
+void job_sched_init(JobSched *sched){
+    memset(sched, 0, sizeof(*sched));
+}
+
+// Разбор списка CPU в формате taskset -c: 0-7,12,14-15
+// Возвращает 0 при успехе, -1 при ошибке формата или пустом списке
+int job_sched_parse_cpus(const char *spec, cpu_set_t *set){
+    CPU_ZERO(set);
+    const char *p = spec;
+
+    while(*p){
+        char *end;
+        if(!isdigit((unsigned char)*p)){
+            return -1;
+        }
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if(*end == '-'){
+            p = end + 1;
+            if(!isdigit((unsigned char)*p)){
+                return -1;
+            }
+            last = strtol(p, &end, 10);
+        }
+        if(last < first || last >= CPU_SETSIZE){
+            return -1;
+        }
+        for(long cpu = first; cpu <= last; cpu++){
+            CPU_SET((int)cpu, set);
+        }
+
+        if(*end == ','){
+            end++;
+        } else if(*end != '\0'){
+            return -1;
+        }
+        p = end;
+    }
+
+    return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+// Разбор значения nice: -20..19
+int job_sched_parse_nice(const char *spec, int *nice){
+    char *end;
+    long value = strtol(spec, &end, 10);
+    if(end == spec || *end != '\0' || value < -20 || value > 19){
+        return -1;
+    }
+    *nice = (int)value;
+    return 0;
+}
+
+// Разбор класса ввода-вывода: idle, be[:N] (best-effort), rt[:N] (realtime), none
+// Уровень N - 0 (высший) .. 7, по умолчанию 4
+int job_sched_parse_ioprio(const char *spec, int *ioprio){
+    const char *colon = strchr(spec, ':');
+    size_t name_len = colon ? (size_t)(colon - spec) : strlen(spec);
+    int cls;
+
+    if(name_len == 4 && strncmp(spec, "idle", 4) == 0){
+        cls = IOPRIO_CLASS_IDLE;
+    } else if((name_len == 2 && strncmp(spec, "be", 2) == 0) ||
+              (name_len == 11 && strncmp(spec, "best-effort", 11) == 0)){
+        cls = IOPRIO_CLASS_BE;
+    } else if((name_len == 2 && strncmp(spec, "rt", 2) == 0) ||
+              (name_len == 8 && strncmp(spec, "realtime", 8) == 0)){
+        cls = IOPRIO_CLASS_RT;
+    } else if(name_len == 4 && strncmp(spec, "none", 4) == 0){
+        cls = IOPRIO_CLASS_NONE;
+    } else {
+        return -1;
+    }
+
+    long level = IOPRIO_LEVEL_DEFAULT;
+    if(colon){
+        // У idle и none уровня нет
+        if(cls == IOPRIO_CLASS_IDLE || cls == IOPRIO_CLASS_NONE){
+            return -1;
+        }
+        char *end;
+        level = strtol(colon + 1, &end, 10);
+        if(end == colon + 1 || *end != '\0' || level < 0 || level > IOPRIO_LEVEL_MAX){
+            return -1;
+        }
+    }
+    if(cls == IOPRIO_CLASS_IDLE || cls == IOPRIO_CLASS_NONE){
+        level = 0;
+    }
+
+    *ioprio = IOPRIO_VALUE(cls, (int)level);
+    return 0;
+}
+
+static int ioprio_set(int which, int who, int ioprio){
+    return (int)syscall(SYS_ioprio_set, which, who, ioprio);
+}
+
+// Применение параметров к текущему процессу
+// Вызывается в дочернем процессе после fork, до exec
+// Возвращает 0 при успехе, -1 если что-то не удалось (сообщение выведено)
+int job_sched_apply_self(const JobSched *sched){
+    int rc = 0;
+
+    if(sched->set_affinity && sched_setaffinity(0, sizeof(cpu_set_t), &sched->affinity) < 0){
+        perror("sched_setaffinity");
+        rc = -1;
+    }
+    if(sched->set_nice && setpriority(PRIO_PROCESS, 0, sched->nice) < 0){
+        perror("setpriority");
+        rc = -1;
+    }
+    if(sched->set_ioprio && ioprio_set(IOPRIO_WHO_PROCESS, 0, sched->ioprio) < 0){
+        perror("ioprio_set");
+        rc = -1;
+    }
+    return rc;
+}
+
+// Группа процессов по /proc/PID/stat (поле после state и ppid)
+// Возвращает -1 если процесс уже завершился
+static pid_t proc_pgrp(const char *pid_dir){
+    char path[64];
+    char buf[512];
+    snprintf(path, sizeof(path), "/proc/%s/stat", pid_dir);
+    FILE *f = fopen(path, "r");
+    if(!f){
+        return -1;
+    }
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+
+    // Имя команды в скобках может содержать пробелы - поля считаются после ')'
+    char *rparen = strrchr(buf, ')');
+    int pgrp;
+    if(!rparen || sscanf(rparen + 1, " %*c %*d %d", &pgrp) != 1){
+        return -1;
+    }
+    return (pid_t)pgrp;
+}
+
+// Привязка к CPU всех потоков процесса (/proc/PID/task/TID)
+// Потоки, завершившиеся во время обхода, пропускаются
+static int affinity_set_threads(const char *pid_dir, const cpu_set_t *set){
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%s/task", pid_dir);
+    DIR *dir = opendir(path);
+    if(!dir){
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    int rc = 0;
+    struct dirent *ent;
+    while((ent = readdir(dir)) != NULL){
+        if(!isdigit((unsigned char)ent->d_name[0])){
+            continue;
+        }
+        pid_t tid = (pid_t)atoi(ent->d_name);
+        if(sched_setaffinity(tid, sizeof(cpu_set_t), set) < 0 && errno != ESRCH){
+            rc = -1;
+            break;
+        }
+    }
+    closedir(dir);
+    return rc;
+}
+
+// Привязка к CPU всех процессов группы
+// Возвращает число процессов группы или -1 при ошибке (errno установлен)
+static int affinity_set_group(pid_t pgid, const cpu_set_t *set){
+    DIR *proc = opendir("/proc");
+    if(!proc){
+        return -1;
+    }
+
+    int count = 0;
+    int rc = 0;
+    struct dirent *ent;
+    while((ent = readdir(proc)) != NULL){
+        if(!isdigit((unsigned char)ent->d_name[0]) || proc_pgrp(ent->d_name) != pgid){
+            continue;
+        }
+        if(affinity_set_threads(ent->d_name, set) < 0){
+            rc = -1;
+            break;
+        }
+        count++;
+    }
+
+    int saved_errno = errno;
+    closedir(proc);
+    errno = saved_errno;
+    return rc < 0 ? -1 : count;
+}
+
+// Применение параметров ко всем процессам группы pgid
+// Возвращает 0 при успехе, -1 если что-то не удалось (сообщение выведено)
+int job_sched_apply_group(pid_t pgid, const JobSched *sched){
+    int rc = 0;
+
+    if(sched->set_affinity){
+        int count = affinity_set_group(pgid, &sched->affinity);
+        if(count == 0){
+            errno = ESRCH;
+        }
+        if(count <= 0){
+            perror("sched_setaffinity");
+            rc = -1;
+        }
+    }
+    if(sched->set_nice && setpriority(PRIO_PGRP, (id_t)pgid, sched->nice) < 0){
+        perror("setpriority");
+        rc = -1;
+    }
+    if(sched->set_ioprio && ioprio_set(IOPRIO_WHO_PGRP, (int)pgid, sched->ioprio) < 0){
+        perror("ioprio_set");
+        rc = -1;
+    }
+    return rc;
+}
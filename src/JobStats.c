@@ -0,0 +1,210 @@
+// JobStats.c
+// Учёт ресурсов задач для jobs -l и jobs --stats
+// Для собранных процессов используется rusage из wait4 (Process.usage),
+// для ещё работающих и остановленных - текущие значения из /proc/PID:
+// stat (время CPU, page faults) и status (пиковый RSS, переключения контекста)
+// Завершённые задачи после уведомления остаются доступны через кольцо истории
+
+#include "JobStats.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+// Снимок ресурсов процесса в единицах struct rusage
+// Возвращает 0 при успехе, -1 если данные недоступны
+static int process_sample(const Process *p, struct rusage *out){
+    if(p->state == PROC_COMPLETED){
+        *out = p->usage;
+        return 0;
+    }
+
+    memset(out, 0, sizeof(*out));
+
+    char path[64];
+    char buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)p->pid);
+    FILE *f = fopen(path, "r");
+    if(!f){
+        return -1;
+    }
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+
+    // Имя команды в скобках может содержать пробелы - поля считаются после ')'
+    char *rparen = strrchr(buf, ')');
+    unsigned long minflt, majflt, utime, stime;
+    if(!rparen || sscanf(rparen + 1, " %*c %*d %*d %*d %*d %*d %*u %lu %*u %lu %*u %lu %lu",
+                         &minflt, &majflt, &utime, &stime) != 4){
+        return -1;
+    }
+
+    long ticks = sysconf(_SC_CLK_TCK);
+    if(ticks <= 0){
+        ticks = 100;
+    }
+    out->ru_minflt = (long)minflt;
+    out->ru_majflt = (long)majflt;
+    out->ru_utime.tv_sec = (time_t)(utime / (unsigned long)ticks);
+    out->ru_utime.tv_usec = (suseconds_t)(utime % (unsigned long)ticks * 1000000UL / (unsigned long)ticks);
+    out->ru_stime.tv_sec = (time_t)(stime / (unsigned long)ticks);
+    out->ru_stime.tv_usec = (suseconds_t)(stime % (unsigned long)ticks * 1000000UL / (unsigned long)ticks);
+
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)p->pid);
+    f = fopen(path, "r");
+    if(!f){
+        return 0;
+    }
+    char line[256];
+    while(fgets(line, sizeof(line), f)){
+        long value;
+        if(sscanf(line, "VmHWM: %ld", &value) == 1){
+            out->ru_maxrss = value;
+        } else if(sscanf(line, "voluntary_ctxt_switches: %ld", &value) == 1){
+            out->ru_nvcsw = value;
+        } else if(sscanf(line, "nonvoluntary_ctxt_switches: %ld", &value) == 1){
+            out->ru_nivcsw = value;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+// Время работы процесса: до сбора или до текущего момента
+static double process_elapsed(const Process *p){
+    struct timespec end = p->end;
+    if(p->state != PROC_COMPLETED){
+        clock_gettime(CLOCK_REALTIME, &end);
+    }
+    return (double)(end.tv_sec - p->start.tv_sec) + (double)(end.tv_nsec - p->start.tv_nsec) / 1e9;
+}
+
+static double timeval_seconds(const struct timeval *tv){
+    return (double)tv->tv_sec + (double)tv->tv_usec / 1e6;
+}
+
+// Состояние процесса для вывода: Running, Stopped, Done, Exit N, Signal N
+static const char *process_state_string(const Process *p, char *buf, size_t size){
+    switch(p->state){
+        case PROC_RUNNING: return "Running";
+        case PROC_STOPPED: return "Stopped";
+        case PROC_COMPLETED: break;
+    }
+    if(p->exit_status == 0){
+        return "Done";
+    }
+    if(p->exit_status > 128){
+        snprintf(buf, size, "Signal %d", p->exit_status - 128);
+    } else {
+        snprintf(buf, size, "Exit %d", p->exit_status);
+    }
+    return buf;
+}
+
+// Маркер текущей (+) и предыдущей (-) задачи
+static char job_marker(JobList *list, Job *job){
+    if(list->tail == job){
+        return '+';
+    }
+    if(list->tail && list->tail->prev == job){
+        return '-';
+    }
+    return ' ';
+}
+
+// Процессы хранятся в обратном порядке запуска - выводим по порядку стадий
+static void print_processes_long(Job *job, Process *p, int first){
+    if(!p){
+        return;
+    }
+    print_processes_long(job, p->next, 0);
+
+    char state_buf[32];
+    struct rusage ru;
+    int have = process_sample(p, &ru) == 0;
+    double cpu = have ? timeval_seconds(&ru.ru_utime) + timeval_seconds(&ru.ru_stime) : 0;
+
+    if(p->next == NULL){
+        printf("[%d]%c", job->job_id, job_marker(job_list_get(), job));
+    } else {
+        printf("    ");
+    }
+    printf(" %7d %-10s %8.3fs", (int)p->pid, process_state_string(p, state_buf, sizeof(state_buf)), process_elapsed(p));
+    if(have){
+        printf("  cpu %7.3fs  rss %6ldK", cpu, ru.ru_maxrss);
+    } else {
+        printf("  cpu %8s  rss %7s", "-", "-");
+    }
+    printf("  %s\n", first ? job->command_line : "|");
+}
+
+// jobs -l: задачи с PID каждого процесса, временем работы, CPU и пиковым RSS
+void job_stats_print_long(JobList *list){
+    if(!list){
+        return;
+    }
+    for(Job *j = list->head; j; j = j->next){
+        if(j->state == JOB_COMPLETED){
+            continue;
+        }
+        print_processes_long(j, j->processes, 1);
+    }
+}
+
+static void print_stats_row(Job *job, Process *p, int archived){
+    char state_buf[32];
+    struct rusage ru;
+    int have = process_sample(p, &ru) == 0;
+
+    char id[16];
+    snprintf(id, sizeof(id), archived ? "(%d)" : "[%d]", job->job_id);
+
+    char start[16];
+    struct tm tm;
+    time_t sec = p->start.tv_sec;
+    localtime_r(&sec, &tm);
+    strftime(start, sizeof(start), "%H:%M:%S", &tm);
+
+    printf("%-5s %7d %-9s %s %8.3f", id, (int)p->pid, process_state_string(p, state_buf, sizeof(state_buf)),
+           start, process_elapsed(p));
+    if(have){
+        printf(" %8.3f %8.3f %8ld %8ld %6ld %7ld %7ld",
+               timeval_seconds(&ru.ru_utime), timeval_seconds(&ru.ru_stime), ru.ru_maxrss,
+               ru.ru_minflt, ru.ru_majflt, ru.ru_nvcsw, ru.ru_nivcsw);
+    } else {
+        printf(" %8s %8s %8s %8s %6s %7s %7s", "-", "-", "-", "-", "-", "-", "-");
+    }
+    printf("  %s\n", job->command_line);
+}
+
+static void print_job_stats(Job *job, Process *p, int archived){
+    if(!p){
+        return;
+    }
+    print_job_stats(job, p->next, archived);
+    print_stats_row(job, p, archived);
+}
+
+// jobs --stats: таблица ресурсов по каждому процессу
+// Сначала задачи из списка, затем завершённые из истории (номер в скобках),
+// от старых к новым. Время в секундах, MAXRSS в KB
+void job_stats_print_table(JobList *list){
+    if(!list){
+        return;
+    }
+    printf("%-5s %7s %-9s %-8s %8s %8s %8s %8s %8s %6s %7s %7s  %s\n",
+           "JOB", "PID", "STATE", "START", "REAL", "USER", "SYS", "MAXRSS",
+           "MINFLT", "MAJFLT", "VCSW", "IVCSW", "COMMAND");
+
+    for(size_t i = JOB_HISTORY_SIZE; i-- > 0;){
+        Job *j = job_history_get(i);
+        if(j){
+            print_job_stats(j, j->processes, 1);
+        }
+    }
+    for(Job *j = list->head; j; j = j->next){
+        print_job_stats(j, j->processes, 0);
+    }
+}
@@ -1,14 +1,54 @@
 // Lexer.c
 
 #include "Lexer.h"
-#include "Utils.h"
+#include "CommandSubst.h"
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 
+// SSE2 есть на любом x86-64; -DLEXER_SCALAR_SCAN оставляет только табличный
+// поиск (для сравнения в bench/lexbench.c)
+#if defined(__SSE2__) && !defined(LEXER_SCALAR_SCAN)
+#define LEXER_SIMD_SCAN 1
+#include <emmintrin.h>
+#endif
+
 #define DEFAULT_BUF_SIZE 32
 #define DEFAULT_ARR_SIZE 16
 
+// Классы символов (битовые флаги в g_char_class)
+#define CC_BLANK     0x01   // Пробел и табуляция между токенами
+#define CC_WORD_END  0x02   // Конец слова вне кавычек
+#define CC_QUOTE     0x04   // ' и "
+#define CC_ESCAPE    0x08   // Обратная косая черта
+#define CC_SUBST     0x10   // $ и ` - возможное начало подстановки команды
+#define CC_LINE_END  0x20   // Конец комментария
+
+// Символы, на которых останавливается сканирование слова
+#define CC_WORD_STOP (CC_WORD_END | CC_QUOTE | CC_ESCAPE | CC_SUBST)
+
+static const unsigned char g_char_class[256] = {
+    ['\0'] = CC_WORD_END | CC_LINE_END,
+    [' ']  = CC_BLANK | CC_WORD_END,
+    ['\t'] = CC_BLANK | CC_WORD_END,
+    ['\n'] = CC_WORD_END | CC_LINE_END,
+    ['\r'] = CC_WORD_END | CC_LINE_END,
+    ['&']  = CC_WORD_END,
+    [';']  = CC_WORD_END,
+    ['|']  = CC_WORD_END,
+    ['<']  = CC_WORD_END,
+    ['>']  = CC_WORD_END,
+    ['(']  = CC_WORD_END,
+    [')']  = CC_WORD_END,
+    ['\''] = CC_QUOTE,
+    ['"']  = CC_QUOTE,
+    ['\\'] = CC_ESCAPE,
+    ['$']  = CC_SUBST,
+    ['`']  = CC_SUBST
+};
+
+#define CHAR_CLASS(c) (g_char_class[(unsigned char)(c)])
+
 static Token lexer_extract(Lexer *lexer);
 static Token lexer_extract_basic(Lexer *lexer);
 static Token lexer_extract_pipe(Lexer *lexer);
@@ -18,21 +58,40 @@ static Token lexer_extract_control(Lexer *lexer);
 static Token make_error_token(size_t pos, const char *message);
 static Token make_simple_token(TokenType type, size_t pos);
 static void skip_spaces_and_comments(Lexer *lexer);
-static int lexer_grow_buffer(char **buf, size_t *buf_size, size_t required);
+static int lexer_grow_buffer(Lexer *lexer, char **buf, size_t *buf_size, size_t required);
+static int lexer_read_heredoc_body(Lexer *lexer, const Token *delim, Token *heredoc);
+static int is_subst_start(const Lexer *lexer);
+static int is_word_end(char c);
+static size_t scan_word_stop(const char *input, size_t pos, size_t len);
+static int lexer_copy_subst(Lexer *lexer, char **buf, size_t *buf_size, size_t *len);
 
 
 
-static int lexer_grow_buffer(char **buf, size_t *buf_size, size_t required) {
-    if (buf_size_check(buf, buf_size, required)) {
+// Буфер слова растёт удвоением; пока слово - последнее выделение арены,
+// arena_realloc расширяет его на месте без копирования
+static int lexer_grow_buffer(Lexer *lexer, char **buf, size_t *buf_size, size_t required) {
+    if (required < *buf_size) {
         return 1;
     }
-    return 0;
+    size_t new_size = *buf_size;
+    while (new_size <= required) {
+        new_size *= 2;
+    }
+    char *tmp = arena_realloc(lexer->arena, *buf, *buf_size, new_size);
+    if (!tmp) {
+        return 0;
+    }
+    *buf = tmp;
+    *buf_size = new_size;
+    return 1;
 }
 
 
-void lexer_init(Lexer *lexer, const char *input){
+void lexer_init(Lexer *lexer, const char *input, Arena *arena){
     assert(lexer && "lexer_init: null ptr");
+    assert(arena && "lexer_init: null arena");
 
+    lexer->arena = arena;
     lexer->input = input;
     lexer->pos = 0;
     lexer->len = strlen(input);
@@ -112,26 +171,14 @@ static Token lexer_extract(Lexer *lexer){
     }
 }
 
+// Текст ошибки - статическая строка, копия не нужна
 static Token make_error_token(size_t pos, const char *message){
     Token token;
     token.type = TOKEN_ERROR;
     token.quote = QUOTE_NONE;
     token.pos = pos;
-
-    if (message) {
-        size_t len = strlen(message) + 1;
-        char *copy = malloc(len);
-        if (copy) {
-            memcpy(copy, message, len);
-            token.text = copy;
-        } else {
-            fprintf(stderr, "lexer: failed to allocate error message\n");
-            token.text = NULL;
-        }
-    } else {
-        token.text = NULL;
-    }
-
+    token.text = message;
+    token.len = message ? strlen(message) : 0;
     return token;
 }
 
@@ -141,42 +188,161 @@ static Token make_simple_token(TokenType type, size_t pos){
     token.quote = QUOTE_NONE;
     token.pos = pos;
     token.text = NULL;
+    token.len = 0;
     return token;
 }
 
 static void skip_spaces_and_comments(Lexer *lexer) {
     if (!lexer || !lexer->input) return;
 
-    char c;
+    const char *input = lexer->input;
+    size_t pos = lexer->pos;
 
-    while (lexer->pos < lexer->len) {
-        c = lexer->input[lexer->pos];
-        if (c == ' ' || c == '\t')
-            lexer->pos++;
-        else
-            break;
+    while (pos < lexer->len && (CHAR_CLASS(input[pos]) & CC_BLANK))
+        pos++;
+
+    if (pos < lexer->len && input[pos] == '#') {
+        pos++;
+        while (pos < lexer->len && !(CHAR_CLASS(input[pos]) & CC_LINE_END))
+            pos++;
     }
 
-    if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '#') {
-        lexer->pos++;
-        while (lexer->pos < lexer->len) {
-            c = lexer->input[lexer->pos];
-            if (c == '\n' || c == '\r' || c == '\0') break;
-            lexer->pos++;
+    lexer->pos = pos;
+}
+
+// Символ, на котором заканчивается слово вне кавычек
+static int is_word_end(char c){
+    return (CHAR_CLASS(c) & CC_WORD_END) != 0;
+}
+
+// Позиция первого символа класса CC_WORD_STOP в input[pos..len) (len, если нет)
+// С SSE2 проверяется по 16 байт: кандидаты - байты <= ' ' и символы
+// & ; | < > ( ) ' " \ $ `, каждый кандидат уточняется по таблице
+// (управляющие символы кроме \t \n \r слово не заканчивают)
+// Хвост короче 16 байт и сборка без SSE2 - по таблице, байт за байтом
+static size_t scan_word_stop(const char *input, size_t pos, size_t len){
+#ifdef LEXER_SIMD_SCAN
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i semi = _mm_set1_epi8(';');
+    const __m128i bar = _mm_set1_epi8('|');
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i lparen = _mm_set1_epi8('(');
+    const __m128i rparen = _mm_set1_epi8(')');
+    const __m128i squote = _mm_set1_epi8('\'');
+    const __m128i dquote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i dollar = _mm_set1_epi8('$');
+    const __m128i backtick = _mm_set1_epi8('`');
+
+    while (pos + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(input + pos));
+        // Беззнаковое v <= ' ': min(v, ' ') == v
+        __m128i hit = _mm_cmpeq_epi8(_mm_min_epu8(v, space), v);
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, amp));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, semi));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, bar));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, lt));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, gt));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, lparen));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, rparen));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, squote));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, dquote));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, backslash));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, dollar));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, backtick));
+
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        while (mask) {
+            size_t i = pos + (size_t)__builtin_ctz(mask);
+            if (CHAR_CLASS(input[i]) & CC_WORD_STOP)
+                return i;
+            mask &= mask - 1;
+        }
+        pos += 16;
+    }
+#endif
+    while (pos < len && !(CHAR_CLASS(input[pos]) & CC_WORD_STOP))
+        pos++;
+    return pos;
+}
+
+// Начало подстановки команды: $( или `
+static int is_subst_start(const Lexer *lexer){
+    char c = lexer->input[lexer->pos];
+    return c == '`' || (c == '$' && lexer->pos + 1 < lexer->len && lexer->input[lexer->pos + 1] == '(');
+}
+
+// Копирование подстановки команды в слово без изменений (вместе с $( ) или `)
+// Внутренняя команда разбирается заново при раскрытии
+// Возвращает 0 если подстановка не закрыта или нет памяти
+static int lexer_copy_subst(Lexer *lexer, char **buf, size_t *buf_size, size_t *len){
+    size_t end = command_subst_end(lexer->input, lexer->pos);
+    if(end == COMMAND_SUBST_NOT_FOUND || end >= lexer->len){
+        return 0;
+    }
+
+    size_t n = end + 1 - lexer->pos;
+    while(*buf_size <= *len + n){
+        if(!lexer_grow_buffer(lexer, buf, buf_size, *len + n)){
+            return 0;
         }
     }
+    memcpy(*buf + *len, lexer->input + lexer->pos, n);
+    *len += n;
+    lexer->pos = end + 1;
+    return 1;
 }
 
+static Token make_word_token(size_t pos, const char *text, size_t len, QuoteCount quote){
+    Token token;
+    token.type = TOKEN_WORD;
+    token.quote = quote;
+    token.pos = pos;
+    token.text = text;
+    token.len = len;
+    return token;
+}
+
+// Слово: срез входа, если в нём нет кавычек и экранирования (подстановки
+// команд $(...) и `...` копируются в слово как есть, поэтому срезу не мешают),
+// иначе декодированная копия в арене
 static Token lexer_extract_basic(Lexer *lexer){
     if (!lexer || !lexer->input) 
         return make_error_token(0, "lexer_extract_basic: null lexer");
 
     size_t start = lexer->pos;
 
-    size_t len = 0, buf_size = DEFAULT_BUF_SIZE;
-    char *buf = malloc(buf_size); 
+    while(lexer->pos < lexer->len){
+        lexer->pos = scan_word_stop(lexer->input, lexer->pos, lexer->len);
+        if(lexer->pos >= lexer->len || !(CHAR_CLASS(lexer->input[lexer->pos]) & CC_SUBST)){
+            break;
+        }
+        if(is_subst_start(lexer)){
+            size_t end = command_subst_end(lexer->input, lexer->pos);
+            if(end == COMMAND_SUBST_NOT_FOUND || end >= lexer->len){
+                return make_error_token(start, "lexer_extract_basic: unclosed command substitution");
+            }
+            lexer->pos = end + 1;
+            continue;
+        }
+        lexer->pos++;
+    }
+    if(lexer->pos >= lexer->len || is_word_end(lexer->input[lexer->pos])){
+        return make_word_token(start, lexer->input + start, lexer->pos - start, QUOTE_NONE);
+    }
+
+    // Декодирование: уже пройденная часть копируется целиком, дальше
+    // обычные символы копируются отрезками до следующего особого символа
+    size_t len = lexer->pos - start, buf_size = DEFAULT_BUF_SIZE;
+    while(buf_size <= len){
+        buf_size *= 2;
+    }
+    char *buf = arena_alloc(lexer->arena, buf_size);
     if(!buf)
         return make_error_token(start, "lexer_extract_basic: alloc fail");
+    memcpy(buf, lexer->input + start, len);
     QuoteCount quote_type = QUOTE_NONE, active_quote = QUOTE_NONE;
     size_t quote_start = 0;
 
@@ -201,23 +367,33 @@ static Token lexer_extract_basic(Lexer *lexer){
                 continue;
             }
 
-            if(c == ' ' || c == '\n' || c == '\t' || c == '\0'|| c == '\r' || c == '&' || c == ';' || c == '|' || c == '<' || c == '>' || c == '(' || c == ')'){
+            if(is_word_end(c)){
                 break;
             }
 
+            if(is_subst_start(lexer)){
+                if(!lexer_copy_subst(lexer, &buf, &buf_size, &len)){
+                    return make_error_token(start, "lexer_extract_basic: unclosed command substitution");
+                }
+                continue;
+            }
+
             if(c == '\\'){
                 if(lexer->pos + 1 >= lexer->len){
-                    free(buf);
                     return make_error_token(start, "lexer_extract_basic: hanging \\");
                 }
 
                 char n = lexer->input[lexer->pos + 1];
 
+                // \\, \$ и \` остаются экранированными до раскрытия:
+                // Expander снимает обратную косую черту и не выполняет подстановку
                 if(n == '\\' || n == '"' || n == '$' || n == '`'){
-                    if (!lexer_grow_buffer(&buf, &buf_size, len + 1)) {
-                        free(buf);
+                    if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + 2)) {
                         return make_error_token(start, "lexer_extract_basic: alloc fail");
                     }
+                    if(n != '"'){
+                        buf[len++] = '\\';
+                    }
                     buf[len++] = n;
                     lexer->pos += 2;
                     continue;
@@ -235,20 +411,22 @@ static Token lexer_extract_basic(Lexer *lexer){
                     continue;
                 }
 
-                if (!lexer_grow_buffer(&buf, &buf_size, len + 1)) {
-                    free(buf);
+                if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + 1)) {
                     return make_error_token(start, "lexer_extract_basic: alloc fail");
                 }
                 buf[len++] = n;
                 lexer->pos += 2;
                 continue; 
             }
-            if (!lexer_grow_buffer(&buf, &buf_size, len + 1)) {
-                free(buf);
+            // Отрезок обычных символов до следующего особого
+            size_t run_end = scan_word_stop(lexer->input, lexer->pos + 1, lexer->len);
+            size_t run = run_end - lexer->pos;
+            if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + run)) {
                 return make_error_token(start, "lexer_extract_basic: alloc fail");
             }
-            buf[len++] = c;
-            lexer->pos++;
+            memcpy(buf + len, lexer->input + lexer->pos, run);
+            len += run;
+            lexer->pos = run_end;
             continue;
         }
         if(active_quote == QUOTE_SINGLE){
@@ -257,12 +435,29 @@ static Token lexer_extract_basic(Lexer *lexer){
                 lexer->pos++;
                 continue;
             }
-            if (!lexer_grow_buffer(&buf, &buf_size, len + 1)) {
-                free(buf);
+            // $, ` и \ внутри одинарных кавычек экранируются: слова раскрываются
+            // при выполнении, и раскрытие вернёт их как есть
+            if(CHAR_CLASS(c) & (CC_ESCAPE | CC_SUBST)){
+                if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + 2)) {
+                    return make_error_token(start, "lexer_extract_basic: alloc fail");
+                }
+                buf[len++] = '\\';
+                buf[len++] = c;
+                lexer->pos++;
+                continue;
+            }
+            // Остальное до закрывающей кавычки или особого символа - одним отрезком
+            size_t run_end = lexer->pos + 1;
+            while(run_end < lexer->len && !(CHAR_CLASS(lexer->input[run_end]) & (CC_QUOTE | CC_ESCAPE | CC_SUBST))){
+                run_end++;
+            }
+            size_t run = run_end - lexer->pos;
+            if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + run)) {
                 return make_error_token(start, "lexer_extract_basic: alloc fail");
             }
-            buf[len++] = c;
-            lexer->pos++;
+            memcpy(buf + len, lexer->input + lexer->pos, run);
+            len += run;
+            lexer->pos = run_end;
             continue;
         }
 
@@ -273,19 +468,29 @@ static Token lexer_extract_basic(Lexer *lexer){
                 continue;
             }
 
+            if(is_subst_start(lexer)){
+                if(!lexer_copy_subst(lexer, &buf, &buf_size, &len)){
+                    return make_error_token(quote_start, "lexer_extract_basic: unclosed command substitution");
+                }
+                continue;
+            }
+
             if(c == '\\'){
                 if(lexer->pos + 1 >= lexer->len){
-                    free(buf);
                     return make_error_token(quote_start, "lexer_extract_basic: hanging \\");
                 }
 
                 char n = lexer->input[lexer->pos + 1];
 
+                // \\, \$ и \` остаются экранированными до раскрытия:
+                // Expander снимает обратную косую черту и не выполняет подстановку
                 if(n == '\\' || n == '"' || n == '$' || n == '`'){
-                    if (!lexer_grow_buffer(&buf, &buf_size, len + 1)) {
-                        free(buf);
+                    if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + 2)) {
                         return make_error_token(start, "lexer_extract_basic: alloc fail");
                     }
+                    if(n != '"'){
+                        buf[len++] = '\\';
+                    }
                     buf[len++] = n;
                     lexer->pos += 2;
                     continue;
@@ -304,8 +509,7 @@ static Token lexer_extract_basic(Lexer *lexer){
                     continue;
                 }
 
-                if (!lexer_grow_buffer(&buf, &buf_size, len + 1)) {
-                    free(buf);
+                if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + 1)) {
                     return make_error_token(start, "lexer_extract_basic: alloc fail");
                 }
                 buf[len++] = '\\';
@@ -313,8 +517,7 @@ static Token lexer_extract_basic(Lexer *lexer){
                 continue;
             }
 
-            if (!lexer_grow_buffer(&buf, &buf_size, len + 1)) {
-                free(buf);
+            if (!lexer_grow_buffer(lexer, &buf, &buf_size, len + 1)) {
                 return make_error_token(start, "lexer_extract_basic: alloc fail");
             }
             buf[len++] = c;
@@ -325,22 +528,13 @@ static Token lexer_extract_basic(Lexer *lexer){
     }
 
     if(active_quote != QUOTE_NONE){
-        free(buf);
         return make_error_token(quote_start, "lexer_extract_basic: unclosed quotes");
     }
 
-    if (!lexer_grow_buffer(&buf, &buf_size, len + 1)) {
-        free(buf);
-        return make_error_token(start, "lexer_extract_basic: alloc fail");
-    }
-    buf[len] = '\0';
-
-Token token;
-token.pos = start;
-token.quote = quote_type;
-token.type = TOKEN_WORD;
-token.text = buf;
-return token;
+    // Лишнее место в конце буфера возвращается арене
+    buf = arena_realloc(lexer->arena, buf, buf_size, len);
+
+    return make_word_token(start, buf, len, quote_type);
 }
 
 static Token lexer_extract_pipe(Lexer *lexer)
@@ -376,6 +570,10 @@ static Token lexer_extract_redir(Lexer *lexer)
     switch (lexer->input[lexer->pos]) {
     case '>':
         lexer->pos++;
+        if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '(') {
+            lexer->pos++;
+            return make_simple_token(TOKEN_PROCSUB_OUT, start);
+        }
         if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '>') {
             lexer->pos++;
             return make_simple_token(TOKEN_REDIR_OUT_APPEND, start);
@@ -384,6 +582,18 @@ static Token lexer_extract_redir(Lexer *lexer)
 
     case '<':
         lexer->pos++;
+        if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '(') {
+            lexer->pos++;
+            return make_simple_token(TOKEN_PROCSUB_IN, start);
+        }
+        if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '<') {
+            lexer->pos++;
+            if (lexer->pos < lexer->len && lexer->input[lexer->pos] == '<') {
+                lexer->pos++;
+                return make_simple_token(TOKEN_HERESTRING, start);
+            }
+            return make_simple_token(TOKEN_HEREDOC, start);
+        }
         return make_simple_token(TOKEN_REDIR_IN, start);
 
     case '&':
@@ -403,17 +613,6 @@ static Token lexer_extract_redir(Lexer *lexer)
     }
 }
 
-void lexer_free_token(Token *token)
-{
-    if(!token)
-        return;
-
-    if(token->text){
-        free(token->text);
-        token->text = NULL;
-    }
-}
-
 static Token lexer_extract_control(Lexer *lexer)
 {
     if (!lexer || !lexer->input)
@@ -450,9 +649,10 @@ static Token lexer_extract_control(Lexer *lexer)
     }
 }
 
-void token_array_init(TokenArray *array){
+void token_array_init(TokenArray *array, Arena *arena){
     assert(array && "token_array_init: null ptr");
 
+    array->arena = arena;
     array->capacity = 0;
     array->count = 0;
     array->tokens = NULL;
@@ -463,7 +663,8 @@ int token_array_push(TokenArray *array, Token token){
 
     if(array->count == array->capacity){
         size_t new_capacity = array->capacity == 0 ? DEFAULT_ARR_SIZE : array->capacity * 2;
-        Token *tmp = realloc(array->tokens, new_capacity * sizeof(Token));
+        Token *tmp = arena_realloc(array->arena, array->tokens,
+                                   array->capacity * sizeof(Token), new_capacity * sizeof(Token));
         if(!tmp){
             return 0;
         }
@@ -477,33 +678,76 @@ int token_array_push(TokenArray *array, Token token){
     return 1;
 }
 
-void token_array_free(TokenArray *array){
-    assert(array && "token_array_free: null array ptr");
+// Чтение тела here-document: строки от текущей позиции до строки,
+// совпадающей с delim. Тело - срез входа в тексте токена <<
+// Позиция лексера переносится за строку-ограничитель
+// Возвращает 1 при успехе, 0 если ограничитель не найден
+static int lexer_read_heredoc_body(Lexer *lexer, const Token *delim, Token *heredoc){
+    size_t delim_len = delim->len;
+    size_t body_start = lexer->pos;
+    size_t line = lexer->pos;
+
+    while(line < lexer->len){
+        const char *nl = memchr(lexer->input + line, '\n', lexer->len - line);
+        size_t line_end = nl ? (size_t)(nl - lexer->input) : lexer->len;
+        size_t line_len = line_end - line;
+        if(line_len > 0 && lexer->input[line_end - 1] == '\r'){
+            line_len--;
+        }
+
+        if(line_len == delim_len && memcmp(lexer->input + line, delim->text, delim_len) == 0){
+            heredoc->text = lexer->input + body_start;
+            heredoc->len = line - body_start;
+            lexer->pos = nl ? line_end + 1 : line_end;
+            return 1;
+        }
 
-    for(size_t i = 0; i < array->count; ++i){
-        lexer_free_token(&array->tokens[i]);
+        line = nl ? line_end + 1 : lexer->len;
     }
 
-    free(array->tokens);
-    array->tokens = NULL;
-    array->capacity = 0;
-    array->count = 0;
+    return 0;
 }
 
 int lexer_tokenize_all(Lexer *lexer, TokenArray *array){
     assert(array && "lexer_tokenize_all: null array");
     assert(lexer && "lexer_tokenize_all: null lexer");
 
-    token_array_init(array);
+    // Индексы токенов << в строке, тела которых ещё не прочитаны
+    // Тела идут после конца строки с командой, в порядке появления <<
+    size_t pending[DEFAULT_ARR_SIZE];
+    size_t pending_count = 0;
+
+    token_array_init(array, lexer->arena);
     while(1){
         Token token = lexer_tokenize(lexer);
 
+        if(token.type == TOKEN_HEREDOC && pending_count >= DEFAULT_ARR_SIZE){
+            token = make_error_token(token.pos, "lexer_tokenize_all: too many here-documents");
+        }
+
+        if((token.type == TOKEN_NEWLINE || token.type == TOKEN_EOF) && pending_count > 0){
+            // Читаем тела here-documents, ограничитель - следующее за << слово
+            for(size_t i = 0; i < pending_count; i++){
+                size_t idx = pending[i];
+                if(idx + 1 >= array->count || array->tokens[idx + 1].type != TOKEN_WORD){
+                    continue;  // Нет ограничителя - ошибку выдаст парсер
+                }
+                if(!lexer_read_heredoc_body(lexer, &array->tokens[idx + 1], &array->tokens[idx])){
+                    token = make_error_token(array->tokens[idx].pos, "lexer_tokenize_all: unterminated here-document");
+                    break;
+                }
+            }
+            pending_count = 0;
+        }
+
         if(!token_array_push(array, token)){
-            lexer_free_token(&token);
-            token_array_free(array);
             return 0;
         }
 
+        if(token.type == TOKEN_HEREDOC){
+            pending[pending_count++] = array->count - 1;
+        }
+
         if(token.type == TOKEN_EOF || token.type == TOKEN_ERROR){
             break;
         }
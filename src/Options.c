@@ -0,0 +1,111 @@
+// Options.c
+// Опции shell, управляемые через set -o NAME / set +o NAME
+// Опции с значением задаются как set -o NAME=VALUE (например, pipebuf=1M)
+// set -o без имени выводит текущие значения всех опций
+
+#include "Options.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    OPT_TYPE_BOOL,      // on/off
+    OPT_TYPE_SIZE       // размер в байтах, поддерживаются суффиксы K, M, G
+} ShellOptionType;
+
+typedef struct {
+    const char *name;
+    ShellOptionType type;
+    long value;
+} ShellOptionInfo;
+
+static ShellOptionInfo g_options[OPT_COUNT] = {
+    [OPT_LASTPIPE] = { "lastpipe", OPT_TYPE_BOOL, 0 },
+    [OPT_PIPEBUF]  = { "pipebuf",  OPT_TYPE_SIZE, 0 },
+    [OPT_BGCAPTURE] = { "bgcapture", OPT_TYPE_BOOL, 0 },
+    [OPT_BGCAPSIZE] = { "bgcapsize", OPT_TYPE_SIZE, 0 },
+    [OPT_PIPEFAIL] = { "pipefail", OPT_TYPE_BOOL, 0 },
+};
+
+// Разбор размера: 65536, 64K, 1M, 1G
+// Возвращает -1 при ошибке формата
+long parse_size(const char *str){
+    if(!str || !str[0]){
+        return -1;
+    }
+
+    char *end;
+    long value = strtol(str, &end, 10);
+    if(end == str || value < 0){
+        return -1;
+    }
+
+    switch(*end){
+        case '\0': return value;
+        case 'k': case 'K': value *= 1024L; end++; break;
+        case 'm': case 'M': value *= 1024L * 1024L; end++; break;
+        case 'g': case 'G': value *= 1024L * 1024L * 1024L; end++; break;
+        default: return -1;
+    }
+
+    return *end == '\0' ? value : -1;
+}
+
+// Получение текущего значения опции
+long shell_option_get(ShellOption opt){
+    if(opt < 0 || opt >= OPT_COUNT){
+        return 0;
+    }
+    return g_options[opt].value;
+}
+
+// Включение/выключение опции по имени
+// spec - "name" или "name=value" для опций со значением
+// Возвращает 0 при успехе, 1 при ошибке
+int shell_option_set(const char *spec, int enable){
+    const char *eq = strchr(spec, '=');
+    size_t name_len = eq ? (size_t)(eq - spec) : strlen(spec);
+
+    for(int i = 0; i < OPT_COUNT; i++){
+        ShellOptionInfo *opt = &g_options[i];
+        if(strlen(opt->name) != name_len || strncmp(spec, opt->name, name_len) != 0){
+            continue;
+        }
+
+        if(opt->type == OPT_TYPE_BOOL || !enable){
+            if(eq){
+                fprintf(stderr, "set: %s: option does not take a value\n", opt->name);
+                return 1;
+            }
+            opt->value = enable ? 1 : 0;
+            return 0;
+        }
+
+        long value = eq ? parse_size(eq + 1) : -1;
+        if(value < 0){
+            fprintf(stderr, "set: %s: expected %s=SIZE (e.g. %s=1M)\n", opt->name, opt->name, opt->name);
+            return 1;
+        }
+        opt->value = value;
+        return 0;
+    }
+
+    fprintf(stderr, "set: %.*s: invalid option name\n", (int)name_len, spec);
+    return 1;
+}
+
+// Вывод всех опций (set -o)
+void shell_options_print(void){
+    for(int i = 0; i < OPT_COUNT; i++){
+        if(g_options[i].type == OPT_TYPE_SIZE){
+            if(g_options[i].value){
+                printf("%-15s %ld\n", g_options[i].name, g_options[i].value);
+            } else {
+                printf("%-15s default\n", g_options[i].name);
+            }
+        } else {
+            printf("%-15s %s\n", g_options[i].name, g_options[i].value ? "on" : "off");
+        }
+    }
+}
@@ -0,0 +1,109 @@
+// OutputRing.c
+// Кольцевой буфер фиксированного размера для вывода фоновых задач (set -o bgcapture)
+// При переполнении вытесняются самые старые байты, память на задачу ограничена
+// ёмкостью, заданной при создании (set -o bgcapsize=SIZE)
+
+#include "OutputRing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+OutputRing *output_ring_create(size_t capacity){
+    if(capacity == 0){
+        capacity = OUTPUT_RING_DEFAULT_SIZE;
+    }
+
+    OutputRing *ring = malloc(sizeof(OutputRing));
+    if(!ring){
+        perror("output_ring_create: malloc");
+        return NULL;
+    }
+    ring->data = malloc(capacity);
+    if(!ring->data){
+        perror("output_ring_create: malloc");
+        free(ring);
+        return NULL;
+    }
+    ring->capacity = capacity;
+    ring->start = 0;
+    ring->length = 0;
+    ring->dropped = 0;
+    return ring;
+}
+
+void output_ring_free(OutputRing *ring){
+    if(!ring){
+        return;
+    }
+    free(ring->data);
+    free(ring);
+}
+
+// Добавление данных в конец; не поместившиеся старые байты вытесняются
+void output_ring_write(OutputRing *ring, const char *buf, size_t len){
+    // Из длинного блока нужен только хвост размером с буфер
+    if(len >= ring->capacity){
+        ring->dropped += ring->length + len - ring->capacity;
+        memcpy(ring->data, buf + len - ring->capacity, ring->capacity);
+        ring->start = 0;
+        ring->length = ring->capacity;
+        return;
+    }
+
+    size_t free_space = ring->capacity - ring->length;
+    if(len > free_space){
+        size_t evict = len - free_space;
+        ring->start = (ring->start + evict) % ring->capacity;
+        ring->length -= evict;
+        ring->dropped += evict;
+    }
+
+    // Запись максимум двумя кусками: до конца массива и с начала
+    size_t end = (ring->start + ring->length) % ring->capacity;
+    size_t first = ring->capacity - end < len ? ring->capacity - end : len;
+    memcpy(ring->data + end, buf, first);
+    memcpy(ring->data, buf + first, len - first);
+    ring->length += len;
+}
+
+static int write_all(int fd, const char *buf, size_t len){
+    while(len > 0){
+        ssize_t n = write(fd, buf, len);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Вывод содержимого в fd от старых байт к новым
+// Если часть вывода была вытеснена, сначала выводится пометка об этом
+int output_ring_dump(const OutputRing *ring, int fd){
+    if(ring->dropped){
+        char note[64];
+        int n = snprintf(note, sizeof(note), "[... %zu bytes dropped ...]\n", ring->dropped);
+        if(write_all(fd, note, (size_t)n) < 0){
+            return -1;
+        }
+    }
+
+    size_t first = ring->capacity - ring->start < ring->length ? ring->capacity - ring->start : ring->length;
+    if(write_all(fd, ring->data + ring->start, first) < 0){
+        return -1;
+    }
+    return write_all(fd, ring->data, ring->length - first);
+}
+
+void output_ring_clear(OutputRing *ring){
+    ring->start = 0;
+    ring->length = 0;
+    ring->dropped = 0;
+}
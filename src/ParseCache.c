@@ -0,0 +1,205 @@
+// ParseCache.c
+// Кеш разбора: строка -> AST
+// Интерактивные сессии и скрипты повторяют одни и те же строки (циклы,
+// history), а лексер и парсер для них каждый раз давали бы одно и то же
+// дерево: слова раскрываются только при выполнении (Executor), так что
+// AST зависит лишь от текста строки. Повторная строка выполняется по уже
+// разобранному дереву без лексера и парсера
+// Кеш ограничен PARSE_CACHE_CAPACITY строками, вытесняется давно не
+// использованная (LRU). У каждой записи своя арена: при вытеснении она
+// сбрасывается и переиспользуется новой строкой без malloc/free
+// Ошибки разбора не кешируются. Очищается командой parsecache -r
+
+#include "ParseCache.h"
+#include "Lexer.h"
+#include "Parser.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static ParseCacheEntry g_entries[PARSE_CACHE_CAPACITY];
+static ParseCacheEntry *g_buckets[PARSE_CACHE_BUCKETS];
+static ParseCacheEntry *g_lru_head = NULL;
+static ParseCacheEntry *g_lru_tail = NULL;
+static ParseCacheEntry *g_free = NULL;      // Записи без строки
+static size_t g_count = 0;
+static int g_initialized = 0;
+
+static unsigned long g_hits = 0;
+static unsigned long g_misses = 0;
+
+// Арена строк длиннее PARSE_CACHE_MAX_LINE: живёт до следующей строки
+static Arena g_uncached;
+
+// FNV-1a хеш строки длины len
+static size_t hash_line(const char *line, size_t len){
+    size_t h = 14695981039346656037ULL;
+    for(size_t i = 0; i < len; i++){
+        h ^= (unsigned char)line[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void parse_cache_init(void){
+    for(size_t i = 0; i < PARSE_CACHE_CAPACITY; i++){
+        arena_init(&g_entries[i].arena, ARENA_BLOCK_SIZE);
+        g_entries[i].next = g_free;
+        g_free = &g_entries[i];
+    }
+    arena_init(&g_uncached, ARENA_BLOCK_SIZE);
+    g_initialized = 1;
+}
+
+static void lru_unlink(ParseCacheEntry *e){
+    if(e->lru_prev){
+        e->lru_prev->lru_next = e->lru_next;
+    } else {
+        g_lru_head = e->lru_next;
+    }
+    if(e->lru_next){
+        e->lru_next->lru_prev = e->lru_prev;
+    } else {
+        g_lru_tail = e->lru_prev;
+    }
+}
+
+static void lru_push_front(ParseCacheEntry *e){
+    e->lru_prev = NULL;
+    e->lru_next = g_lru_head;
+    if(g_lru_head){
+        g_lru_head->lru_prev = e;
+    } else {
+        g_lru_tail = e;
+    }
+    g_lru_head = e;
+}
+
+static ParseCacheEntry **bucket_slot(const ParseCacheEntry *e){
+    ParseCacheEntry **slot = &g_buckets[e->hash & (PARSE_CACHE_BUCKETS - 1)];
+    while(*slot != e){
+        slot = &(*slot)->next;
+    }
+    return slot;
+}
+
+// Запись для новой строки: свободная или вытесненная давно не использованная
+static ParseCacheEntry *entry_take(void){
+    ParseCacheEntry *e = g_free;
+    if(e){
+        g_free = e->next;
+    } else {
+        e = g_lru_tail;
+        lru_unlink(e);
+        *bucket_slot(e) = e->next;
+        g_count--;
+    }
+    arena_reset(&e->arena);
+    return e;
+}
+
+// Лексер и парсер строки в арене; line должна жить вместе с ареной
+static ASTNode *parse_line(const char *line, Arena *arena){
+    Lexer lexer;
+    TokenArray tokens;
+    lexer_init(&lexer, line, arena);
+    if(!lexer_tokenize_all(&lexer, &tokens)){
+        fprintf(stderr, "tokenize failed\n");
+        lexer_destroy(&lexer);
+        return NULL;
+    }
+
+    Parser parser;
+    parser_init(&parser, &tokens);
+    ASTNode *ast = parser_parse(&parser);
+    lexer_destroy(&lexer);
+    return ast;
+}
+
+// AST строки: из кеша или после разбора
+// Дерево действительно до следующего вызова parse_cache_get, его нельзя
+// изменять - раскрытие при выполнении работает с копиями узлов
+// Возвращает NULL для пустой строки и при ошибке разбора
+ASTNode *parse_cache_get(const char *line){
+    if(!g_initialized){
+        parse_cache_init();
+    }
+
+    size_t len = strlen(line);
+    if(len > PARSE_CACHE_MAX_LINE){
+        g_misses++;
+        arena_reset(&g_uncached);
+        return parse_line(line, &g_uncached);
+    }
+
+    size_t hash = hash_line(line, len);
+    for(ParseCacheEntry *e = g_buckets[hash & (PARSE_CACHE_BUCKETS - 1)]; e; e = e->next){
+        if(e->hash == hash && e->len == len && memcmp(e->line, line, len) == 0){
+            g_hits++;
+            lru_unlink(e);
+            lru_push_front(e);
+            return e->ast;
+        }
+    }
+
+    g_misses++;
+    ParseCacheEntry *e = entry_take();
+    char *copy = arena_strndup(&e->arena, line, len);
+    ASTNode *ast = copy ? parse_line(copy, &e->arena) : NULL;
+    if(!ast){
+        e->next = g_free;
+        g_free = e;
+        return NULL;
+    }
+
+    e->hash = hash;
+    e->line = copy;
+    e->len = len;
+    e->ast = ast;
+    ParseCacheEntry **bucket = &g_buckets[hash & (PARSE_CACHE_BUCKETS - 1)];
+    e->next = *bucket;
+    *bucket = e;
+    lru_push_front(e);
+    g_count++;
+    return ast;
+}
+
+// Удаление всех строк и сброс счётчиков (parsecache -r)
+// Арены записей не сбрасываются: команда может выполняться из дерева
+// записи, память переиспользуется следующими строками
+void parse_cache_clear(void){
+    while(g_lru_head){
+        ParseCacheEntry *e = g_lru_head;
+        lru_unlink(e);
+        e->next = g_free;
+        g_free = e;
+    }
+    memset(g_buckets, 0, sizeof(g_buckets));
+    g_count = 0;
+    g_hits = 0;
+    g_misses = 0;
+}
+
+// Вывод заполнения кеша и счётчиков попаданий
+void parse_cache_print(void){
+    unsigned long total = g_hits + g_misses;
+    printf("entries\t%zu/%d\n", g_count, PARSE_CACHE_CAPACITY);
+    printf("hits\t%lu\n", g_hits);
+    printf("misses\t%lu\n", g_misses);
+    printf("hit rate\t%.1f%%\n", total ? 100.0 * (double)g_hits / (double)total : 0.0);
+}
+
+// Освобождение памяти всех записей
+// Вызывается при завершении shell
+void parse_cache_free(void){
+    if(!g_initialized){
+        return;
+    }
+    parse_cache_clear();
+    for(size_t i = 0; i < PARSE_CACHE_CAPACITY; i++){
+        arena_free(&g_entries[i].arena);
+    }
+    arena_free(&g_uncached);
+    g_free = NULL;
+    g_initialized = 0;
+}
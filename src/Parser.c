@@ -1,6 +1,8 @@
 // Parser.c
 
 #include "Parser.h"
+#include "Options.h"
+#include "Expander.h"
 
 #include <assert.h>
 #include <stdio.h>
@@ -11,6 +13,7 @@ static const Token *current_token(Parser *parser);
 static const Token *previous_token(Parser *parser);
 static void advance(Parser *parser);
 static int match(Parser *parser, TokenType type);
+static int word_equals(const Token *tok, const char *word);
 
 // Функции парсинга по уровням приоритета (от низшего к высшему)
 static ASTNode *parse_command_line(Parser *parser);   // ; &
@@ -27,6 +30,11 @@ void parser_init(Parser *parser, TokenArray *tokens){
 
     parser->tokens = tokens;
     parser->pos = 0;
+    parser->depth = 0;
+    parser->too_deep = 0;
+    parser->nodes.nodes = NULL;
+    parser->nodes.count = 0;
+    parser->nodes.capacity = 0;
 }
 
 // Главная функция парсинга - точка входа
@@ -43,6 +51,15 @@ ASTNode *parser_parse(Parser *parser){
         return NULL;
     }
     
+    // Каждый узел создаётся из своего токена, только & даёт два узла
+    // (BACKGROUND и SEQUENCE) - массив узлов резервируется сразу целиком
+    size_t capacity = parser->tokens->count * 2;
+    if (capacity > INT32_MAX ||
+        ast_array_init(&parser->nodes, parser->tokens->arena, (uint32_t)capacity) < 0) {
+        fprintf(stderr, "Parser error: command line is too long\n");
+        return NULL;
+    }
+    
     ASTNode *tree = parse_command_line(parser);
     
     if (!tree) {
@@ -55,9 +72,8 @@ ASTNode *parser_parse(Parser *parser){
     // Проверяем что распарсили всё
     const Token *tok = current_token(parser);
     if (tok && tok->type != TOKEN_EOF) {
-        fprintf(stderr, "Parser error: unexpected token '%s' at position %zu\n",
-                tok->text ? tok->text : "<operator>", tok->pos);
-        ast_free(tree);
+        fprintf(stderr, "Parser error: unexpected token '%.*s' at position %zu\n",
+                tok->text ? (int)tok->len : 10, tok->text ? tok->text : "<operator>", tok->pos);
         return NULL;
     }
     
@@ -74,6 +90,13 @@ static int match(Parser *parser, TokenType type) {
     return 0;
 }
 
+// Слово без кавычек, равное word (сравнение среза токена)
+static int word_equals(const Token *tok, const char *word){
+    size_t len = strlen(word);
+    return tok && tok->type == TOKEN_WORD && tok->quote == QUOTE_NONE && tok->text &&
+           tok->len == len && memcmp(tok->text, word, len) == 0;
+}
+
 // Переход к следующему токену
 static void advance(Parser *parser){
     if(parser->pos < parser->tokens->count){
@@ -103,51 +126,36 @@ static ASTNode *parse_command_line(Parser *parser){
     while(match(parser, TOKEN_SEMI) || match(parser, TOKEN_AMP)){
         const Token *op = previous_token(parser);
         if(!op){
-            ast_free(left);
             fprintf(stderr, "Parser error: failed to get operator token\n");
             return NULL;
         }
 
         while(match(parser, TOKEN_NEWLINE)){}
 
+        // & - левая часть в фон; узел создаётся до правой части, чтобы
+        // поддерево BACKGROUND шло в массиве узлов непрерывно
+        if(op->type == TOKEN_AMP){
+            left = ast_create_binary(&parser->nodes, AST_BACKGROUND, left, NULL);
+            if(!left){
+                return NULL;
+            }
+        }
+
         // Оператор в конце строки: "ls &\n" или "ls;\n"
         if(match(parser, TOKEN_EOF)){
-            if(op->type == TOKEN_AMP){
-                // & в конце - запуск в фоне
-                ASTNode *result = ast_create_binary(AST_BACKGROUND, left, NULL);
-                if(!result){
-                    ast_free(left);
-                    return NULL;
-                }
-                return result;
-            }
             return left;
         }
 
         // Парсим следующую команду после ; или &
         ASTNode *right = parse_and_or_list(parser);
         if(!right){
-            ast_free(left);
             return NULL;
         }
 
-        // Строим AST в зависимости от оператора
-        if(op->type == TOKEN_SEMI){
-            // ; - последовательное выполнение
-            left = ast_create_binary(AST_SEQUENCE, left, right);
-        } else {
-            // & - левая часть в фон, потом правая часть
-            ASTNode *bg = ast_create_binary(AST_BACKGROUND, left, NULL);
-            if(!bg){
-                ast_free(left);
-                ast_free(right);
-                return NULL;
-            }
-            left = ast_create_binary(AST_SEQUENCE, bg, right);
-        }
+        // ; - последовательное выполнение, после & - правая часть сразу
+        left = ast_create_binary(&parser->nodes, AST_SEQUENCE, left, right);
         
         if(!left){
-            ast_free(right);
             return NULL;
         }
     }
@@ -171,7 +179,6 @@ static ASTNode *parse_and_or_list(Parser *parser){
     while(match(parser, TOKEN_AND) || match(parser, TOKEN_OR)){
         const Token *op = previous_token(parser);
         if(!op){
-            ast_free(left);
             fprintf(stderr, "Parser error: failed to get operator token\n");
             return NULL;
         }
@@ -179,20 +186,18 @@ static ASTNode *parse_and_or_list(Parser *parser){
         
         ASTNode *right = parse_pipeline(parser);
         if(!right){
-            ast_free(left);
             return NULL;
         }
         
         // && - выполнить правую часть если левая успешна
         // || - выполнить правую часть если левая неуспешна
         if(op_type == TOKEN_AND){
-            left = ast_create_binary(AST_AND, left, right);
+            left = ast_create_binary(&parser->nodes, AST_AND, left, right);
         } else {
-            left = ast_create_binary(AST_OR, left, right);
+            left = ast_create_binary(&parser->nodes, AST_OR, left, right);
         }
         
         if(!left){
-            ast_free(right);
             return NULL;
         }
     }
@@ -200,7 +205,50 @@ static ASTNode *parse_and_or_list(Parser *parser){
     return left;
 }
 
-// Парсинг pipeline: cmd1 | cmd2 |& cmd3
+// Префикс PIPEBUF=SIZE перед pipeline задаёт размер буфера pipe только для него
+// Возвращает 1 если префикс разобран, 0 если его нет, -1 при ошибке
+static int parse_pipe_size_prefix(Parser *parser, size_t *pipe_size){
+    static const char prefix[] = "PIPEBUF=";
+    const size_t prefix_len = sizeof(prefix) - 1;
+    const Token *tok = current_token(parser);
+    if(!tok || tok->type != TOKEN_WORD || tok->quote != QUOTE_NONE || !tok->text ||
+       tok->len < prefix_len || memcmp(tok->text, prefix, prefix_len) != 0){
+        return 0;
+    }
+
+    char *value = arena_strndup(parser->tokens->arena, tok->text + prefix_len, tok->len - prefix_len);
+    long size = value ? parse_size(value) : -1;
+    if(size < 0 || size > UINT32_MAX){
+        fprintf(stderr, "Parser error: invalid pipe size '%.*s' at position %zu\n",
+                (int)(tok->len - prefix_len), tok->text + prefix_len, tok->pos);
+        return -1;
+    }
+    *pipe_size = (size_t)size;
+    advance(parser);
+    return 1;
+}
+
+// Ключевое слово time [-p|-m] перед pipeline
+// Возвращает 1 если разобрано (формат в *format), 0 если его нет
+static int parse_time_keyword(Parser *parser, TimeFormat *format){
+    if(!word_equals(current_token(parser), "time")){
+        return 0;
+    }
+    advance(parser);
+
+    *format = TIME_FORMAT_DEFAULT;
+    const Token *tok = current_token(parser);
+    if(word_equals(tok, "-p")){
+        *format = TIME_FORMAT_POSIX;
+        advance(parser);
+    } else if(word_equals(tok, "-m")){
+        *format = TIME_FORMAT_MACHINE;
+        advance(parser);
+    }
+    return 1;
+}
+
+// Парсинг pipeline: [time [-p|-m]] [PIPEBUF=SIZE] cmd1 | cmd2 |& cmd3
 static ASTNode *parse_pipeline(Parser *parser){
     // Проверка: команда не должна начинаться с | или |&
     const Token *tok = current_token(parser);
@@ -210,13 +258,26 @@ static ASTNode *parse_pipeline(Parser *parser){
         return NULL;
     }
     
+    // time измеряет весь pipeline и каждую его стадию
+    TimeFormat time_format;
+    int timed = parse_time_keyword(parser, &time_format);
+    
+    size_t pipe_size = 0;
+    if(parse_pipe_size_prefix(parser, &pipe_size) < 0){
+        return NULL;
+    }
+    
     ASTNode *left = parse_primary(parser);
-    if(!left) return NULL;
+    if(!left){
+        if(timed){
+            fprintf(stderr, "Parser error: expected command after 'time'\n");
+        }
+        return NULL;
+    }
 
     while(match(parser, TOKEN_PIPE) || match(parser, TOKEN_PIPE_ERR)){
         const Token *op = previous_token(parser);
         if(!op){
-            ast_free(left);
             fprintf(stderr, "Parser error: failed to get operator token\n");
             return NULL;
         }
@@ -224,34 +285,85 @@ static ASTNode *parse_pipeline(Parser *parser){
 
         ASTNode *right = parse_primary(parser);
         if(!right){
-            ast_free(left);
             return NULL;
         }
 
         // | - только stdout, |& - stdout и stderr
         if(op_type == TOKEN_PIPE){
-            left = ast_create_binary(AST_PIPELINE, left, right);
+            left = ast_create_binary(&parser->nodes, AST_PIPELINE, left, right);
         } else {
-            left = ast_create_binary(AST_PIPELINE_ERR, left, right);
+            left = ast_create_binary(&parser->nodes, AST_PIPELINE_ERR, left, right);
         }
         
         if(!left){
-            ast_free(right);
             return NULL;
         }
     }
 
+    // Размер хранится в корневом узле pipeline (для одной команды не нужен)
+    if(left->type == AST_PIPELINE || left->type == AST_PIPELINE_ERR){
+        left->data.binary.pipe_size = pipe_size;
+    }
+
+    if(timed){
+        return ast_create_time(&parser->nodes, left, time_format);
+    }
     return left;
 }
 
+// Вход в следующий уровень скобок: ( или <( >(
+// Возвращает -1 и сообщает об ошибке, если превышен PARSER_MAX_DEPTH
+static int enter_nested(Parser *parser){
+    if(parser->depth >= PARSER_MAX_DEPTH){
+        fprintf(stderr, "Parser error: parentheses nested deeper than %d\n", PARSER_MAX_DEPTH);
+        parser->too_deep = 1;
+        return -1;
+    }
+    parser->depth++;
+    return 0;
+}
+
+// Парсинг подстановки процесса: <(команды) или >(команды)
+// Токен <( или >( уже прочитан, внутри - полноценная командная строка
+static ASTNode *parse_process_substitution(Parser *parser){
+    if(enter_nested(parser) < 0){
+        return NULL;
+    }
+    while(match(parser, TOKEN_NEWLINE)){}
+
+    ASTNode *inner = parse_command_line(parser);
+    parser->depth--;
+    if(!inner){
+        // Внешние уровни не повторяют сообщение о превышении глубины
+        if(!parser->too_deep){
+            fprintf(stderr, "Parser error: expected command in process substitution\n");
+        }
+        return NULL;
+    }
+
+    while(match(parser, TOKEN_NEWLINE)){}
+
+    if(!match(parser, TOKEN_RPAREN)){
+        fprintf(stderr, "Parser error: expected ')' after process substitution\n");
+        return NULL;
+    }
+    return inner;
+}
+
 // Парсинг простой команды (слова до оператора или редиректа)
 // Собирает аргументы в массив для execvp
+// <(cmd) и >(cmd) занимают место аргумента, сама команда хранится в procsubs
+// Аргументы для execvp должны завершаться '\0': срезы токенов копируются в арену
 static ASTNode *parse_simple_command(Parser *parser){
+    Arena *arena = parser->tokens->arena;
     size_t capacity = 8;
     size_t count = 0;
-    char **args = malloc(capacity * sizeof(char *));
+    char **args = arena_alloc(arena, capacity * sizeof(char *));
+    ASTProcSubst *procsubs = NULL;
+    size_t procsub_count = 0;
+    int expand = 0;
     if(!args){
-        perror("parse_simple_command: malloc failed");
+        perror("parse_simple_command: arena_alloc failed");
         return NULL;
     }
 
@@ -265,76 +377,103 @@ static ASTNode *parse_simple_command(Parser *parser){
         if(tok->type == TOKEN_ERROR){
             fprintf(stderr, "Lexer error at position %zu: %s\n",
                     tok->pos, tok->text ? tok->text : "unknown error");
-            for(size_t i = 0; i < count; i++){
-                free(args[i]);
-            }
-            free(args);
             return NULL;
         }
         
         // Не слово - конец команды (оператор, редирект, EOF)
-        if(tok->type != TOKEN_WORD){
+        int is_procsub = (tok->type == TOKEN_PROCSUB_IN || tok->type == TOKEN_PROCSUB_OUT);
+        if(tok->type != TOKEN_WORD && !is_procsub){
             break;
         }
 
         // Динамический массив с удвоением capacity
         if(count >= capacity){
-            capacity *= 2;
-            char **new_args = realloc(args, capacity * sizeof(char *));
+            char **new_args = arena_realloc(arena, args, capacity * sizeof(char *),
+                                            capacity * 2 * sizeof(char *));
             if(!new_args){
-                perror("parse_simple_command: realloc failed");
-                for(size_t i = 0; i < count; i++){
-                    free(args[i]);
-                }
-                free(args);
+                perror("parse_simple_command: arena_realloc failed");
                 return NULL;
             }
             args = new_args;
+            capacity *= 2;
         }
 
-        args[count] = strdup(tok->text);
-        if(!args[count]){
-            perror("parse_simple_command: strdup failed");
-            for(size_t i = 0; i < count; i++){
-                free(args[i]);
+        if(is_procsub){
+            int output = (tok->type == TOKEN_PROCSUB_OUT);
+            advance(parser);
+
+            if(procsub_count == UINT8_MAX){
+                fprintf(stderr, "Parser error: too many process substitutions at position %zu\n", tok->pos);
+                return NULL;
+            }
+            ASTProcSubst *new_procsubs = arena_realloc(arena, procsubs,
+                                                       procsub_count * sizeof(ASTProcSubst),
+                                                       (procsub_count + 1) * sizeof(ASTProcSubst));
+            if(!new_procsubs){
+                perror("parse_simple_command: arena_realloc failed");
+                return NULL;
+            }
+            procsubs = new_procsubs;
+
+            ASTNode *inner = parse_process_substitution(parser);
+            if(!inner){
+                return NULL;
+            }
+
+            // Аргумент-заглушка, при выполнении заменяется на /dev/fd/N
+            args[count] = arena_strdup(arena, output ? ">(...)" : "<(...)");
+            if(!args[count]){
+                perror("parse_simple_command: arena_strdup failed");
+                return NULL;
             }
-            free(args);
+            // Пока узла команды нет - индекс в массиве, после создания - смещение
+            procsubs[procsub_count].arg_index = (uint32_t)count;
+            procsubs[procsub_count].output = (uint8_t)output;
+            procsubs[procsub_count].node = (ASTRef)(inner - parser->nodes.nodes);
+            procsub_count++;
+            count++;
+            continue;
+        }
+
+        args[count] = arena_strndup(arena, tok->text, tok->len);
+        if(!args[count]){
+            perror("parse_simple_command: arena_strndup failed");
             return NULL;
         }
+        expand |= expander_needs_expansion(tok->text, tok->len);
         count++;
         advance(parser);
     }
 
     if(count == 0){
-        free(args);
         return NULL;
     }
 
     // Место для NULL-терминатора (требуется для execvp)
     if(count >= capacity){
-        capacity++;
-        char **new_args = realloc(args, capacity * sizeof(char *));
+        char **new_args = arena_realloc(arena, args, capacity * sizeof(char *),
+                                        (capacity + 1) * sizeof(char *));
         if(!new_args){
-            perror("parse_simple_command: realloc failed");
-            for(size_t i = 0; i < count; i++){
-                free(args[i]);
-            }
-            free(args);
+            perror("parse_simple_command: arena_realloc failed");
             return NULL;
         }
         args = new_args;
+        capacity++;
     }
     args[count] = NULL;  // execvp требует NULL в конце
 
-    ASTNode *node = ast_create_command(args, count);
+    ASTNode *node = ast_create_command(&parser->nodes, args, count);
     if(!node){
         fprintf(stderr, "parse_simple_command: ast_create_command failed\n");
-        for(size_t i = 0; i < count; i++){
-            free(args[i]);
-        }
-        free(args);
         return NULL;
     }
+    ASTRef index = (ASTRef)(node - parser->nodes.nodes);
+    for(size_t i = 0; i < procsub_count; i++){
+        procsubs[i].node -= index;
+    }
+    node->data.command.procsubs = procsubs;
+    node->procsub_count = (uint8_t)procsub_count;
+    node->expand = (uint8_t)expand;
 
     return node;
 }
@@ -365,6 +504,12 @@ static ASTNode *parse_redirects(Parser *parser, ASTNode *command){
             case TOKEN_REDIR_ERR_APPEND:
                 redir_type = REDIR_ERR_APPEND;
                 break;
+            case TOKEN_HEREDOC:
+                redir_type = REDIR_HEREDOC;
+                break;
+            case TOKEN_HERESTRING:
+                redir_type = REDIR_HERESTRING;
+                break;
             default:
                 return command;  // Не редирект - возвращаем команду как есть
         }
@@ -376,24 +521,38 @@ static ASTNode *parse_redirects(Parser *parser, ASTNode *command){
         if(!file_tok || file_tok->type != TOKEN_WORD){
             fprintf(stderr, "Parser error: expected filename after redirect at position %zu\n",
                     tok->pos);
-            ast_free(command);
             return NULL;
         }
         
-        char *filename = strdup(file_tok->text);
+        // Для here-document в узел попадает тело (из токена <<),
+        // для here-string - слово с завершающим переводом строки
+        const Token *src = redir_type == REDIR_HEREDOC ? tok : file_tok;
+        size_t len = src->text ? src->len : 0;
+        size_t extra = redir_type == REDIR_HERESTRING ? 1 : 0;
+        char *filename = arena_alloc(parser->tokens->arena, len + extra + 1);
         if(!filename){
-            perror("parse_redirects: strdup failed");
-            ast_free(command);
+            perror("parse_redirects: arena_alloc failed");
             return NULL;
         }
+        if(len > 0){
+            memcpy(filename, src->text, len);
+        }
+        if(extra){
+            filename[len] = '\n';
+        }
+        filename[len + extra] = '\0';
         
         advance(parser);
         
         // Оборачиваем команду в узел редиректа
-        command = ast_create_redirect(command, redir_type, filename);
+        command = ast_create_redirect(&parser->nodes, command, redir_type, filename);
         if(!command){
             return NULL;
         }
+        // Тело here-document раскрывается, только если ограничитель без кавычек
+        if(redir_type != REDIR_HEREDOC || file_tok->quote == QUOTE_NONE){
+            command->expand = (uint8_t)expander_needs_expansion(filename, len);
+        }
     }
     
     return command;
@@ -403,23 +562,27 @@ static ASTNode *parse_redirects(Parser *parser, ASTNode *command){
 static ASTNode *parse_primary(Parser* parser){
     // Subshell: (команды внутри скобок)
     if(match(parser, TOKEN_LPAREN)){
-        // Рекурсивно парсим всё что внутри скобок
+        // Рекурсивно парсим всё что внутри скобок (глубина ограничена)
+        if(enter_nested(parser) < 0){
+            return NULL;
+        }
         ASTNode *inner = parse_command_line(parser);
+        parser->depth--;
         if(!inner){
-            fprintf(stderr, "Parser error: expected command after '('\n");
+            if(!parser->too_deep){
+                fprintf(stderr, "Parser error: expected command after '('\n");
+            }
             return NULL;
         }
         
         if(!match(parser, TOKEN_RPAREN)){
             fprintf(stderr, "Parser error: expected ')' after subshell command\n");
-            ast_free(inner);
             return NULL;
         }
         
-        ASTNode *subshell = ast_create_subshell(inner);
+        ASTNode *subshell = ast_create_subshell(&parser->nodes, inner);
         if(!subshell){
             fprintf(stderr, "parse_primary: ast_create_subshell failed\n");
-            ast_free(inner);
             return NULL;
         }
         
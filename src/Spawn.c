@@ -0,0 +1,335 @@
+// Spawn.c
+// Запуск внешних команд через posix_spawn
+// glibc реализует posix_spawn через clone(CLONE_VM | CLONE_VFORK), поэтому
+// таблица страниц shell не копируется, в отличие от fork()
+// Группа процессов, сброс сигналов и перенаправления дескрипторов задаются
+// атрибутами spawn и выполняются ядром/libc до exec
+// spawn_child_setup() применяет те же настройки в дочернем процессе после fork(),
+// когда дочерний процесс должен выполнять код shell (subshell, builtin)
+// Параметры планирования (jobctl run) posix_spawn задать не умеет - такие
+// команды запускаются через fork, параметры применяются перед exec
+
+#include "Spawn.h"
+#include "CommandHash.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <spawn.h>
+
+extern char **environ;
+
+// Сигналы, которые shell игнорирует, а дочерний процесс должен получать
+static const int g_default_signals[] = { SIGINT, SIGTSTP, SIGQUIT, SIGCHLD };
+// Сигналы терминала: сбрасываются только для задач переднего плана
+static const int g_tty_signals[] = { SIGTTIN, SIGTTOU };
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+// Интерпретатор для исполняемых файлов без #! (ENOEXEC)
+#define SPAWN_SHELL "/bin/sh"
+
+// Параметры планирования для всех запусков, пока выполняется jobctl run
+static const JobSched *g_spawn_sched = NULL;
+
+void spawn_options_init(SpawnOptions *opts, pid_t pgid, int background){
+    opts->pgid = pgid;
+    opts->background = background;
+    opts->action_count = 0;
+    opts->close_from = -1;
+    opts->sched = g_spawn_sched;
+}
+
+// Установка параметров планирования для последующих запусков (NULL - сброс)
+// Возвращает предыдущее значение для восстановления
+const JobSched *spawn_set_sched(const JobSched *sched){
+    const JobSched *prev = g_spawn_sched;
+    g_spawn_sched = sched;
+    return prev;
+}
+
+static int spawn_options_push(SpawnOptions *opts, SpawnFdActionType type, int fd, int target){
+    if(opts->action_count >= SPAWN_MAX_FD_ACTIONS){
+        fprintf(stderr, "spawn: too many fd actions\n");
+        return -1;
+    }
+    opts->actions[opts->action_count].type = type;
+    opts->actions[opts->action_count].fd = fd;
+    opts->actions[opts->action_count].target = target;
+    opts->action_count++;
+    return 0;
+}
+
+int spawn_options_dup2(SpawnOptions *opts, int fd, int target){
+    return spawn_options_push(opts, SPAWN_FD_DUP2, fd, target);
+}
+
+int spawn_options_close(SpawnOptions *opts, int fd){
+    return spawn_options_push(opts, SPAWN_FD_CLOSE, fd, -1);
+}
+
+// Закрыть в дочернем процессе все дескрипторы >= fd (после всех dup2)
+void spawn_options_close_from(SpawnOptions *opts, int fd){
+    opts->close_from = fd;
+}
+
+// Набор сигналов, которые нужно вернуть в SIG_DFL
+static void spawn_default_sigset(const SpawnOptions *opts, sigset_t *set){
+    sigemptyset(set);
+    for(size_t i = 0; i < ARRAY_LEN(g_default_signals); i++){
+        sigaddset(set, g_default_signals[i]);
+    }
+    if(!opts->background){
+        for(size_t i = 0; i < ARRAY_LEN(g_tty_signals); i++){
+            sigaddset(set, g_tty_signals[i]);
+        }
+    }
+}
+
+// Число аргументов в массиве, завершённом NULL
+static size_t spawn_argc(char **args){
+    size_t argc = 0;
+    while(args[argc]){
+        argc++;
+    }
+    return argc;
+}
+
+// Аргументы для запуска файла без #! через /bin/sh: sh path args[1..]
+// execvp делал так сам, posix_spawn и execv возвращают ENOEXEC
+// out должен вмещать spawn_argc(args) + 2 элемента
+static void spawn_shell_args(const char *path, char **args, char **out){
+    size_t argc = spawn_argc(args);
+    out[0] = "sh";
+    out[1] = (char *)path;
+    for(size_t i = 1; i <= argc; i++){
+        out[i + 1] = args[i];
+    }
+}
+
+// execv с повтором через /bin/sh для скрипта без #!
+// Возвращается только при ошибке (errno установлен)
+static void spawn_execv(const char *path, char **args){
+    execv(path, args);
+    if(errno == ENOEXEC){
+        char *sh_args[spawn_argc(args) + 2];
+        spawn_shell_args(path, args, sh_args);
+        execv(SPAWN_SHELL, sh_args);
+        errno = ENOEXEC;
+    }
+}
+
+// exec по пути из кеша команд в дочернем процессе после fork
+// Файл по сохранённому пути исчез - запись сбрасывается и путь ищется
+// заново, как в spawn_command. Возвращается только при ошибке exec,
+// NULL в *path - команда больше не найдена
+static void spawn_exec_cached(const char **path, char **args){
+    spawn_execv(*path, args);
+    if(errno == ENOENT && *path != args[0]){
+        command_hash_remove(args[0]);
+        *path = command_hash_lookup(args[0]);
+        if(*path){
+            spawn_execv(*path, args);
+        }
+    }
+}
+
+// Запуск через fork + exec, когда posix_spawn не может выполнить настройку
+// Путь ищется в родителе, чтобы "command not found" было ошибкой запуска
+static pid_t spawn_fork_exec(char **args, const SpawnOptions *opts){
+    const char *path = command_hash_lookup(args[0]);
+    if(!path){
+        fprintf(stderr, "%s: command not found\n", args[0]);
+        errno = ENOENT;
+        return -1;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if(pid < 0){
+        perror("fork");
+        return -1;
+    }
+    if(pid == 0){
+        spawn_child_setup(opts);
+        spawn_exec_cached(&path, args);
+        if(!path){
+            fprintf(stderr, "%s: command not found\n", args[0]);
+        } else {
+            perror(args[0]);
+        }
+        _exit(127);
+    }
+
+    // Группа задаётся и в родителе, чтобы не зависеть от порядка выполнения
+    if(opts->pgid != SPAWN_PGID_INHERIT){
+        setpgid(pid, opts->pgid ? opts->pgid : pid);
+    }
+    return pid;
+}
+
+// posix_spawn с повтором через /bin/sh для скрипта без #!
+// Возвращает 0 или код ошибки, как posix_spawn
+static int spawn_try(pid_t *pid, const char *path, char **args,
+                     const posix_spawn_file_actions_t *file_actions,
+                     const posix_spawnattr_t *attr){
+    int err = posix_spawn(pid, path, file_actions, attr, args, environ);
+    if(err == ENOEXEC){
+        char *sh_args[spawn_argc(args) + 2];
+        spawn_shell_args(path, args, sh_args);
+        if(posix_spawn(pid, SPAWN_SHELL, file_actions, attr, sh_args, environ) == 0){
+            err = 0;
+        }
+    }
+    return err;
+}
+
+// Запуск внешней команды без fork
+// Возвращает PID дочернего процесса или -1 (errno установлен, сообщение выведено)
+pid_t spawn_command(char **args, const SpawnOptions *opts){
+    if(opts->sched){
+        return spawn_fork_exec(args, opts);
+    }
+
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t file_actions;
+    int err;
+
+    if((err = posix_spawnattr_init(&attr)) != 0){
+        errno = err;
+        perror("posix_spawnattr_init");
+        return -1;
+    }
+    if((err = posix_spawn_file_actions_init(&file_actions)) != 0){
+        posix_spawnattr_destroy(&attr);
+        errno = err;
+        perror("posix_spawn_file_actions_init");
+        return -1;
+    }
+
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+
+    // Группа процессов устанавливается до exec, setpgid в родителе не нужен
+    if(opts->pgid != SPAWN_PGID_INHERIT){
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, opts->pgid);
+    }
+
+    sigset_t sigdef, sigmask;
+    spawn_default_sigset(opts, &sigdef);
+    sigemptyset(&sigmask);
+    posix_spawnattr_setsigdefault(&attr, &sigdef);
+    posix_spawnattr_setsigmask(&attr, &sigmask);
+    posix_spawnattr_setflags(&attr, flags);
+
+    for(size_t i = 0; i < opts->action_count && err == 0; i++){
+        const SpawnFdAction *a = &opts->actions[i];
+        if(a->type == SPAWN_FD_DUP2){
+            err = posix_spawn_file_actions_adddup2(&file_actions, a->fd, a->target);
+        } else {
+            err = posix_spawn_file_actions_addclose(&file_actions, a->fd);
+        }
+    }
+    if(err == 0 && opts->close_from >= 0){
+        err = posix_spawn_file_actions_addclosefrom_np(&file_actions, opts->close_from);
+    }
+
+    pid_t pid = -1;
+    const char *path = NULL;
+    if(err == 0){
+        // Запуск по абсолютному пути из кеша команд, без перебора $PATH
+        path = command_hash_lookup(args[0]);
+        if(path){
+            err = spawn_try(&pid, path, args, &file_actions, &attr);
+            // Файл по сохранённому пути исчез - сбрасываем запись и ищем заново
+            if(err == ENOENT && path != args[0]){
+                command_hash_remove(args[0]);
+                path = command_hash_lookup(args[0]);
+                if(path){
+                    err = spawn_try(&pid, path, args, &file_actions, &attr);
+                }
+            }
+        }
+    }
+
+    posix_spawn_file_actions_destroy(&file_actions);
+    posix_spawnattr_destroy(&attr);
+
+    if(err == 0 && !path){
+        fprintf(stderr, "%s: command not found\n", args[0]);
+        errno = ENOENT;
+        return -1;
+    }
+
+    if(err != 0){
+        // Ошибка exec возвращается родителю (нет прав, неверный формат и т.п.)
+        fprintf(stderr, "%s: %s\n", args[0], strerror(err));
+        errno = err;
+        return -1;
+    }
+
+    return pid;
+}
+
+// Замена текущего процесса внешней командой (после fork)
+// Путь берётся из кеша команд (устаревшая запись ищется заново), файл без #!
+// выполняется через /bin/sh, при ошибке процесс завершается с кодом 127
+void spawn_exec(char **args){
+    const char *path = command_hash_lookup(args[0]);
+    if(!path){
+        fprintf(stderr, "%s: command not found\n", args[0]);
+        _exit(127);
+    }
+
+    spawn_exec_cached(&path, args);
+    if(!path){
+        fprintf(stderr, "%s: command not found\n", args[0]);
+    } else {
+        perror(args[0]);
+    }
+    _exit(127);
+}
+
+// Настройка дочернего процесса после fork() теми же параметрами, что и spawn
+// Используется когда дочерний процесс выполняет код shell, а не exec
+void spawn_child_setup(const SpawnOptions *opts){
+    if(opts->pgid != SPAWN_PGID_INHERIT){
+        setpgid(0, opts->pgid);
+    }
+
+    for(size_t i = 0; i < ARRAY_LEN(g_default_signals); i++){
+        signal(g_default_signals[i], SIG_DFL);
+    }
+    for(size_t i = 0; i < ARRAY_LEN(g_tty_signals); i++){
+        signal(g_tty_signals[i], opts->background ? SIG_IGN : SIG_DFL);
+    }
+    // Shell держит SIGCHLD заблокированным (signalfd), как и spawn - пустая маска
+    sigset_t sigmask;
+    sigemptyset(&sigmask);
+    sigprocmask(SIG_SETMASK, &sigmask, NULL);
+
+    // Ошибка (например, отрицательный nice без прав) не мешает запуску команды
+    if(opts->sched){
+        job_sched_apply_self(opts->sched);
+    }
+
+    for(size_t i = 0; i < opts->action_count; i++){
+        const SpawnFdAction *a = &opts->actions[i];
+        if(a->type == SPAWN_FD_DUP2){
+            if(dup2(a->fd, a->target) < 0){
+                perror("dup2");
+                _exit(1);
+            }
+        } else {
+            close(a->fd);
+        }
+    }
+
+    // Одним системным вызовом вместо цикла close() по всем дескрипторам
+    if(opts->close_from >= 0){
+        close_range((unsigned int)opts->close_from, ~0U, 0);
+    }
+}
@@ -0,0 +1,235 @@
+// Timing.c
+// Измерение времени для ключевого слова time
+// Для каждой стадии (процесса) запоминается момент запуска и rusage,
+// полученный из wait4 при сборе процесса. Стадии, выполненные в процессе
+// shell (builtins), измеряются через getrusage(RUSAGE_SELF)
+// Если задача останавливается и продолжается через fg/bg, отчёт переходит
+// в Job и дополняется при сборе оставшихся процессов; время задачи
+// раскладывается по состояниям: передний план, фон, остановлена
+// maxrss стадии - пик RSS процесса за всё время, включая участок до exec:
+// posix_spawn (CLONE_VM) и fork начинают с памяти shell, поэтому значение
+// не меньше RSS shell на момент запуска. Для небольших команд оно показывает
+// память shell, а не команды - такие значения выводятся как "<=N KB"
+
+#include "Timing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+static const char *g_phase_names[TIME_PHASE_COUNT] = {
+    [TIME_PHASE_FOREGROUND] = "foreground",
+    [TIME_PHASE_BACKGROUND] = "background",
+    [TIME_PHASE_STOPPED] = "stopped",
+};
+
+static double timespec_diff(const struct timespec *from, const struct timespec *to){
+    return (double)(to->tv_sec - from->tv_sec) + (double)(to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+static double timeval_seconds(const struct timeval *tv){
+    return (double)tv->tv_sec + (double)tv->tv_usec / 1e6;
+}
+
+TimeReport *time_report_create(TimeFormat format, TimePhase phase){
+    TimeReport *report = calloc(1, sizeof(TimeReport));
+    if(!report){
+        perror("time_report_create: calloc");
+        return NULL;
+    }
+    report->format = format;
+    report->phase = phase;
+    clock_gettime(CLOCK_MONOTONIC, &report->start);
+    report->phase_start = report->start;
+    return report;
+}
+
+void time_report_free(TimeReport *report){
+    if(!report){
+        return;
+    }
+    for(size_t i = 0; i < report->count; i++){
+        free(report->stages[i].command);
+    }
+    free(report->stages);
+    free(report);
+}
+
+// Новая стадия, запущенная сейчас
+// Возвращает указатель, действительный до следующего добавления стадии
+TimedStage *time_report_add_stage(TimeReport *report, pid_t pid, const char *command){
+    if(report->count >= report->capacity){
+        size_t cap = report->capacity ? report->capacity * 2 : 4;
+        TimedStage *grown = realloc(report->stages, cap * sizeof(TimedStage));
+        if(!grown){
+            perror("time_report_add_stage: realloc");
+            return NULL;
+        }
+        report->stages = grown;
+        report->capacity = cap;
+    }
+
+    TimedStage *stage = &report->stages[report->count++];
+    memset(stage, 0, sizeof(*stage));
+    stage->command = strdup(command ? command : "");
+    stage->pid = pid;
+    clock_gettime(CLOCK_MONOTONIC, &stage->start);
+    return stage;
+}
+
+// Стадия завершилась с указанным потреблением ресурсов
+void time_report_stage_done(TimedStage *stage, const struct rusage *usage){
+    clock_gettime(CLOCK_MONOTONIC, &stage->end);
+    stage->usage = *usage;
+    stage->done = 1;
+}
+
+// Начало стадии, выполняемой в процессе shell: снимок RUSAGE_SELF
+void time_report_self_begin(TimedStage *stage){
+    if(stage){
+        getrusage(RUSAGE_SELF, &stage->usage);
+    }
+}
+
+// Конец стадии в процессе shell: потребление = разница с начальным снимком
+void time_report_self_end(TimedStage *stage){
+    if(!stage){
+        return;
+    }
+    struct rusage now;
+    getrusage(RUSAGE_SELF, &now);
+    timersub(&now.ru_utime, &stage->usage.ru_utime, &now.ru_utime);
+    timersub(&now.ru_stime, &stage->usage.ru_stime, &now.ru_stime);
+    time_report_stage_done(stage, &now);
+}
+
+// Процесс pid собран через wait4: запоминаем его rusage
+// Возвращает 1 если процесс принадлежит отчёту
+int time_report_reaped(TimeReport *report, pid_t pid, const struct rusage *usage){
+    if(!report){
+        return 0;
+    }
+    for(size_t i = 0; i < report->count; i++){
+        if(report->stages[i].pid == pid && !report->stages[i].done){
+            time_report_stage_done(&report->stages[i], usage);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Переход задачи в другое состояние (остановка, fg, bg)
+void time_report_phase(TimeReport *report, TimePhase phase){
+    if(!report || report->phase == phase){
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    report->phase_time[report->phase] += timespec_diff(&report->phase_start, &now);
+    report->phase = phase;
+    report->phase_start = now;
+}
+
+static void print_duration(const char *name, double seconds){
+    int minutes = (int)(seconds / 60);
+    fprintf(stderr, "%s\t%dm%.3fs\n", name, minutes, seconds - minutes * 60);
+}
+
+// Вывод отчёта в stderr
+// TIME_FORMAT_DEFAULT - как в bash, плюс maxrss и строка на каждую стадию
+// TIME_FORMAT_POSIX   - time -p, только real/user/sys в секундах
+// TIME_FORMAT_MACHINE - time -m, строки key=value через табуляцию (maxrss_kb
+//                       стадии как есть, с учётом памяти shell - см. выше)
+void time_report_print(TimeReport *report){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Задача могла завершиться в фоне задолго до вывода отчёта:
+    // концом считается сбор последнего процесса
+    int all_done = report->count > 0;
+    struct timespec last_end = report->start;
+    for(size_t i = 0; i < report->count; i++){
+        if(!report->stages[i].done){
+            all_done = 0;
+        } else if(timespec_diff(&last_end, &report->stages[i].end) > 0){
+            last_end = report->stages[i].end;
+        }
+    }
+    if(all_done){
+        now = last_end;
+    }
+
+    double tail = timespec_diff(&report->phase_start, &now);
+    if(tail > 0){
+        report->phase_time[report->phase] += tail;
+    }
+    report->phase_start = now;
+
+    double real = timespec_diff(&report->start, &now);
+    double user = 0, sys = 0;
+    long maxrss = 0;
+    for(size_t i = 0; i < report->count; i++){
+        TimedStage *st = &report->stages[i];
+        user += timeval_seconds(&st->usage.ru_utime);
+        sys += timeval_seconds(&st->usage.ru_stime);
+        if(st->usage.ru_maxrss > maxrss){
+            maxrss = st->usage.ru_maxrss;
+        }
+    }
+
+    // Переходы между состояниями были, если время есть не только в начальном
+    int transitions = 0;
+    for(int p = 0; p < TIME_PHASE_COUNT; p++){
+        if(report->phase_time[p] > 0 && p != (int)report->phase){
+            transitions = 1;
+        }
+    }
+
+    if(report->format == TIME_FORMAT_POSIX){
+        fprintf(stderr, "real %.2f\nuser %.2f\nsys %.2f\n", real, user, sys);
+        return;
+    }
+
+    if(report->format == TIME_FORMAT_MACHINE){
+        for(size_t i = 0; i < report->count; i++){
+            TimedStage *st = &report->stages[i];
+            double st_real = st->done ? timespec_diff(&st->start, &st->end) : timespec_diff(&st->start, &now);
+            fprintf(stderr, "stage=%zu\tpid=%d\treal=%.6f\tuser=%.6f\tsys=%.6f\tmaxrss_kb=%ld\tcommand=%s\n",
+                    i + 1, (int)st->pid, st_real, timeval_seconds(&st->usage.ru_utime),
+                    timeval_seconds(&st->usage.ru_stime), st->usage.ru_maxrss, st->command);
+        }
+        fprintf(stderr, "total\treal=%.6f\tuser=%.6f\tsys=%.6f\tmaxrss_kb=%ld", real, user, sys, maxrss);
+        for(int p = 0; p < TIME_PHASE_COUNT; p++){
+            fprintf(stderr, "\t%s=%.6f", g_phase_names[p], report->phase_time[p]);
+        }
+        fprintf(stderr, "\n");
+        return;
+    }
+
+    fprintf(stderr, "\n");
+    print_duration("real", real);
+    print_duration("user", user);
+    print_duration("sys", sys);
+    fprintf(stderr, "maxrss\t%ld KB\n", maxrss);
+    if(transitions){
+        for(int p = 0; p < TIME_PHASE_COUNT; p++){
+            fprintf(stderr, "%s\t%.3fs\n", g_phase_names[p], report->phase_time[p]);
+        }
+    }
+    if(report->count > 1){
+        // Пик не выше пика shell - собственная память команды неизвестна
+        // и не больше этого значения
+        struct rusage self;
+        getrusage(RUSAGE_SELF, &self);
+        for(size_t i = 0; i < report->count; i++){
+            TimedStage *st = &report->stages[i];
+            double st_real = st->done ? timespec_diff(&st->start, &st->end) : timespec_diff(&st->start, &now);
+            fprintf(stderr, "  [%zu] real %.3fs  user %.3fs  sys %.3fs  maxrss %s%ld KB  %s\n",
+                    i + 1, st_real, timeval_seconds(&st->usage.ru_utime),
+                    timeval_seconds(&st->usage.ru_stime),
+                    st->usage.ru_maxrss <= self.ru_maxrss ? "<=" : "",
+                    st->usage.ru_maxrss, st->command);
+        }
+    }
+}
@@ -3,12 +3,16 @@
 #include "getline.h"
 #include "History.h"
 #include "Utils.h"
+#include "CommandSubst.h"
+#include "JobControl.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <termios.h>
 #include <unistd.h>
+#include <poll.h>
+#include <errno.h>
 
 #define DEFAULT_BUF_SIZE 256
 
@@ -35,9 +39,13 @@ typedef enum {
     KEY_CTRL_L,
     KEY_TAB,
     KEY_ESC,
+    KEY_JOB_EVENT,      // Фоновая задача завершилась во время ожидания ввода
     KEY_NONE
 } KeyType;
 
+// Вводится строка продолжения (prompt "> ") - для перерисовки после уведомлений
+static int g_continuation = 0;
+
 void terminal_init(void) {
     if (!g_termios_saved) {
         tcgetattr(STDIN_FILENO, &g_orig_termios);
@@ -68,9 +76,75 @@ void terminal_disable_raw_mode(void) {
     }
 }
 
+// Ожидание ввода: пока пользователь печатает, завершившиеся фоновые
+// процессы собираются по событию дескриптора job control, а перехваченный
+// вывод фоновых задач (set -o bgcapture) вычитывается в их буферы
+// Возвращает 1 если в интерактивном режиме есть задачи, о завершении которых
+// нужно сообщить сейчас, 0 - готов ввод
+static int wait_for_input(void) {
+    int event_fd = job_control_event_fd();
+    if (event_fd < 0) {
+        return 0;
+    }
+    
+    struct pollfd fds[2 + JOB_POLL_MAX];
+    for (;;) {
+        fds[0].fd = STDIN_FILENO;
+        fds[0].events = POLLIN;
+        fds[1].fd = event_fd;
+        fds[1].events = POLLIN;
+        fds[0].revents = fds[1].revents = 0;
+        size_t nfds = 2 + job_pollfds(job_list_get(), fds + 2, JOB_POLL_MAX);
+        
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        if (nfds > 2) {
+            job_poll_dispatch(job_list_get());
+        }
+        if (fds[1].revents & POLLIN) {
+            job_reap_children(job_list_get());
+            if (job_control_is_interactive() && job_has_pending_notifications(job_list_get())) {
+                return 1;
+            }
+        }
+        if (fds[0].revents) {
+            return 0;
+        }
+    }
+}
+
+// Уведомления о завершённых задачах над строкой ввода:
+// строка стирается, выводятся уведомления, затем prompt и буфер
+// перерисовываются с курсором на прежнем месте
+static void notify_and_redraw(const char *buf, size_t len, size_t cursor) {
+    write(STDOUT_FILENO, "\r\x1b[J", 4);
+    job_notify_completed(job_list_get());
+    fflush(stdout);
+    fflush(stderr);
+    
+    if (g_continuation) {
+        write(STDOUT_FILENO, "> ", 2);
+    } else {
+        print_prompt();
+    }
+    write(STDOUT_FILENO, buf, len);
+    if (cursor < len) {
+        char seq[32];
+        snprintf(seq, sizeof(seq), "\x1b[%zuD", len - cursor);
+        write(STDOUT_FILENO, seq, strlen(seq));
+    }
+}
+
 // Чтение и распознавание клавиши (обычные символы, Ctrl, escape-коды)
 static KeyType read_key(char *out_char) {
     char c;
+    if (wait_for_input()) {
+        return KEY_JOB_EVENT;
+    }
     ssize_t nread = read(STDIN_FILENO, &c, 1);
     
     if (nread <= 0) return KEY_NONE;
@@ -354,6 +428,10 @@ char* my_getline(void) {
 
             break;
             
+        case KEY_JOB_EVENT:
+            notify_and_redraw(buf, len, cursor);
+            break;
+            
         default:
             break;
         }
@@ -374,14 +452,105 @@ char* my_getline(void) {
     return buf;
 }
 
-// Проверка незакрытых конструкций (кавычки, ${...}, \, операторы)
+#define MAX_PENDING_HEREDOCS 16
+#define MAX_HEREDOC_DELIM 256
+
+// Чтение ограничителя here-document после << (кавычки снимаются)
+// Возвращает позицию после слова
+static size_t read_heredoc_delim(const char *str, size_t i, char *delim) {
+    size_t n = 0;
+    char quote = 0;
+    
+    while (str[i] == ' ' || str[i] == '\t') {
+        i++;
+    }
+    for (; str[i] != '\0'; i++) {
+        char c = str[i];
+        if (quote) {
+            if (c == quote) {
+                quote = 0;
+                continue;
+            }
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+            continue;
+        } else if (strchr(" \t\n;|&<>()", c)) {
+            break;
+        }
+        if (n + 1 < MAX_HEREDOC_DELIM) {
+            delim[n++] = c;
+        }
+    }
+    delim[n] = '\0';
+    return i;
+}
+
+// Пропуск тела here-document, начинающегося с позиции start
+// Возвращает позицию '\n' строки-ограничителя (или конец строки, если
+// ограничитель последний), либо (size_t)-1 если ограничитель ещё не введён
+static size_t skip_heredoc_body(const char *str, size_t start, const char *delim) {
+    size_t delim_len = strlen(delim);
+    size_t line = start;
+    
+    while (str[line] != '\0') {
+        const char *nl = strchr(str + line, '\n');
+        size_t line_end = nl ? (size_t)(nl - str) : strlen(str);
+        if (line_end - line == delim_len && strncmp(str + line, delim, delim_len) == 0) {
+            return nl ? line_end : line_end - 1;
+        }
+        if (!nl) {
+            break;
+        }
+        line = line_end + 1;
+    }
+    return (size_t)-1;
+}
+
+// Проверка незакрытых конструкций (кавычки, ${...}, $(...), `...`, \, операторы, here-document)
 int has_unclosed_syntax(const char *str) {
     int single = 0;
     int double_q = 0;
     int brace = 0;
     size_t len = strlen(str);
+    // Ограничители here-document, тела которых начнутся после конца строки
+    char pending[MAX_PENDING_HEREDOCS][MAX_HEREDOC_DELIM];
+    size_t pending_count = 0;
     
     for (size_t i = 0; str[i] != '\0'; ++i) {
+        if (!single && !double_q && str[i] == '<' && str[i+1] == '<') {
+            if (str[i+2] == '<') {
+                i += 2;  // <<< - here-string, тела нет
+                continue;
+            }
+            if (pending_count < MAX_PENDING_HEREDOCS) {
+                i = read_heredoc_delim(str, i + 2, pending[pending_count]);
+                if (pending[pending_count][0] != '\0') {
+                    pending_count++;
+                }
+            } else {
+                i += 1;
+            }
+            if (str[i] == '\0') {
+                break;
+            }
+            i--;
+            continue;
+        }
+        if (str[i] == '\n' && pending_count > 0 && !single && !double_q) {
+            // Тела here-document не участвуют в проверке кавычек
+            for (size_t h = 0; h < pending_count; h++) {
+                size_t end = skip_heredoc_body(str, i + 1, pending[h]);
+                if (end == (size_t)-1) {
+                    return 1;
+                }
+                i = end;
+            }
+            pending_count = 0;
+            if (str[i] == '\0') {
+                break;
+            }
+            continue;
+        }
         if (str[i] == '\'' && !double_q) {
             single = !single;
         }
@@ -395,6 +564,17 @@ int has_unclosed_syntax(const char *str) {
         else if (str[i] == '}' && brace > 0 && !single) {
             brace--;
         }
+        // Подстановка команды $(...) и `...` пропускается целиком
+        else if (((str[i] == '$' && str[i+1] == '(') || str[i] == '`') && !single) {
+            size_t end = command_subst_end(str, i);
+            if (end == COMMAND_SUBST_NOT_FOUND) {
+                return 1;
+            }
+            i = end;
+        }
+        else if (str[i] == '\\' && str[i+1] != '\0' && str[i+1] != '\n' && !single) {
+            i++;  // Экранированный символ не открывает и не закрывает конструкции
+        }
     }
     
     int backslash_continue = 0;
@@ -428,7 +608,9 @@ int has_unclosed_syntax(const char *str) {
         }
     }
     
-    return single || double_q || brace || backslash_continue || trailing_operator;
+    // << в последней строке: тело ещё не начато
+    return single || double_q || brace || backslash_continue || trailing_operator ||
+           pending_count > 0;
 }
 
 char* str_concat(char *s1, const char *s2) {
@@ -458,7 +640,9 @@ char* read_full_command(void) {
     while (has_unclosed_syntax(command)) {
         write(STDOUT_FILENO, "> ", 2);
         
+        g_continuation = 1;
         char *next_line = my_getline();
+        g_continuation = 0;
         if (!next_line) {
             free(command);
             return NULL;
@@ -6,14 +6,13 @@
 #include <pwd.h>
 #include <unistd.h>
 
-#include "Lexer.h"
-#include "Parser.h"
+#include "ParseCache.h"
 #include "Executor.h"
 #include "getline.h"
 #include "JobControl.h"
-#include "Expander.h"
 #include "History.h"
 #include "Utils.h"
+#include "CommandHash.h"
 
 int g_last_exit_code = 0;
 pid_t g_last_bg_pid = 0;
@@ -28,11 +27,8 @@ int main(){
     job_control_setup_signals();
     history_load();
     
-    Lexer lexer;
-    Parser parser;
-
     for(;;){
-        job_update_all(job_list_get());
+        job_reap_children(job_list_get());
         job_notify_completed(job_list_get());
         
         print_prompt();
@@ -77,29 +73,14 @@ int main(){
             continue;
         }
 
-        lexer_init(&lexer, line);
-
-        TokenArray tokens;
-        if(!lexer_tokenize_all(&lexer, &tokens)){
-            fprintf(stderr, "tokenize failed\n");
-            lexer_destroy(&lexer);
-            free(line);
-            continue;
-        }
-
-        expander_expand(&tokens);
-
-        parser_init(&parser, &tokens);
-        ASTNode *tree = parser_parse(&parser);
+        // Повторная строка берётся из кеша разбора без лексера и парсера
+        ASTNode *tree = parse_cache_get(line);
         
         if(tree){
             g_last_exit_code = executor_execute(tree);
             history_add(line);
-            ast_free(tree);
         }
 
-        token_array_free(&tokens);
-        lexer_destroy(&lexer);
         free(line);
         
         // Проверяем флаг выхода (установлен командой exit)
@@ -108,8 +89,10 @@ int main(){
         }
     }
 
+    parse_cache_free();
     history_save();
     history_free();
+    command_hash_free();
     job_control_cleanup();
     return g_exit_code;
 }
\ No newline at end of file